@@ -1,17 +1,55 @@
 #include "AnimatedEntity.h"
 
+#include <cmath>
 
-void AnimatedEntity::setupEntityShaderForAnim(Shader& shader, const std::vector<glm::mat4>& transforms)
+void AnimatedEntity::updateAnimationLod(const ViewFrustum& frustum, const glm::vec3& cameraPos, float fovY)
 {
-	shader.setBool("doAnimate", true);
-	for (int i = 0; i < transforms.size(); ++i)
+	Animator& animator = this->getAnimator();
+	if (this->isAnimationHidden() || !this->isVisible(frustum))
 	{
-		shader.setMat4("finalBoneMatrices[" + std::to_string(i) + "]", transforms[i]);
-		//glGetError();
+		animator.updateLod(0.0f, false);
+		return;
 	}
+
+	glm::vec3 center;
+	float radius;
+	const RenderableGameObject* model = this->getAnimatedModel();
+	if (model == nullptr || !model->getWorldBoundingSphere(center, radius, ANIMATED_BOUNDS_SCALE))
+	{
+		animator.updateLod(1.0f, true); // nothing to go off of, full detail
+		return;
+	}
+
+	// fraction of the screen height the bounding sphere covers
+	const float distance = glm::length(center - cameraPos);
+	const float screenSize = distance <= radius ? 1.0f : radius / (distance * std::tan(glm::radians(fovY) * 0.5f));
+	animator.updateLod(screenSize, true);
+}
+
+void AnimatedEntity::setupEntityShaderForAnim(Shader& shader, const Animator& animator)
+{
+	// not uploaded this frame: draw it in its bind pose rather than with someone else's bones
+	const int offset = animator.getBonePaletteOffset();
+	shader.setBool("doAnimate", offset != -1);
+	shader.setInt("boneOffset", offset);
+	shader.setInt("boneCount", animator.getUsedBoneCount());
 }
 
 void AnimatedEntity::clearEntityShaderForAnim(Shader& shader)
 {
 	shader.setBool("doAnimate", false);
 }
+
+void AnimatedEntity::drawAnimatedModel(Shader& shader)
+{
+	RenderableGameObject* model = this->getAnimatedModel();
+	if (model->isPreSkinned())
+	{
+		model->draw(shader);
+		return;
+	}
+
+	this->setupEntityShaderForAnim(shader, this->getAnimator());
+	model->draw(shader);
+	this->clearEntityShaderForAnim(shader);
+}
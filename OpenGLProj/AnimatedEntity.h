@@ -3,20 +3,56 @@
 #include "Animator.h"
 #include "DrawableEntity.h"
 #include "FrameRequester.h"
+#include "RenderableGameObject.h"
+
+// animated models can move outside of their bind pose bounds, so they're culled with a larger bounding sphere
+constexpr auto ANIMATED_BOUNDS_SCALE = 2.0f;
 
 /**
  * \brief An entity that defines per-frame animation
  */
 class AnimatedEntity : public FrameRequester, public DrawableEntity
 {
+public:
+	/**
+	 * \brief onNewFrame() only advances the animation time, the poses of all entities are evaluated together afterwards (see Animator::evaluateAll())
+	 */
+	virtual Animator& getAnimator() = 0;
+
+	/**
+	 * \brief Picks the animation LOD for this frame from how large the entity is on screen (see AnimationLodSettings,
+	 * configured per entity through getAnimator().setLodSettings())
+	 *
+	 * \param fovY		vertical field of view, in degrees
+	 */
+	virtual void updateAnimationLod(const ViewFrustum& frustum, const glm::vec3& cameraPos, float fovY);
+
+	/**
+	 * \brief The model that getAnimator() animates. Its bounds decide the LOD
+	 */
+	virtual RenderableGameObject* getAnimatedModel() = 0;
+
 protected:
+
+	/**
+	 * \brief Whether the entity can't be seen even though it might be in the frustum (e.g. below the sand)
+	 */
+	virtual bool isAnimationHidden() const { return false; }
+
 	/**
 	 * \brief Generic reusable means of setting up animations in a given frame.
+	 * The bone matrices themselves are already on the GPU (see BonePaletteBuffer), this only points the shader at the animator's palette.
 	 * \param shader			Shader to use for animation rendering
-	 * \param transforms		Transforms being applied to the model
+	 * \param animator			Animator of the model being drawn
 	 */
-	void setupEntityShaderForAnim(Shader& shader, const std::vector<glm::mat4>& transforms);
+	void setupEntityShaderForAnim(Shader& shader, const Animator& animator);
 	void clearEntityShaderForAnim(Shader& shader);
+
+	/**
+	 * \brief Draws getAnimatedModel() in its current pose: as static geometry when it was already skinned this frame (see SkinningPass),
+	 * otherwise skinned by the shader itself
+	 */
+	void drawAnimatedModel(Shader& shader);
 };
 
 #endif
\ No newline at end of file
@@ -4,13 +4,49 @@
 #include <assimp/postprocess.h>
 
 
-Animation::Animation(aiAnimation* animation, Model* model)
+Animation::Animation(aiAnimation* animation, Model* model, const AssimpNodeHierarchy& hierarchy, const AnimationBakeTolerance& bakeTolerance)
 {
 	std::cout << "Loading animation '" << animation->mName.C_Str() << "'" << std::endl;
 
 	this->_duration = animation->mDuration;
 	this->_ticksPerSecond = animation->mTicksPerSecond;
 	this->readMissingBones(animation, model);
+	this->bindNodes(hierarchy);
+	this->_baked = BakedAnimation(this->_bones, this->_duration, (float)this->_ticksPerSecond, bakeTolerance);
+}
+
+Animation::Animation(float duration, int ticksPerSecond, std::vector<BoneKeys>& channels, BakedAnimation&& baked, Model* model, const AssimpNodeHierarchy& hierarchy)
+{
+	this->_duration = duration;
+	this->_ticksPerSecond = ticksPerSecond;
+	this->readMissingBones(channels, model);
+	this->bindNodes(hierarchy);
+	this->_baked = std::move(baked);
+}
+
+void Animation::bindNodes(const AssimpNodeHierarchy& hierarchy)
+{
+	// (the first channel wins if a node has more than one, same as findBone())
+	std::map<std::string, int> boneIndices;
+	for (int i = 0; i < (int)this->_bones.size(); ++i)
+		boneIndices.emplace(this->_bones[i].getBoneName(), i);
+
+	this->_nodeBindings.resize(hierarchy.getNodeCount());
+	for (int node = 0; node < hierarchy.getNodeCount(); ++node)
+	{
+		const std::string& name = hierarchy.names[node];
+		AnimationNodeBinding& binding = this->_nodeBindings[node];
+
+		const auto bone = boneIndices.find(name);
+		if (bone != boneIndices.end()) binding.bone = bone->second;
+
+		const auto boneInfo = this->_boneInfoMap.find(name);
+		if (boneInfo != this->_boneInfoMap.end())
+		{
+			binding.boneMatrix = boneInfo->second.id;
+			binding.offset = boneInfo->second.offset;
+		}
+	}
 }
 
 Bone* Animation::findBone(const std::string& name)
@@ -23,6 +59,26 @@ Bone* Animation::findBone(const std::string& name)
 	return &(*iter);
 }
 
+const AnimationNodeBinding& Animation::getNodeBinding(int nodeIndex) const
+{
+	return this->_nodeBindings[nodeIndex];
+}
+
+Bone& Animation::getBone(int index)
+{
+	return this->_bones[index];
+}
+
+const std::vector<Bone>& Animation::getBones() const
+{
+	return this->_bones;
+}
+
+const BakedAnimation& Animation::getBaked() const
+{
+	return this->_baked;
+}
+
 float Animation::getTicksPerSecond() const
 {
 	return this->_ticksPerSecond;
@@ -38,33 +94,50 @@ std::map<std::string, BoneInfo>& Animation::getBoneIdMap()
 	return this->_boneInfoMap;
 }
 
+/**
+ * Id of the bone with this name in the model, which gets a new bone matrix slot for it if it doesn't have it yet
+ */
+static int getOrAddBoneId(const std::string& boneName, Model* model)
+{
+	std::map<std::string, BoneInfo>& boneInfoMap = model->getBoneInfoMap();
+	if (!boneInfoMap.contains(boneName))
+	{
+		const int boneCount = model->getBoneCount();
+		boneInfoMap[boneName] = {
+			.id = boneCount
+		};
+		model->setBoneCount(boneCount + 1);
+	}
+	return boneInfoMap[boneName].id;
+}
+
 // this fix is from the guide at https://learnopengl.com/Guest-Articles/2020/Skeletal-Animation for FBX files with missing bones
 void Animation::readMissingBones(const aiAnimation* animation, Model* model)
 {
 	const int size = animation->mNumChannels;
 
-	std::map<std::string, BoneInfo>& boneInfoMap = model->getBoneInfoMap();
-	int boneCount = model->getBoneCount();
-
 	// read the bones engaged in an animation and their keyframes
 	for (int i =0; i < size; ++ i)
 	{
 		aiNodeAnim* channel = animation->mChannels[i];
 		const std::string boneName = channel->mNodeName.data;
-
-		if (!boneInfoMap.contains(boneName))
-		{
-			boneInfoMap[boneName] = {
-				.id = boneCount
-			};
-			model->setBoneCount(++boneCount);
-		}
 		this->_bones.emplace_back(
 			boneName,
-			boneInfoMap[boneName].id,
+			getOrAddBoneId(boneName, model),
 			channel
 		);
 	}
 
-	this->_boneInfoMap = boneInfoMap;
+	this->_boneInfoMap = model->getBoneInfoMap();
+}
+
+void Animation::readMissingBones(std::vector<BoneKeys>& channels, Model* model)
+{
+	for (BoneKeys& channel : channels)
+	{
+		const int boneId = getOrAddBoneId(channel.name, model);
+		this->_bones.emplace_back(boneId, std::move(channel));
+	}
+
+	this->_boneInfoMap = model->getBoneInfoMap();
 }
@@ -1,10 +1,24 @@
 ﻿#ifndef ANIMATION_MINE_H
 #define ANIMATION_MINE_H
 #include <string>
+#include <assimp/scene.h>
 
+#include "AssimpNode.h"
+#include "BakedAnimation.h"
 #include "Bone.h"
 #include "Model.h"
 
+/**
+ * \brief What an animation does with one node of the hierarchy, resolved once when the animation is loaded
+ * so that playing it back does not need to look anything up by name.
+ */
+struct AnimationNodeBinding
+{
+	int bone = -1; // index of the channel (Bone) animating this node, -1 if the node keeps its own transformation
+	int boneMatrix = -1; // slot in the final bone matrices (BoneInfo::id), -1 if no mesh is skinned to this node
+	glm::mat4 offset = glm::mat4(1.0f); // BoneInfo::offset, only if boneMatrix != -1
+};
+
 
 /**
  * \brief A single animation belonging to a model (composed of one or more meshes). sMain reference: https://learnopengl.com/Guest-Articles/2020/Skeletal-Animation
@@ -15,10 +29,37 @@ public:
 	Animation() = default;
 	~Animation() = default;
 
-	Animation(aiAnimation* animation, Model* model);
+	/**
+	 * \param hierarchy		nodes the animation will be played on
+	 * \param bakeTolerance	how close the baked version must stay to the keyframes (picks the bake rate, see BakedAnimation)
+	 */
+	Animation(aiAnimation* animation, Model* model, const AssimpNodeHierarchy& hierarchy, const AnimationBakeTolerance& bakeTolerance);
+
+	/**
+	 * \brief Same as above, from the channels and the baked frames read back from the animation cache (see AnimationSet). Nothing gets baked
+	 * \param channels		in the same order as the channels of baked
+	 */
+	Animation(float duration, int ticksPerSecond, std::vector<BoneKeys>& channels, BakedAnimation&& baked, Model* model, const AssimpNodeHierarchy& hierarchy);
 
 	Bone* findBone(const std::string& name);
 
+	/**
+	 * \brief The channel and bone matrix slot of a node, by its index in the AssimpNodeHierarchy
+	 */
+	const AnimationNodeBinding& getNodeBinding(int nodeIndex) const;
+
+	/**
+	 * \brief Channel by index (see AnimationNodeBinding::bone)
+	 */
+	Bone& getBone(int index);
+
+	const std::vector<Bone>& getBones() const;
+
+	/**
+	 * \brief Fixed rate resampled version of all channels, what playback actually samples (channel indices are the same as getBone())
+	 */
+	const BakedAnimation& getBaked() const;
+
 	float getTicksPerSecond() const;
 	float getDuration() const;
 
@@ -29,9 +70,13 @@ private:
 	int _ticksPerSecond;
 	std::vector<Bone> _bones;
 	std::map<std::string, BoneInfo> _boneInfoMap;
+	std::vector<AnimationNodeBinding> _nodeBindings; // by node index in the AssimpNodeHierarchy
+	BakedAnimation _baked;
 
 
 	void readMissingBones(const aiAnimation* animation, Model* model);
+	void readMissingBones(std::vector<BoneKeys>& channels, Model* model);
+	void bindNodes(const AssimpNodeHierarchy& hierarchy);
 };
 
 #endif
\ No newline at end of file
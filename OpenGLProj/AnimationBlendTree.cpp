@@ -0,0 +1,300 @@
+#include "AnimationBlendTree.h"
+
+#include <algorithm>
+#include <cmath>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/quaternion.hpp>
+
+#include "InterpolationMathUtil.h"
+
+AnimationBlendTree::AnimationBlendTree(const AnimationSet* animationSet)
+:
+_animationSet(animationSet)
+{
+	const int nodeCount = animationSet->getHierarchy().getNodeCount();
+	this->_translations.resize(nodeCount);
+	this->_rotations.resize(nodeCount);
+	this->_scales.resize(nodeCount);
+	this->_isNodeAnimated.resize(nodeCount, 0);
+
+	// sampling only resizes a pose within this capacity from here on (see BakedAnimation::sample())
+	const size_t maxPoseSize = (size_t)AnimationPose::COMPONENT_COUNT * ((animationSet->getMaxChannelCount() + 3) & ~3);
+	for (AnimationPose& pose : this->_clipPoses) pose.values.reserve(maxPoseSize);
+	for (AnimationPose& pose : this->_referencePoses) pose.values.reserve(maxPoseSize);
+}
+
+void AnimationBlendTree::clear()
+{
+	for (int layer = 0; layer < MAX_LAYERS; ++layer) this->_layers[layer] = BlendLayer();
+}
+
+BlendLayer& AnimationBlendTree::getCheckedLayer(int layer)
+{
+	if (layer < 0 || layer >= MAX_LAYERS) throw std::exception("Invalid blend layer");
+	return this->_layers[layer];
+}
+
+const BlendLayer& AnimationBlendTree::getLayer(int layer) const
+{
+	if (layer < 0 || layer >= MAX_LAYERS) throw std::exception("Invalid blend layer");
+	return this->_layers[layer];
+}
+
+void AnimationBlendTree::play(int layer, Animation* animation)
+{
+	BlendLayer& target = this->getCheckedLayer(layer);
+	target.clips[0] = { .animation = animation, .time = 0.0f, .weight = 1.0f };
+	target.clipCount = 1;
+	target.fadeDuration = 0.0f;
+	target.fadeElapsed = 0.0f;
+}
+
+void AnimationBlendTree::crossFade(int layer, Animation* animation, float duration)
+{
+	BlendLayer& target = this->getCheckedLayer(layer);
+	if (target.clipCount == 0 || duration <= 0.0f)
+	{
+		this->play(layer, animation);
+		return;
+	}
+
+	// no room: the clip that contributes the least has to go
+	if (target.clipCount == BlendLayer::MAX_CLIPS)
+	{
+		int weakest = 0;
+		for (int clip = 1; clip < target.clipCount; ++clip)
+			if (target.clips[clip].weight < target.clips[weakest].weight) weakest = clip;
+		this->removeClip(target, weakest);
+	}
+
+	// the clips that are playing fade out together, from where they are now
+	float totalWeight = 0.0f;
+	for (int clip = 0; clip < target.clipCount; ++clip) totalWeight += target.clips[clip].weight;
+	for (int clip = 0; clip < target.clipCount; ++clip)
+		target.clips[clip].fadeFromWeight = totalWeight > 0.0f ? target.clips[clip].weight / totalWeight : 1.0f / (float)target.clipCount;
+
+	target.clips[target.clipCount++] = { .animation = animation, .time = 0.0f, .weight = 0.0f };
+	target.fadeDuration = duration;
+	target.fadeElapsed = 0.0f;
+}
+
+void AnimationBlendTree::setLayerMode(int layer, BlendMode mode, const BoneMask* mask)
+{
+	BlendLayer& target = this->getCheckedLayer(layer);
+	target.mode = mode;
+	target.mask = mask;
+}
+
+void AnimationBlendTree::setLayerWeight(int layer, float weight)
+{
+	BlendLayer& target = this->getCheckedLayer(layer);
+	target.weight = weight;
+	target.weightTarget = weight;
+	target.weightFadeSpeed = 0.0f;
+}
+
+void AnimationBlendTree::fadeLayer(int layer, float targetWeight, float duration)
+{
+	BlendLayer& target = this->getCheckedLayer(layer);
+	target.weightTarget = targetWeight;
+	if (duration <= 0.0f)
+	{
+		target.weight = targetWeight;
+		target.weightFadeSpeed = 0.0f;
+		if (targetWeight <= 0.0f) this->clearLayer(layer);
+		return;
+	}
+	target.weightFadeSpeed = std::fabs(targetWeight - target.weight) / duration;
+}
+
+void AnimationBlendTree::clearLayer(int layer)
+{
+	this->getCheckedLayer(layer) = BlendLayer();
+}
+
+void AnimationBlendTree::removeClip(BlendLayer& layer, int clip)
+{
+	for (int i = clip; i + 1 < layer.clipCount; ++i) layer.clips[i] = layer.clips[i + 1];
+	layer.clipCount--;
+}
+
+void AnimationBlendTree::advance(float deltaTime)
+{
+	for (int layerIndex = 0; layerIndex < MAX_LAYERS; ++layerIndex)
+	{
+		BlendLayer& layer = this->_layers[layerIndex];
+		if (layer.clipCount == 0) continue;
+
+		for (int clip = 0; clip < layer.clipCount; ++clip)
+		{
+			BlendClip& playing = layer.clips[clip];
+			playing.time += playing.animation->getTicksPerSecond() * deltaTime;
+			playing.time = fmod(playing.time, playing.animation->getDuration());
+		}
+
+		if (layer.fadeDuration > 0.0f)
+		{
+			layer.fadeElapsed += deltaTime;
+			const float progress = std::min(layer.fadeElapsed / layer.fadeDuration, 1.0f);
+			const float fadeIn = InterpolationMathUtil::easeInOutCosine(progress);
+
+			const int newest = layer.clipCount - 1;
+			for (int clip = 0; clip < newest; ++clip) layer.clips[clip].weight = layer.clips[clip].fadeFromWeight * (1.0f - fadeIn);
+			layer.clips[newest].weight = fadeIn;
+
+			if (progress >= 1.0f)
+			{
+				// only the clip that was faded to is left
+				layer.clips[0] = layer.clips[newest];
+				layer.clips[0].weight = 1.0f;
+				layer.clipCount = 1;
+				layer.fadeDuration = 0.0f;
+			}
+		}
+
+		if (layer.weightFadeSpeed > 0.0f)
+		{
+			const float step = layer.weightFadeSpeed * deltaTime;
+			if (std::fabs(layer.weightTarget - layer.weight) <= step)
+			{
+				layer.weight = layer.weightTarget;
+				layer.weightFadeSpeed = 0.0f;
+				if (layer.weight <= 0.0f) this->clearLayer(layerIndex);
+			}
+			else
+			{
+				layer.weight += layer.weightTarget > layer.weight ? step : -step;
+			}
+		}
+	}
+}
+
+bool AnimationBlendTree::hasClips() const
+{
+	for (const BlendLayer& layer : this->_layers)
+		if (layer.clipCount > 0) return true;
+	return false;
+}
+
+bool AnimationBlendTree::getSingleClip(Animation*& outAnimation, float& outTime) const
+{
+	const BlendLayer& base = this->_layers[0];
+	if (base.clipCount != 1 || base.mode != BlendMode::OVERRIDE || base.mask != nullptr || base.weight < 1.0f) return false;
+	for (int layer = 1; layer < MAX_LAYERS; ++layer)
+		if (this->_layers[layer].clipCount > 0 && this->_layers[layer].weight > 0.0f) return false;
+
+	outAnimation = base.clips[0].animation;
+	outTime = base.clips[0].time;
+	return true;
+}
+
+void AnimationBlendTree::evaluate()
+{
+	const AssimpNodeHierarchy& hierarchy = this->_animationSet->getHierarchy();
+	const int nodeCount = hierarchy.getNodeCount();
+	std::fill(this->_isNodeAnimated.begin(), this->_isNodeAnimated.end(), 0);
+
+	for (int layerIndex = 0; layerIndex < MAX_LAYERS; ++layerIndex)
+	{
+		const BlendLayer& layer = this->_layers[layerIndex];
+		if (layer.clipCount == 0 || layer.weight <= 0.0f) continue;
+
+		for (int clip = 0; clip < layer.clipCount; ++clip)
+		{
+			const int slot = layerIndex * BlendLayer::MAX_CLIPS + clip;
+			const BakedAnimation& baked = layer.clips[clip].animation->getBaked();
+			baked.sample(layer.clips[clip].time, this->_clipPoses[slot]);
+			if (layer.mode == BlendMode::ADDITIVE) baked.sample(0.0f, this->_referencePoses[slot]);
+		}
+
+		for (int node = 0; node < nodeCount; ++node)
+		{
+			const float weight = layer.weight * (layer.mask != nullptr ? layer.mask->weights[node] : 1.0f);
+			if (weight <= 0.0f) continue;
+
+			glm::vec3 translation;
+			glm::quat rotation;
+			glm::vec3 scale;
+			if (!this->blendLayerClips(layerIndex, node, translation, rotation, scale)) continue; // none of the clips animate it
+
+			if (!this->_isNodeAnimated[node])
+			{
+				this->_translations[node] = hierarchy.bindTranslations[node];
+				this->_rotations[node] = hierarchy.bindRotations[node];
+				this->_scales[node] = hierarchy.bindScales[node];
+				this->_isNodeAnimated[node] = 1;
+			}
+
+			if (layer.mode == BlendMode::OVERRIDE)
+			{
+				const glm::quat& current = this->_rotations[node];
+				if (glm::dot(current, rotation) < 0.0f) rotation = -rotation; // the short way around
+				this->_translations[node] = glm::mix(this->_translations[node], translation, weight);
+				this->_rotations[node] = glm::normalize(current * (1.0f - weight) + rotation * weight);
+				this->_scales[node] = glm::mix(this->_scales[node], scale, weight);
+			}
+			else
+			{
+				// (the clips gave deltas from their reference pose)
+				this->_translations[node] += translation * weight;
+				this->_rotations[node] = glm::normalize(this->_rotations[node] * glm::slerp(glm::quat(1.0f, 0.0f, 0.0f, 0.0f), rotation, weight));
+				this->_scales[node] *= glm::mix(glm::vec3(1.0f), scale, weight);
+			}
+		}
+	}
+}
+
+/**
+ * Weighted average of the clips of one layer for one node (deltas from the reference pose for ADDITIVE layers).
+ * False if none of the clips have a channel for the node.
+ */
+bool AnimationBlendTree::blendLayerClips(int layerIndex, int node, glm::vec3& outTranslation, glm::quat& outRotation, glm::vec3& outScale) const
+{
+	const BlendLayer& layer = this->_layers[layerIndex];
+	const bool isAdditive = layer.mode == BlendMode::ADDITIVE;
+
+	float totalWeight = 0.0f;
+	outTranslation = glm::vec3(0.0f);
+	outRotation = glm::quat(0.0f, 0.0f, 0.0f, 0.0f);
+	outScale = glm::vec3(0.0f);
+	for (int clip = 0; clip < layer.clipCount; ++clip)
+	{
+		const float weight = layer.clips[clip].weight;
+		const int channel = layer.clips[clip].animation->getNodeBinding(node).bone;
+		if (channel == -1 || weight <= 0.0f) continue;
+
+		const int slot = layerIndex * BlendLayer::MAX_CLIPS + clip;
+		const AnimationPose& pose = this->_clipPoses[slot];
+		glm::vec3 translation = pose.getTranslation(channel);
+		glm::quat rotation = pose.getRotation(channel);
+		glm::vec3 scale = pose.getScale(channel);
+		if (isAdditive)
+		{
+			const AnimationPose& reference = this->_referencePoses[slot];
+			translation -= reference.getTranslation(channel);
+			rotation = glm::inverse(reference.getRotation(channel)) * rotation;
+			scale /= reference.getScale(channel);
+		}
+
+		// all in the same hemisphere as the first one, so the weighted sum doesn't cancel itself out
+		if (totalWeight > 0.0f && glm::dot(outRotation, rotation) < 0.0f) rotation = -rotation;
+
+		outTranslation += translation * weight;
+		outRotation = outRotation + rotation * weight;
+		outScale += scale * weight;
+		totalWeight += weight;
+	}
+	if (totalWeight <= 0.0f) return false;
+
+	outTranslation /= totalWeight;
+	outRotation = glm::normalize(outRotation);
+	outScale /= totalWeight;
+	return true;
+}
+
+glm::mat4 AnimationBlendTree::getLocalTransform(int node) const
+{
+	if (!this->_isNodeAnimated[node]) return this->_animationSet->getHierarchy().transformations[node];
+	return Bone::composeTransform(this->_translations[node], this->_rotations[node], this->_scales[node]);
+}
@@ -0,0 +1,137 @@
+#ifndef ANIMATIONBLENDTREE_MINE_H
+#define ANIMATIONBLENDTREE_MINE_H
+#include <array>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/detail/type_quat.hpp>
+
+#include "AnimationSet.h"
+#include "BakedAnimation.h"
+
+enum class BlendMode
+{
+	OVERRIDE, // blends from whatever the layers below it came up with towards this layer's pose
+	ADDITIVE // adds this layer's motion (relative to the first frame of its clips) on top of the layers below it
+};
+
+/**
+ * \brief One playing clip within a BlendLayer
+ */
+struct BlendClip
+{
+	Animation* animation = nullptr;
+	float time = 0.0f; // in ticks
+	float weight = 1.0f; // relative to the other clips of the layer
+	float fadeFromWeight = 0.0f; // weight at the start of the layer's cross fade
+};
+
+struct BlendLayer
+{
+	static constexpr int MAX_CLIPS = 4;
+
+	std::array<BlendClip, MAX_CLIPS> clips;
+	int clipCount = 0;
+
+	BlendMode mode = BlendMode::OVERRIDE;
+	const BoneMask* mask = nullptr; // per node weight, nullptr for the whole skeleton. Must outlive its use in the layer
+	float weight = 1.0f;
+
+	// cross fade towards the last clip (see AnimationBlendTree::crossFade())
+	float fadeDuration = 0.0f;
+	float fadeElapsed = 0.0f;
+
+	// layer weight fade (see AnimationBlendTree::fadeLayer())
+	float weightTarget = 1.0f;
+	float weightFadeSpeed = 0.0f; // per second
+};
+
+/**
+ * \brief A small stack of animation layers, evaluated bottom to top into local (translation, rotation, scale) per hierarchy node.
+ *
+ * Every layer blends up to BlendLayer::MAX_CLIPS clips by their relative weights (N-way blend), and is then applied with its own
+ * weight, optionally scaled per node by a BoneMask. That covers cross fades (crossFade()), upper body animations over a full body
+ * one (an OVERRIDE layer with a BoneMask from AnimationSet::createBoneMask()) and additive motion (an ADDITIVE layer).
+ *
+ * Everything it needs while evaluating (sampled poses for every clip slot, the per node results) is allocated up front for the
+ * largest animation of the AnimationSet, so evaluating and advancing do not allocate.
+ */
+class AnimationBlendTree
+{
+public:
+	static constexpr int MAX_LAYERS = 4;
+
+	AnimationBlendTree(const AnimationSet* animationSet);
+
+	/**
+	 * \brief Removes all clips from all layers and resets them to plain OVERRIDE layers of weight 1
+	 */
+	void clear();
+
+	/**
+	 * \brief Makes this clip the only one in the layer, from its start
+	 */
+	void play(int layer, Animation* animation);
+
+	/**
+	 * \brief Fades the layer over from whatever it is playing to this clip (from its start), with an ease in/out.
+	 * Starting a cross fade while one is still going on fades out all of the clips that were playing, by their weight at that moment.
+	 * If the layer is empty or duration is 0, same as play().
+	 */
+	void crossFade(int layer, Animation* animation, float duration);
+
+	void setLayerMode(int layer, BlendMode mode, const BoneMask* mask = nullptr);
+
+	/**
+	 * \brief Sets the weight of the layer right away (stops a fadeLayer() that's going on). Unlike a fade, a weight of 0 keeps the clips
+	 */
+	void setLayerWeight(int layer, float weight);
+
+	/**
+	 * \brief Moves the weight of the layer to targetWeight over the duration. A layer that fades out to 0 is cleared once it gets there.
+	 */
+	void fadeLayer(int layer, float targetWeight, float duration);
+
+	void clearLayer(int layer);
+
+	const BlendLayer& getLayer(int layer) const;
+
+	/**
+	 * \brief Moves the clip times and the fades forward
+	 */
+	void advance(float deltaTime);
+
+	bool hasClips() const;
+
+	/**
+	 * \brief Whether this comes down to playing a single clip on its own (a cheaper path, see Animator::calculateBoneTransform())
+	 */
+	bool getSingleClip(Animation*& outAnimation, float& outTime) const;
+
+	/**
+	 * \brief Samples all clips and blends the layers. The result is read with getLocalTransform()
+	 */
+	void evaluate();
+
+	/**
+	 * \brief Local transform of a node after evaluate(). Nodes none of the layers animate keep their bind transform.
+	 */
+	glm::mat4 getLocalTransform(int node) const;
+
+private:
+	const AnimationSet* _animationSet;
+	std::array<BlendLayer, MAX_LAYERS> _layers;
+
+	// pools, allocated once
+	std::array<AnimationPose, MAX_LAYERS * BlendLayer::MAX_CLIPS> _clipPoses; // per clip slot
+	std::array<AnimationPose, MAX_LAYERS * BlendLayer::MAX_CLIPS> _referencePoses; // per clip slot, the first frame (ADDITIVE layers only)
+	std::vector<glm::vec3> _translations; // per node
+	std::vector<glm::quat> _rotations; // ^
+	std::vector<glm::vec3> _scales; // ^
+	std::vector<char> _isNodeAnimated; // ^
+
+	BlendLayer& getCheckedLayer(int layer);
+	void removeClip(BlendLayer& layer, int clip);
+	bool blendLayerClips(int layerIndex, int node, glm::vec3& outTranslation, glm::quat& outRotation, glm::vec3& outScale) const;
+};
+
+#endif
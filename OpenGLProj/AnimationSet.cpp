@@ -1,28 +1,71 @@
 ﻿#include "AnimationSet.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
-#include <assimp/postprocess.h>
+#include <assimp/Importer.hpp>
+#include <glm/gtc/quaternion.hpp>
 
-#include "MathConversionUtil.h"
+#include "MappedFile.h"
 
-AnimationSet::AnimationSet(const std::string& animationPath, Model* model)
-{
-	Assimp::Importer importer;
-	std::cout << "Loading animation file '" << animationPath << "'" << std::endl;
-	const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
-	if (!scene || !scene->mRootNode) throw std::exception("Animation could not be found!");
-
-	const int animationCount = scene->mNumAnimations;
+constexpr auto ANIMATION_CACHE_EXTENSION = ".animcache"; // cooked cache lives right next to the file, like the model's
+constexpr auto ANIMATION_CACHE_MAGIC = "ANMC";
+constexpr auto ANIMATION_CACHE_VERSION = 1u;
 
-	std::cout << "Found " << animationCount << " animations for file '" << animationPath << "'" << std::endl;
+/**
+ * Only what the animations need from the file: no post processing at all (none of the mesh steps of Model::importScene() touch
+ * the node tree or the animations anyway)
+ */
+static const aiScene* importAnimations(Assimp::Importer& importer, const std::string& path)
+{
+	std::cout << "Loading animations: '" << path << "'" << std::endl;
+	const aiScene* scene = importer.ReadFile(path, 0);
+	if (!scene || !scene->mRootNode) // (AI_SCENE_FLAGS_INCOMPLETE is fine, that's only about the meshes)
+	{
+		std::cout << "Error::ASSIMP::" << importer.GetErrorString() << std::endl;
+		return nullptr;
+	}
+	return scene;
+}
 
-	this->readHierarchyData(this->_rootNode, scene->mRootNode);
+AnimationSet::AnimationSet(const std::string& path, const aiScene* scene, Model* model, const AnimationBakeTolerance& bakeTolerance)
+{
+	this->readHierarchyData(model->getSkeleton());
+	this->computeRelativeNodeSizes();
 
-	for (int i = 0; i < animationCount; ++i)
+	const std::string cachePath = path + ANIMATION_CACHE_EXTENSION;
+	if (this->readCache(cachePath, path, model))
 	{
-		aiAnimation* anim = scene->mAnimations[i];
-		this->_animations[anim->mName.C_Str()] = Animation(anim, model);
+		std::cout << "Loaded " << this->_animations.size() << " animations from cache: '" << cachePath << "'" << std::endl;
+	}
+	else
+	{
+		std::cout << "Animation cache missing or stale, loading animations: '" << path << "'" << std::endl;
+		Assimp::Importer importer;
+		if (scene == nullptr) scene = importAnimations(importer, path);
+		if (scene == nullptr) throw std::exception("Animation could not be found!");
+
+		const int animationCount = scene->mNumAnimations;
+		std::cout << "Found " << animationCount << " animations" << std::endl;
+		for (int i = 0; i < animationCount; ++i)
+		{
+			aiAnimation* anim = scene->mAnimations[i];
+			this->_animations[anim->mName.C_Str()] = Animation(anim, model, this->_hierarchy, bakeTolerance);
+		}
+		this->writeCache(cachePath, path);
 	}
+	this->_boneCount = model->getBoneCount(); // (only final once all the animations are loaded)
+}
+
+void AnimationSet::cookCache(const std::string& path, const AnimationBakeTolerance& bakeTolerance)
+{
+	ModelSource source;
+	if (!Model::prepare(path, nullptr, source)) return;
+	Model model(source); // (just the bones and the skeleton, nothing gets uploaded)
+	AnimationSet animationSet(path, nullptr, &model, bakeTolerance);
 }
 
 int AnimationSet::getAnimationCount() const
@@ -36,23 +79,324 @@ Animation* AnimationSet::getAnimation(const std::string& animationName)
 	return &this->_animations[animationName];
 }
 
-const AssimpNodeData& AnimationSet::getRootNode() const
+const AssimpNodeHierarchy& AnimationSet::getHierarchy() const
+{
+	return this->_hierarchy;
+}
+
+int AnimationSet::getBoneCount() const
+{
+	return this->_boneCount;
+}
+
+int AnimationSet::getMaxChannelCount() const
+{
+	int maxChannels = 0;
+	for (const auto& [name, animation] : this->_animations)
+		maxChannels = std::max(maxChannels, animation.getBaked().getChannelCount());
+	return maxChannels;
+}
+
+BoneMask AnimationSet::createBoneMask(const std::string& rootNodeName) const
+{
+	BoneMask mask;
+	mask.weights.assign(this->_hierarchy.getNodeCount(), 0.0f);
+
+	const auto root = std::find(this->_hierarchy.names.begin(), this->_hierarchy.names.end(), rootNodeName);
+	if (root == this->_hierarchy.names.end())
+	{
+		std::cout << "WARNING: no node '" << rootNodeName << "' for the bone mask, it won't affect anything" << std::endl;
+		return mask;
+	}
+
+	// parents come before their children, so the weight only has to be passed down in one forward loop
+	const int rootIndex = (int)(root - this->_hierarchy.names.begin());
+	mask.weights[rootIndex] = 1.0f;
+	for (int node = rootIndex + 1; node < this->_hierarchy.getNodeCount(); ++node)
+	{
+		const int parent = this->_hierarchy.parents[node];
+		if (parent != -1) mask.weights[node] = mask.weights[parent];
+	}
+	return mask;
+}
+
+/**
+ * The model's node tree (already depth first, so a node always comes before any of its children), plus the bind transformations taken apart
+ */
+void AnimationSet::readHierarchyData(const AssimpNodeHierarchy& skeleton)
+{
+	this->_hierarchy.parents = skeleton.parents;
+	this->_hierarchy.transformations = skeleton.transformations;
+	this->_hierarchy.names = skeleton.names;
+
+	for (const glm::mat4& transformation : skeleton.transformations)
+	{
+		// (assumes no shear, like the channels themselves)
+		const glm::vec3 scale(glm::length(glm::vec3(transformation[0])), glm::length(glm::vec3(transformation[1])), glm::length(glm::vec3(transformation[2])));
+		const glm::mat3 rotation(glm::vec3(transformation[0]) / scale.x, glm::vec3(transformation[1]) / scale.y, glm::vec3(transformation[2]) / scale.z);
+		this->_hierarchy.bindTranslations.emplace_back(transformation[3]);
+		this->_hierarchy.bindRotations.push_back(glm::normalize(glm::quat_cast(rotation)));
+		this->_hierarchy.bindScales.push_back(scale);
+	}
+}
+
+/**
+ * How "big" every node is, for the animation LOD (see AnimationLodSettings::smallBoneSize): fingers and toes end up small,
+ * arms/legs/spine large. Children always come after their parent, so going backwards every node is done before its parent
+ */
+void AnimationSet::computeRelativeNodeSizes()
+{
+	std::vector<float>& sizes = this->_hierarchy.relativeSizes;
+	sizes.assign(this->_hierarchy.getNodeCount(), 0.0f);
+	for (int node = this->_hierarchy.getNodeCount() - 1; node > 0; --node)
+	{
+		const int parent = this->_hierarchy.parents[node];
+		const float boneLength = glm::length(glm::vec3(this->_hierarchy.transformations[node][3]));
+		sizes[parent] = std::max(sizes[parent], boneLength + sizes[node]);
+	}
+
+	const float skeletonSize = sizes.empty() ? 0.0f : sizes[0];
+	for (float& size : sizes) size = skeletonSize > 0.0f ? size / skeletonSize : 1.0f;
+}
+
+#pragma region CACHE
+
+/**
+ * Layout of the cooked cache file:
+ *	- AnimationCacheHeader
+ *	- animationCount AnimationCacheAnimation
+ *	- channelCount AnimationCacheChannel (all animations one after the other)
+ *	- positionKeyCount KeyPosition (all channels one after the other)
+ *	- rotationKeyCount KeyRotation (^)
+ *	- scaleKeyCount KeyScale (^)
+ *	- frameValueCount float (the baked frames of all animations, see BakedAnimation::getFrames())
+ *	- stringsSize chars (all names, not null terminated)
+ *
+ * Same rules as the model cache: stored exactly the way it's laid out in memory, and any change to how the animations are read
+ * or baked, or to these structs, must bump ANIMATION_CACHE_VERSION.
+ */
+struct AnimationCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceFileSize;
+	int64_t sourceWriteTime;
+	uint64_t animationCount;
+	uint64_t channelCount;
+	uint64_t positionKeyCount;
+	uint64_t rotationKeyCount;
+	uint64_t scaleKeyCount;
+	uint64_t frameValueCount;
+	uint64_t stringsSize;
+};
+
+struct AnimationCacheString
+{
+	uint32_t offset; // in the strings at the end of the file
+	uint32_t length;
+};
+
+struct AnimationCacheAnimation
+{
+	AnimationCacheString name;
+	float duration;
+	int32_t ticksPerSecond;
+	uint64_t firstChannel;
+	uint64_t channelCount;
+	int32_t frameCount;
+	float ticksPerFrame;
+	float samplesPerSecond;
+	uint64_t firstFrameValue;
+};
+
+struct AnimationCacheChannel
+{
+	AnimationCacheString name;
+	uint64_t firstPosition;
+	uint64_t positionCount;
+	uint64_t firstRotation;
+	uint64_t rotationCount;
+	uint64_t firstScale;
+	uint64_t scaleCount;
+};
+
+static AnimationCacheHeader makeCacheKey(const std::string& sourcePath)
+{
+	AnimationCacheHeader key = {};
+	memcpy(key.magic, ANIMATION_CACHE_MAGIC, sizeof(key.magic));
+	key.version = ANIMATION_CACHE_VERSION;
+	key.sourceFileSize = std::filesystem::file_size(sourcePath);
+	key.sourceWriteTime = std::filesystem::last_write_time(sourcePath).time_since_epoch().count();
+	return key;
+}
+
+static size_t getCacheFileSize(const AnimationCacheHeader& header)
 {
-	return this->_rootNode;
+	return sizeof(AnimationCacheHeader)
+		+ header.animationCount * sizeof(AnimationCacheAnimation)
+		+ header.channelCount * sizeof(AnimationCacheChannel)
+		+ header.positionKeyCount * sizeof(KeyPosition)
+		+ header.rotationKeyCount * sizeof(KeyRotation)
+		+ header.scaleKeyCount * sizeof(KeyScale)
+		+ header.frameValueCount * sizeof(float)
+		+ header.stringsSize;
+}
+
+/**
+ * Leaves the set (and the model) untouched if the cache can't be used: missing, stale or damaged
+ */
+bool AnimationSet::readCache(const std::string& cachePath, const std::string& sourcePath, Model* model)
+{
+	MappedFile file;
+	if (!std::filesystem::exists(sourcePath) || !file.open(cachePath) || file.getSize() < sizeof(AnimationCacheHeader)) return false;
+
+	AnimationCacheHeader header;
+	memcpy(&header, file.getData(), sizeof(AnimationCacheHeader));
+	const AnimationCacheHeader expected = makeCacheKey(sourcePath);
+	const bool isUpToDate = memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+		&& header.version == expected.version
+		&& header.sourceFileSize == expected.sourceFileSize
+		&& header.sourceWriteTime == expected.sourceWriteTime
+		&& file.getSize() == getCacheFileSize(header);
+	if (!isUpToDate) return false;
+
+	const unsigned char* cursor = file.getData() + sizeof(AnimationCacheHeader);
+	auto readRecords = [&cursor]<typename T>(std::vector<T>& records, uint64_t count)
+	{
+		records.resize(count);
+		memcpy(records.data(), cursor, count * sizeof(T));
+		cursor += count * sizeof(T);
+	};
+	std::vector<AnimationCacheAnimation> animations;
+	std::vector<AnimationCacheChannel> channels;
+	std::vector<KeyPosition> positions;
+	std::vector<KeyRotation> rotations;
+	std::vector<KeyScale> scales;
+	std::vector<float> frameValues;
+	readRecords(animations, header.animationCount);
+	readRecords(channels, header.channelCount);
+	readRecords(positions, header.positionKeyCount);
+	readRecords(rotations, header.rotationKeyCount);
+	readRecords(scales, header.scaleKeyCount);
+	readRecords(frameValues, header.frameValueCount);
+	const char* strings = reinterpret_cast<const char*>(cursor);
+
+	// everything is checked before anything is created (or added to the model), a damaged cache is just treated as a stale one
+	auto isValid = [&header](const AnimationCacheString& string) { return (uint64_t)string.offset + string.length <= header.stringsSize; };
+	auto isValidRange = [](uint64_t first, uint64_t count, uint64_t total) { return count <= total && first <= total - count; };
+	bool isDamaged = false;
+	for (const AnimationCacheAnimation& animation : animations)
+	{
+		const uint64_t stride = (animation.channelCount + 3) & ~3ull;
+		isDamaged |= !isValid(animation.name) || !isValidRange(animation.firstChannel, animation.channelCount, header.channelCount)
+			|| animation.frameCount < 0 || (animation.frameCount > 0 && !(animation.ticksPerFrame > 0.0f))
+			|| !isValidRange(animation.firstFrameValue, (uint64_t)animation.frameCount * AnimationPose::COMPONENT_COUNT * stride, header.frameValueCount);
+	}
+	for (const AnimationCacheChannel& channel : channels)
+	{
+		// (Bone needs at least one key per track)
+		isDamaged |= !isValid(channel.name)
+			|| channel.positionCount == 0 || !isValidRange(channel.firstPosition, channel.positionCount, header.positionKeyCount)
+			|| channel.rotationCount == 0 || !isValidRange(channel.firstRotation, channel.rotationCount, header.rotationKeyCount)
+			|| channel.scaleCount == 0 || !isValidRange(channel.firstScale, channel.scaleCount, header.scaleKeyCount);
+	}
+	if (isDamaged) return false;
+
+	auto readString = [strings](const AnimationCacheString& string) { return std::string(strings + string.offset, string.length); };
+
+	for (const AnimationCacheAnimation& animation : animations)
+	{
+		std::vector<BoneKeys> animationChannels(animation.channelCount);
+		for (uint64_t i = 0; i < animation.channelCount; ++i)
+		{
+			const AnimationCacheChannel& channel = channels[animation.firstChannel + i];
+			BoneKeys& keys = animationChannels[i];
+			keys.name = readString(channel.name);
+			keys.positions.assign(positions.begin() + channel.firstPosition, positions.begin() + channel.firstPosition + channel.positionCount);
+			keys.rotations.assign(rotations.begin() + channel.firstRotation, rotations.begin() + channel.firstRotation + channel.rotationCount);
+			keys.scales.assign(scales.begin() + channel.firstScale, scales.begin() + channel.firstScale + channel.scaleCount);
+		}
+
+		const uint64_t stride = (animation.channelCount + 3) & ~3ull;
+		const auto firstFrameValue = frameValues.begin() + animation.firstFrameValue;
+		std::vector<float> frames(firstFrameValue, firstFrameValue + animation.frameCount * AnimationPose::COMPONENT_COUNT * stride);
+		BakedAnimation baked((int)animation.channelCount, animation.frameCount, animation.ticksPerFrame, animation.samplesPerSecond, std::move(frames));
+
+		this->_animations[readString(animation.name)] = Animation(animation.duration, animation.ticksPerSecond, animationChannels, std::move(baked), model, this->_hierarchy);
+	}
+	return true;
 }
 
-void AnimationSet::readHierarchyData(AssimpNodeData& dest, const aiNode* src)
+void AnimationSet::writeCache(const std::string& cachePath, const std::string& sourcePath) const
 {
-	assert(src);
+	std::string strings;
+	auto addString = [&strings](const std::string& string)
+	{
+		const AnimationCacheString stored = { (uint32_t)strings.size(), (uint32_t)string.size() };
+		strings += string;
+		return stored;
+	};
+
+	std::vector<AnimationCacheAnimation> animations;
+	std::vector<AnimationCacheChannel> channels;
+	std::vector<KeyPosition> positions;
+	std::vector<KeyRotation> rotations;
+	std::vector<KeyScale> scales;
+	std::vector<float> frameValues;
+	for (const auto& [name, animation] : this->_animations)
+	{
+		const BakedAnimation& baked = animation.getBaked();
+		animations.push_back({
+			addString(name), animation.getDuration(), (int32_t)animation.getTicksPerSecond(), channels.size(), animation.getBones().size(),
+			baked.getFrameCount(), baked.getTicksPerFrame(), baked.getSamplesPerSecond(), frameValues.size()
+		});
+		frameValues.insert(frameValues.end(), baked.getFrames().begin(), baked.getFrames().end());
 
-	dest.name = src->mName.data;
-	dest.transformation = MathConversionUtil::convert(src->mTransformation);
-	dest.childrenCount = src->mNumChildren;
+		for (const Bone& bone : animation.getBones())
+		{
+			channels.push_back({
+				addString(bone.getBoneName()),
+				positions.size(), bone.getPositionKeys().size(),
+				rotations.size(), bone.getRotationKeys().size(),
+				scales.size(), bone.getScaleKeys().size()
+			});
+			positions.insert(positions.end(), bone.getPositionKeys().begin(), bone.getPositionKeys().end());
+			rotations.insert(rotations.end(), bone.getRotationKeys().begin(), bone.getRotationKeys().end());
+			scales.insert(scales.end(), bone.getScaleKeys().begin(), bone.getScaleKeys().end());
+		}
+	}
+
+	AnimationCacheHeader header = makeCacheKey(sourcePath);
+	header.animationCount = animations.size();
+	header.channelCount = channels.size();
+	header.positionKeyCount = positions.size();
+	header.rotationKeyCount = rotations.size();
+	header.scaleKeyCount = scales.size();
+	header.frameValueCount = frameValues.size();
+	header.stringsSize = strings.size();
 
-	for (int i = 0; i < src->mNumChildren; ++i)
+	// written to a temporary file first so a cache is never left half-written
+	const std::string tempPath = cachePath + ".tmp";
 	{
-		AssimpNodeData newData;
-		this->readHierarchyData(newData, src->mChildren[i]);
-		dest.children.push_back(newData);
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(animations.data()), animations.size() * sizeof(AnimationCacheAnimation));
+		out.write(reinterpret_cast<const char*>(channels.data()), channels.size() * sizeof(AnimationCacheChannel));
+		out.write(reinterpret_cast<const char*>(positions.data()), positions.size() * sizeof(KeyPosition));
+		out.write(reinterpret_cast<const char*>(rotations.data()), rotations.size() * sizeof(KeyRotation));
+		out.write(reinterpret_cast<const char*>(scales.data()), scales.size() * sizeof(KeyScale));
+		out.write(reinterpret_cast<const char*>(frameValues.data()), frameValues.size() * sizeof(float));
+		out.write(strings.data(), strings.size());
+		if (!out)
+		{
+			std::cout << "Could not write animation cache: '" << cachePath << "'" << std::endl; // not fatal, just slower next time
+			return;
+		}
 	}
-}
\ No newline at end of file
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error) std::cout << "Could not write animation cache: '" << cachePath << "' (" << error.message() << ")" << std::endl;
+}
+
+#pragma endregion
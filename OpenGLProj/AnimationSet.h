@@ -4,14 +4,39 @@
 #include "Animation.h"
 #include "Model.h"
 
+/**
+ * \brief Weight per hierarchy node (by node index) for playing an animation on only part of the skeleton (see AnimationBlendTree)
+ */
+struct BoneMask
+{
+	std::vector<float> weights;
+};
+
 /**
  * \brief A container for several animations belonging to a given model.
  * Allows retrieving animations by the name defined in the source file for the model.
+ *
+ * The node hierarchy is the model's skeleton, and the animations (keyframes and baked frames) are cooked into a binary file right
+ * next to the source file, like the model itself (see Model). So the file is only imported when that cache is missing or stale.
  */
 class AnimationSet
 {
 public:
-	AnimationSet(const std::string& animationPath, Model* model);
+	/**
+	 * \param path				of the file with the animations (and the model)
+	 * \param scene				optional, the file already imported (e.g. with Model::importScene(), see AssetRegistry). Only used if the cache is stale,
+	 *							otherwise the file gets imported with just what the animations need
+	 * \param model				loaded from the same file. Gets the bones only the animations use added to it
+	 * \param bakeTolerance		how close the baked animations must stay to the keyframes in the file (picks the bake rate, see BakedAnimation).
+	 *							Only applies when the cache is missing or stale, the cache keeps what it was cooked with
+	 */
+	AnimationSet(const std::string& path, const aiScene* scene, Model* model, const AnimationBakeTolerance& bakeTolerance = AnimationBakeTolerance());
+
+	/**
+	 * \brief Offline "cook" step: makes sure the cooked cache of the animations in this file is up to date (without needing an OpenGL context).
+	 * Cook the model first (see Model::cookCache()), the animations are played on its skeleton.
+	 */
+	static void cookCache(const std::string& path, const AnimationBakeTolerance& bakeTolerance = AnimationBakeTolerance());
 
 	/**
 	 * \brief get number of animations for this model
@@ -25,13 +50,33 @@ public:
 	 */
 	Animation* getAnimation(const std::string& animationName);
 
-	const AssimpNodeData& getRootNode() const;
+	const AssimpNodeHierarchy& getHierarchy() const;
+
+	/**
+	 * \brief Number of bone matrices the model uses (its bones plus the ones the animations added)
+	 */
+	int getBoneCount() const;
+
+	/**
+	 * \brief Most channels any of the animations has (what a pose needs room for)
+	 */
+	int getMaxChannelCount() const;
+
+	/**
+	 * \brief Mask with weight 1 for the node with this name and everything below it, 0 for the rest of the skeleton.
+	 * E.g. the first spine node for the upper body.
+	 */
+	BoneMask createBoneMask(const std::string& rootNodeName) const;
 
 private:
 	std::map<const std::string, Animation> _animations;
-	AssimpNodeData _rootNode;
+	AssimpNodeHierarchy _hierarchy;
+	int _boneCount = 0;
 
-	void readHierarchyData(AssimpNodeData& dest, const aiNode* src);
+	void readHierarchyData(const AssimpNodeHierarchy& skeleton);
+	void computeRelativeNodeSizes();
+	bool readCache(const std::string& cachePath, const std::string& sourcePath, Model* model);
+	void writeCache(const std::string& cachePath, const std::string& sourcePath) const;
 };
 
 #endif
\ No newline at end of file
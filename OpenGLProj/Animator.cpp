@@ -1,67 +1,195 @@
 ﻿#include "Animator.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include "AnimationSet.h"
+#include "ThreadPool.h"
 
 #define MAX_BONES 100
 
-// TODO: rewrite the interpolated dual animation stuff because it is confusing and I did it last minute to get it into the opdracht limits
-
 Animator::Animator(AnimationSet* animation)
 :
 _animationManager(animation),
-_currentAnimation(nullptr),
-_currentTime(0.0f)
+_blendTree(animation)
 {
+	// every animator gets the next phase, so the ones on a reduced rate don't all compute their pose on the same frame
+	static unsigned int nextLodPhase = 0;
+	this->_lodPhase = nextLodPhase++;
+
 	this->_finalBoneMatrices.reserve(MAX_BONES);
 
 	for (int i = 0; i < MAX_BONES; ++i)
 		this->_finalBoneMatrices.emplace_back(1.0f);
+
+	this->_globalTransforms.resize(this->_animationManager->getHierarchy().getNodeCount(), glm::mat4(1.0f));
+	this->_localTransforms = this->_animationManager->getHierarchy().transformations;
+	this->_pose.values.reserve((size_t)AnimationPose::COMPONENT_COUNT * ((this->_animationManager->getMaxChannelCount() + 3) & ~3));
 }
 
 void Animator::updateAnimation(float deltaTime)
 {
-	this->_deltaTime = deltaTime;
-	if (this->_currentAnimation)
-	{
-		this->_currentTime += this->_currentAnimation->getTicksPerSecond() * deltaTime;
-		this->_currentTime = fmod(this->_currentTime, this->_currentAnimation->getDuration());
+	this->_blendTree.advance(deltaTime);
+	if (this->_blendTree.hasClips())
+		this->_pendingPose = PendingPose::BLENDED; // compute transforms from root node (see evaluate(), which also finds out if it's really just SINGLE)
+}
 
-		this->calculateBoneTransform(&this->_animationManager->getRootNode(), glm::mat4(1.0f)); // compute transforms from root node
+void Animator::evaluate()
+{
+	if (this->resolvePendingPose()) this->computePendingPose();
+}
+
+/**
+ * Applies the LOD and drops what can't be computed (anymore). Returns whether there's still a pose to compute
+ */
+bool Animator::resolvePendingPose()
+{
+	if (this->_pendingPose == PendingPose::NONE) return false;
+	if (!this->isPoseDue())
+	{
+		// holds the previous pose this frame (see updateLod())
+		this->_pendingPose = PendingPose::NONE;
+		return false;
 	}
+
+	// (the animations may have been switched since the update)
+	if (!this->_blendTree.hasClips())
+		this->_pendingPose = PendingPose::NONE;
+	else if (this->_blendTree.getSingleClip(this->_pendingAnimation, this->_pendingSampleTime))
+		this->_pendingPose = PendingPose::SINGLE;
+	else
+		this->_pendingPose = PendingPose::BLENDED;
+
+	return this->_pendingPose != PendingPose::NONE;
 }
 
-void Animator::updateAnimation2(float deltaTime, float interpolationFactor)
+void Animator::computePendingPose()
 {
-	this->_deltaTime = deltaTime;
-	if (this->_currentAnimation && this->_currentAnimation2)
+	this->_sharedPoseSource = nullptr;
+	switch (this->_pendingPose)
 	{
-		this->_currentTime += this->_currentAnimation->getTicksPerSecond() * deltaTime;
-		this->_currentTime = fmod(this->_currentTime, this->_currentAnimation->getDuration());
+	case PendingPose::SINGLE:
+		this->calculateBoneTransformAt(this->_pendingAnimation, this->_pendingSampleTime);
+		break;
+	case PendingPose::BLENDED:
+		this->calculateBlendedBoneTransform();
+		break;
+	case PendingPose::NONE:
+		break;
+	}
+	this->_pendingPose = PendingPose::NONE;
+}
 
-		this->_currentTime2 += this->_currentAnimation2->getTicksPerSecond() * deltaTime;
-		this->_currentTime2 = fmod(this->_currentTime2, this->_currentAnimation2->getDuration());
+void Animator::setLodSettings(const AnimationLodSettings& settings)
+{
+	this->_lodSettings = settings;
+}
 
-		this->calculateBoneTransform2(&this->_animationManager->getRootNode(), glm::mat4(1.0f), interpolationFactor); // compute transforms from root node
+void Animator::updateLod(float screenSize, bool visible)
+{
+	const AnimationLodSettings& lod = this->_lodSettings;
+	if (!visible)
+		this->_lodInterval = lod.freezeWhenHidden ? 0 : lod.lowRateInterval;
+	else if (screenSize < lod.lowRateScreenSize)
+		this->_lodInterval = lod.lowRateInterval;
+	else if (screenSize < lod.reducedRateScreenSize)
+		this->_lodInterval = lod.reducedRateInterval;
+	else
+		this->_lodInterval = 1;
+
+	this->_lodSkipSmallNodes = !visible || screenSize < lod.smallBoneScreenSize;
+}
+
+bool Animator::isPoseDue()
+{
+	const unsigned int frame = this->_lodFrame++;
+	if (this->_lodInterval <= 0)
+	{
+		this->_poseOverdue = true; // so it updates right away once it's unfrozen
+		return false;
+	}
+	if (this->_poseOverdue)
+	{
+		this->_poseOverdue = false;
+		return true;
 	}
+	return (frame + this->_lodPhase) % (unsigned int)this->_lodInterval == 0;
 }
 
-void Animator::flipAnimation1And2()
+bool Animator::isHeldByLod(const AssimpNodeHierarchy& hierarchy, int node) const
 {
-	auto tmp = this->_currentAnimation;
-	auto tmp2 = this->_currentTime;
-	this->_currentAnimation = this->_currentAnimation2;
-	this->_currentTime = this->_currentTime2;
+	return this->_lodSkipSmallNodes && hierarchy.relativeSizes[node] < this->_lodSettings.smallBoneSize;
+}
+
+bool Animator::getPoseKey(float timeStep, PoseKey& outKey, float& outSampleTime) const
+{
+	if (this->_pendingPose != PendingPose::SINGLE || this->_lodSkipSmallNodes) return false; // depends on more than the key
+
+	const float ticksPerStep = timeStep * this->_pendingAnimation->getTicksPerSecond();
+	if (!(ticksPerStep > 0.0f)) return false;
 
-	this->_currentAnimation2 = tmp;
-	this->_currentTime2 = tmp2;
+	const int step = (int)(this->_pendingSampleTime / ticksPerStep);
+	outKey = { this->_animationManager, this->_pendingAnimation, step };
+	outSampleTime = (float)step * ticksPerStep; // (never past the current time, so always within the animation)
+	return true;
 }
 
-void Animator::clearAnimation2()
+void Animator::copyPoseFrom(const Animator& source)
 {
-	this->_currentAnimation2 = nullptr;
-	this->_currentTime2 = 0.0f;
+	// same AnimationSet (it's part of the key), so the same bones and nodes
+	std::copy_n(source._finalBoneMatrices.begin(), source.getUsedBoneCount(), this->_finalBoneMatrices.begin());
+	std::copy(source._localTransforms.begin(), source._localTransforms.end(), this->_localTransforms.begin());
+
+	this->_pendingPose = PendingPose::NONE;
+	this->_poseVersion++;
+	this->_sharedPoseSource = &source;
+	this->_sharedPoseSourceVersion = source._poseVersion;
+}
+
+void Animator::evaluateAll(const std::vector<Animator*>& animators, PoseCache* cache)
+{
+	if (cache == nullptr)
+	{
+		ThreadPool::getShared().parallelFor(0, (unsigned int)animators.size(), [&animators](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; ++i) animators[i]->evaluate();
+		});
+		return;
+	}
+
+	// everything is resolved up front, so the animators that end up with the same pose are known before any of it is computed
+	cache->beginFrame();
+	for (int i = 0; i < (int)animators.size(); ++i)
+	{
+		Animator* animator = animators[i];
+		animator->_poseOwner = nullptr;
+		if (!animator->resolvePendingPose()) continue;
+
+		PoseKey key;
+		float sampleTime;
+		if (!animator->getPoseKey(cache->getTimeStep(), key, sampleTime)) continue;
+
+		// only a pose that is actually shared gets snapped to the start of its step (same key, so the same time for the owner and this one),
+		// an animator alone on its key keeps sampling at its exact time
+		const int owner = cache->lookup(key, i);
+		if (owner == -1) continue;
+		animators[owner]->_pendingSampleTime = sampleTime;
+		animator->_poseOwner = animators[owner];
+	}
+
+	ThreadPool::getShared().parallelFor(0, (unsigned int)animators.size(), [&animators](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			Animator* animator = animators[i];
+			if (animator->_poseOwner == nullptr && animator->_pendingPose != PendingPose::NONE) animator->computePendingPose();
+		}
+	});
+
+	for (Animator* animator : animators)
+	{
+		if (animator->_poseOwner != nullptr) animator->copyPoseFrom(*animator->_poseOwner);
+	}
 }
 
 Animation* Animator::getAnimationByName(const std::string& animationName) const
@@ -71,118 +199,115 @@ Animation* Animator::getAnimationByName(const std::string& animationName) const
 
 void Animator::playAnimation(Animation* animation)
 {
-	this->_currentAnimation = animation;
-	this->_currentTime = 0.0f;
-	this->_currentAnimation2 = nullptr;
-	this->_currentTime2 = 0.0f;
+	this->_blendTree.clear();
+	this->_blendTree.play(0, animation);
 }
 
 void Animator::playAnimation(const std::string& animationName)
 {
-	Animation* animation = this->_animationManager->getAnimation(animationName);
-	this->_currentAnimation = animation;
-	this->_currentTime = 0.0f;
-	this->_currentAnimation2 = nullptr;
-	this->_currentTime2 = 0.0f;
+	this->playAnimation(this->_animationManager->getAnimation(animationName));
 }
 
-void Animator::playAnimations(Animation* animation1, Animation* animation2)
+AnimationBlendTree& Animator::getBlendTree()
 {
-	this->_currentAnimation = animation1;
-	this->_currentTime = 0.0f;
-	this->_currentAnimation2 = animation2;
-	this->_currentTime2 = 0.0f;
+	return this->_blendTree;
 }
 
-void Animator::startPlaying2ndAnimation(Animation* animation2)
+void Animator::calculateBoneTransform()
 {
-	this->_currentAnimation2 = animation2;
-	this->_currentTime2 = 0.0f;
+	Animation* animation;
+	float animationTime;
+	if (this->_blendTree.getSingleClip(animation, animationTime))
+		this->calculateBoneTransformAt(animation, animationTime);
+	else if (this->_blendTree.hasClips())
+		this->calculateBlendedBoneTransform();
 }
 
-void Animator::calculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
+void Animator::calculateBoneTransformAt(Animation* animation, float animationTime)
 {
-	const std::string nodeName = node->name;
-	glm::mat4 nodeTransform = node->transformation;
+	const AssimpNodeHierarchy& hierarchy = this->_animationManager->getHierarchy();
+	const int nodeCount = hierarchy.getNodeCount();
 
-	Bone* bone = this->_currentAnimation->findBone(nodeName);
+	// local transforms of all the bones at once
+	animation->getBaked().sample(animationTime, this->_pose);
 
-	if (bone)
+	for (int node = 0; node < nodeCount; ++node)
 	{
-		bone->update(this->_currentTime); // interpolates all the bones and stores the local transform
-		nodeTransform = bone->getLocalTransform(); // retrieve that local transform ^
-	}
+		// channel and bone matrix slot were looked up by name when the animation was loaded
+		const AnimationNodeBinding& binding = animation->getNodeBinding(node);
 
-	const glm::mat4 globalTransformation = parentTransform * nodeTransform;
+		if (!this->isHeldByLod(hierarchy, node))
+			this->_localTransforms[node] = (binding.bone != -1) ? this->_pose.getTransform(binding.bone) : hierarchy.transformations[node];
+		const glm::mat4& nodeTransform = this->_localTransforms[node];
 
-	std::map<std::string, BoneInfo>& boneInfoMap = this->_currentAnimation->getBoneIdMap();
-	if (boneInfoMap.contains(nodeName))
-	{
-		const int index = boneInfoMap[nodeName].id;
-		const glm::mat4 offset = boneInfoMap[nodeName].offset;
-		this->_finalBoneMatrices[index] = globalTransformation * offset;
-	}
+		const int parent = hierarchy.parents[node];
+		this->_globalTransforms[node] = (parent == -1) ? nodeTransform : this->_globalTransforms[parent] * nodeTransform;
 
-	for (int i = 0; i < node->childrenCount; ++i)
-	{
-		this->calculateBoneTransform(&node->children[i], globalTransformation);
+		if (binding.boneMatrix != -1)
+			this->_finalBoneMatrices[binding.boneMatrix] = this->_globalTransforms[node] * binding.offset;
 	}
+	this->_poseVersion++;
 }
 
-void Animator::calculateBoneTransform2(const AssimpNodeData* node, glm::mat4 parentTransform, float interpolationFactorAnimation1)
+/**
+ * Same hierarchy pass as calculateBoneTransformAt(), with the local transforms from the blend tree
+ */
+void Animator::calculateBlendedBoneTransform()
 {
-	if (this->_currentAnimation2 == nullptr) throw std::exception("No second animation specified");
-	if (interpolationFactorAnimation1 < 0.0 || interpolationFactorAnimation1 > 1.0) throw std::exception("Invalid interpolation factor provided");
+	const AssimpNodeHierarchy& hierarchy = this->_animationManager->getHierarchy();
+	const int nodeCount = hierarchy.getNodeCount();
+
+	this->_blendTree.evaluate();
 
-	this->calculateBoneTransform2Inner(node, parentTransform, interpolationFactorAnimation1);
+	// every animation of the set has the slots of the bones the meshes are skinned to (the model's own), so any of them will do for those
+	Animation* bindings = this->_blendTree.getLayer(0).clips[0].animation;
+	for (int layer = 1; bindings == nullptr && layer < AnimationBlendTree::MAX_LAYERS; ++layer)
+		bindings = this->_blendTree.getLayer(layer).clips[0].animation;
+
+	for (int node = 0; node < nodeCount; ++node)
+	{
+		if (!this->isHeldByLod(hierarchy, node))
+			this->_localTransforms[node] = this->_blendTree.getLocalTransform(node);
+		const glm::mat4& nodeTransform = this->_localTransforms[node];
+
+		const int parent = hierarchy.parents[node];
+		this->_globalTransforms[node] = (parent == -1) ? nodeTransform : this->_globalTransforms[parent] * nodeTransform;
+
+		const AnimationNodeBinding& binding = bindings->getNodeBinding(node);
+		if (binding.boneMatrix != -1)
+			this->_finalBoneMatrices[binding.boneMatrix] = this->_globalTransforms[node] * binding.offset;
+	}
+	this->_poseVersion++;
 }
 
 const std::vector<glm::mat4>& Animator::getFinalBoneMatrices()
 {
+	this->evaluate(); // (no-op if evaluateAll() already did it this frame)
 	return this->_finalBoneMatrices;
 }
 
-void Animator::calculateBoneTransform2Inner(const AssimpNodeData* node, glm::mat4 parentTransform,
-	float interpolationFactorAnimation1)
+int Animator::getUsedBoneCount() const
 {
-	const std::string nodeName = node->name;
-	glm::mat4 nodeTransform = node->transformation;
-
-	Bone* bone1 = this->_currentAnimation->findBone(nodeName);
-	Bone* bone2 = this->_currentAnimation2->findBone(nodeName);
-
-	if (bone1) bone1->update(this->_currentTime);
-	if (bone2) bone2->update(this->_currentTime2);
-
-	if (bone1 && bone2)
-	{
-		const InterpolatedTransform& transformData1 = bone1->getLocalInterpolatedTransforms();
-		const InterpolatedTransform& transformData2 = bone2->getLocalInterpolatedTransforms();
-		nodeTransform = Bone::interpolateBetweenTwo(transformData1, transformData2, interpolationFactorAnimation1);
-	}
-	else if (bone1) // only bone 1
-	{
-		nodeTransform = bone1->getLocalTransform();
-	}
-	else if (bone2) // only bone 2
-	{
-		nodeTransform = bone2->getLocalTransform();
-	}
+	return std::min(this->_animationManager->getBoneCount(), (int)this->_finalBoneMatrices.size());
+}
 
-	const glm::mat4 globalTransformation = parentTransform * nodeTransform;
+int Animator::getBonePaletteOffset() const
+{
+	return this->_bonePaletteOffset;
+}
 
-	std::map<std::string, BoneInfo>& boneInfoMap = this->_currentAnimation->getBoneIdMap(); // notably these maps should be the same between both animations
-	if (!this->_currentAnimation2->getBoneIdMap().contains(nodeName) && boneInfoMap.contains(nodeName)) throw std::exception("Bone node mismatch in second animation");
+void Animator::setBonePaletteOffset(int offset)
+{
+	this->_bonePaletteOffset = offset;
+}
 
-	if (boneInfoMap.contains(nodeName))
-	{
-		const int index = boneInfoMap[nodeName].id;
-		const glm::mat4 offset = boneInfoMap[nodeName].offset;
-		this->_finalBoneMatrices[index] = globalTransformation * offset;
-	}
+unsigned int Animator::getPoseVersion() const
+{
+	return this->_poseVersion;
+}
 
-	for (int i = 0; i < node->childrenCount; ++i)
-	{
-		this->calculateBoneTransform2Inner(&node->children[i], globalTransformation, interpolationFactorAnimation1);
-	}
+const Animator* Animator::getSharedPoseSource() const
+{
+	if (this->_sharedPoseSource == nullptr || this->_sharedPoseSource->_poseVersion != this->_sharedPoseSourceVersion) return nullptr;
+	return this->_sharedPoseSource;
 }
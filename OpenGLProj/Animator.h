@@ -1,7 +1,26 @@
 ﻿#ifndef ANIMATOR_MINE_H
 #define ANIMATOR_MINE_H
+#include <vector>
+
 #include "Animation.h"
+#include "AnimationBlendTree.h"
 #include "AnimationSet.h"
+#include "PoseCache.h"
+
+/**
+ * \brief When an Animator may do less work, based on how large its entity is on screen (see Animator::updateLod()).
+ * Screen sizes are the fraction of the screen height covered by the entity's bounding sphere.
+ */
+struct AnimationLodSettings
+{
+	float reducedRateScreenSize = 0.2f; // smaller than this: the pose is only updated every reducedRateInterval frames (and held in between)
+	int reducedRateInterval = 2;
+	float lowRateScreenSize = 0.05f; // smaller than this: every lowRateInterval frames
+	int lowRateInterval = 4;
+	float smallBoneScreenSize = 0.1f; // smaller than this: nodes smaller than smallBoneSize keep their last local transform (fingers, toes, ...)
+	float smallBoneSize = 0.08f; // relative to the whole skeleton, see AssimpNodeHierarchy::relativeSizes
+	bool freezeWhenHidden = true; // no pose updates at all while off-screen or hidden, otherwise these run at the low rate
+};
 
 /**
  * \brief Controller for playing animations and moving the animation state forward in time.
@@ -14,15 +33,32 @@ public:
 	Animator(AnimationSet* animation);
 
 	/**
-	 * \brief advances current time with a rate of the ticksPerSecond of the animation and computes required bone transforms
+	 * \brief advances the clips of the blend tree (and its fades) with a rate of the ticksPerSecond of each animation. The bone transforms
+	 * for that time are computed by evaluate() (directly or through evaluateAll()), or otherwise on the next getFinalBoneMatrices()
 	 */
 	void updateAnimation(float deltaTime);
 
-	void updateAnimation2(float deltaTime, float interpolationFactor);
+	/**
+	 * \brief Computes the bone transforms for the last updateAnimation(), if that didn't happen yet.
+	 * Only touches this animator (the animations themselves are read-only), so different animators can be evaluated at the same time.
+	 */
+	void evaluate();
+
+	void setLodSettings(const AnimationLodSettings& settings);
 
-	void flipAnimation1And2();
+	/**
+	 * \brief Picks the LOD used by the next evaluate() calls.
+	 * \param screenSize		fraction of the screen height covered by the entity
+	 * \param visible			false if the entity is off-screen or otherwise hidden
+	 */
+	void updateLod(float screenSize, bool visible);
 
-	void clearAnimation2();
+	/**
+	 * \brief evaluate() for all of the given animators, spread out over the shared ThreadPool. Blocks until all of them are done.
+	 *
+	 * \param cache		optional. Animators with the same PoseKey this frame then only compute the pose once, the others copy it
+	 */
+	static void evaluateAll(const std::vector<Animator*>& animators, PoseCache* cache = nullptr);
 
 	/**
 	 * \brief Get animation details by animation name
@@ -30,7 +66,7 @@ public:
 	Animation* getAnimationByName(const std::string& animationName) const;
 
 	/**
-	 * \brief play a specific animation. Animation should have been retreived using getAnimationByName();
+	 * \brief play a specific animation on its own (clears everything else in the blend tree). Animation should have been retreived using getAnimationByName();
 	 */
 	void playAnimation(Animation* animation);
 
@@ -39,43 +75,88 @@ public:
 	 */
 	void playAnimation(const std::string& animationName);
 
-
-	void playAnimations(Animation* animation1, Animation* animation2);
-
-	void startPlaying2ndAnimation(Animation* animation2);
-
 	/**
-	 * \brief Recursively computes bone transformations for the animation of the model, parent mesh nodes to children
-	 * (if parent transforms then children must inherit parent's transform)
-	 *
-	 * Single-animation.
+	 * \brief For everything beyond a single animation: cross fades, masked and additive layers
 	 */
-	void calculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform);
+	AnimationBlendTree& getBlendTree();
 
 	/**
-	 * \brief Equivalent to calculateBoneTransform() but allows interpolating between two animations. Prerequisite is calling playAnimations(animation1, animation2)
-	 * to set up the animations to interpolate between.
+	 * \brief Computes bone transformations for the animation of the model, parent mesh nodes to children
+	 * (if parent transforms then children must inherit parent's transform).
+	 * One pass over the flattened hierarchy (see AssimpNodeHierarchy), parents are always done before their children.
 	 *
-	 * \param interpolationFactorAnimation1		interpolation factor for first animation. Must be in range [0, 1]. second animation will be weighted with (1 - interpolationFactorAnimation1).
+	 * A blend tree that only plays a single clip samples it directly, anything else goes through AnimationBlendTree::evaluate().
 	 */
-	void calculateBoneTransform2(const AssimpNodeData* node, glm::mat4 parentTransform, float interpolationFactorAnimation1);
+	void calculateBoneTransform();
 
 	/**
-	 * \brief Gets the bone matrices used for animation. Must be called after calling updateAnimation();
+	 * \brief Gets the bone matrices used for animation. Must be called after calling updateAnimation(), evaluates them first if that wasn't done yet
 	 * \return Bone matrices to use when rendering the model to which this Animator belongs.
 	 */
 	const std::vector<glm::mat4>& getFinalBoneMatrices();
 
+	/**
+	 * \brief How many of getFinalBoneMatrices() the model actually uses
+	 */
+	int getUsedBoneCount() const;
+
+	/**
+	 * \brief Where this animator's matrices start in the scene's bone palette, -1 if they weren't uploaded (see BonePaletteBuffer)
+	 */
+	int getBonePaletteOffset() const;
+	void setBonePaletteOffset(int offset);
+
+	/**
+	 * \brief Goes up every time evaluate() computes a new pose (so not while the LOD holds or freezes it)
+	 */
+	unsigned int getPoseVersion() const;
+
+	/**
+	 * \brief The animator whose pose this one copied through the PoseCache, as long as both still have that same pose. nullptr otherwise
+	 */
+	const Animator* getSharedPoseSource() const;
+
 private:
+	enum class PendingPose
+	{
+		NONE,
+		SINGLE, // one clip on its own (calculateBoneTransformAt())
+		BLENDED // anything else the blend tree does (calculateBlendedBoneTransform())
+	};
+
 	std::vector<glm::mat4> _finalBoneMatrices;
+	std::vector<glm::mat4> _globalTransforms; // per hierarchy node, reused every update
+	std::vector<glm::mat4> _localTransforms; // per hierarchy node, what small nodes hold on to while the LOD skips them
+	AnimationPose _pose; // sampled from the baked animation, reused every update
 	AnimationSet* _animationManager;
-	Animation* _currentAnimation;
-	Animation* _currentAnimation2 = nullptr;
-	float _currentTime;
-	float _currentTime2;
-	float _deltaTime;
-
-	void calculateBoneTransform2Inner(const AssimpNodeData* node, glm::mat4 parentTransform, float interpolationFactorAnimation1);
+	AnimationBlendTree _blendTree;
+
+	PendingPose _pendingPose = PendingPose::NONE;
+	Animation* _pendingAnimation = nullptr; // for a SINGLE pose
+
+	AnimationLodSettings _lodSettings;
+	int _lodInterval = 1; // evaluate every this many frames, 0 = frozen
+	bool _lodSkipSmallNodes = false;
+	unsigned int _lodFrame = 0; // isPoseDue() calls so far
+	unsigned int _lodPhase = 0; // offsets the frames a reduced rate picks, different for every animator
+	bool _poseOverdue = true; // computes a pose at the first chance regardless of the rate (first frame, unfrozen)
+
+	int _bonePaletteOffset = -1;
+	unsigned int _poseVersion = 0;
+
+	float _pendingSampleTime = 0.0f; // for a SINGLE pose, shared poses are sampled at the start of their PoseCache step
+	const Animator* _poseOwner = nullptr; // set by evaluateAll() when another animator computes this frame's pose
+	const Animator* _sharedPoseSource = nullptr;
+	unsigned int _sharedPoseSourceVersion = 0;
+
+	bool isPoseDue();
+	bool resolvePendingPose();
+	void computePendingPose();
+	bool getPoseKey(float timeStep, PoseKey& outKey, float& outSampleTime) const;
+	void copyPoseFrom(const Animator& source);
+	void calculateBoneTransformAt(Animation* animation, float animationTime);
+	void calculateBlendedBoneTransform();
+	bool isHeldByLod(const AssimpNodeHierarchy& hierarchy, int node) const;
 };
 
 
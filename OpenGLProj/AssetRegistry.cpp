@@ -0,0 +1,306 @@
+#include "AssetRegistry.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <assimp/Importer.hpp>
+
+#include "TextureCache.h"
+#include "ThreadPool.h"
+
+/**
+ * The full import (meshes and all) is only needed when the model's cache is stale, and then the animations get it too.
+ * Otherwise nullptr: the model comes from its cache, and the animations from theirs (or from an animation only import, see AnimationSet)
+ */
+static const aiScene* importIfModelCacheIsStale(Assimp::Importer& importer, const std::string& path)
+{
+	if (Model::isCacheUpToDate(path)) return nullptr;
+
+	const aiScene* scene = Model::importScene(importer, path);
+	if (scene == nullptr) throw std::exception("Animation could not be found!");
+	return scene;
+}
+
+AssetRegistry::AssetRegistry() : _startTime(std::chrono::steady_clock::now())
+{
+}
+
+AssetRegistry::~AssetRegistry()
+{
+	// the workers still write into requests that were never waited for (e.g. after a failed load was rethrown)
+	while (this->_pendingCount > 0)
+	{
+		Request* request = this->popFinished();
+		delete request->animationSet;
+		delete request->model;
+		delete request;
+	}
+
+	// (the animations point into their model)
+	for (const auto& [path, animationSet] : this->_animationSets) delete animationSet;
+	for (const auto& [path, model] : this->_models) delete model;
+	for (const auto& [path, textureId] : this->_textures) TextureCache::getShared().release(textureId);
+}
+
+void AssetRegistry::requestModel(const std::string& path)
+{
+	if (this->_models.contains(path) || !this->_requested.insert({ RequestType::MODEL, path }).second) return;
+
+	Request* request = new Request();
+	request->type = RequestType::MODEL;
+	request->path = path;
+	this->submit(request);
+}
+
+void AssetRegistry::requestAnimationSet(const std::string& path, const AnimationBakeTolerance& bakeTolerance)
+{
+	if (this->_animationSets.contains(path) || this->_requested.contains({ RequestType::ANIMATION_SET, path })) return;
+	// the model comes out of the same import, and the animations add their bones to it while it's loaded
+	if (this->_models.contains(path) || this->_requested.contains({ RequestType::MODEL, path }))
+		throw std::exception("The animations of a file have to be requested before its model");
+
+	this->_requested.insert({ RequestType::ANIMATION_SET, path });
+	this->_requested.insert({ RequestType::MODEL, path });
+
+	Request* request = new Request();
+	request->type = RequestType::ANIMATION_SET;
+	request->path = path;
+	request->bakeTolerance = bakeTolerance;
+	this->submit(request);
+}
+
+void AssetRegistry::requestTexture(const std::string& path, bool loadAsSRGB)
+{
+	if (!this->_requested.insert({ RequestType::TEXTURE, path }).second) return;
+
+	Request* request = new Request();
+	request->type = RequestType::TEXTURE;
+	request->path = path;
+	request->loadAsSRGB = loadAsSRGB;
+	this->submit(request);
+}
+
+void AssetRegistry::requestImage(const std::string& path, bool flipVertically)
+{
+	if (!this->_requested.insert({ RequestType::IMAGE, path }).second) return;
+
+	Request* request = new Request();
+	request->type = RequestType::IMAGE;
+	request->path = path;
+	request->flipVertically = flipVertically;
+	this->submit(request);
+}
+
+void AssetRegistry::waitForRequests()
+{
+	while (this->_pendingCount > 0)
+	{
+		Request* request = this->popFinished();
+		this->upload(*request);
+		const std::exception_ptr error = request->error;
+		if (error)
+		{
+			// (never handed out)
+			delete request->animationSet;
+			delete request->model;
+		}
+		delete request;
+		if (error) std::rethrow_exception(error);
+	}
+}
+
+Model* AssetRegistry::getModel(const std::string& path)
+{
+	this->waitForRequests();
+
+	const auto loaded = this->_models.find(path);
+	if (loaded != this->_models.end()) return loaded->second;
+
+	Model* model = new Model(path.c_str()); // (only imports the file if its cache is stale)
+	this->_models[path] = model;
+	return model;
+}
+
+AnimationSet* AssetRegistry::getAnimationSet(const std::string& path, const AnimationBakeTolerance& bakeTolerance)
+{
+	this->waitForRequests();
+
+	const auto loaded = this->_animationSets.find(path);
+	if (loaded != this->_animationSets.end()) return loaded->second;
+
+	Assimp::Importer importer;
+	const aiScene* scene = nullptr;
+	Model* model;
+	const auto loadedModel = this->_models.find(path);
+	if (loadedModel != this->_models.end())
+	{
+		model = loadedModel->second; // (asked for on its own first, see getModel())
+	}
+	else
+	{
+		scene = importIfModelCacheIsStale(importer, path);
+		model = new Model(path.c_str(), scene);
+		this->_models[path] = model;
+	}
+
+	AnimationSet* animationSet = new AnimationSet(path, scene, model, bakeTolerance);
+	this->_animationSets[path] = animationSet;
+	return animationSet;
+}
+
+unsigned int AssetRegistry::getTexture(const std::string& path)
+{
+	this->waitForRequests();
+
+	const auto loaded = this->_textures.find(path);
+	if (loaded == this->_textures.end()) throw std::exception("Texture was not requested");
+	return loaded->second;
+}
+
+DecodedTexture AssetRegistry::takeImage(const std::string& path)
+{
+	this->waitForRequests();
+
+	const auto loaded = this->_images.find(path);
+	if (loaded == this->_images.end()) throw std::exception("Image was not requested (or was taken already)");
+	DecodedTexture image = std::move(loaded->second);
+	this->_images.erase(loaded);
+	return image;
+}
+
+void AssetRegistry::printStartupReport() const
+{
+	if (this->_timeline.empty()) return;
+
+	std::cout << "Startup timeline (in ms, ready is since the registry was created):" << std::endl;
+	std::cout << "  queued     load     wait   upload    ready  asset" << std::endl;
+	double totalLoad = 0.0;
+	double totalUpload = 0.0;
+	std::cout << std::fixed << std::setprecision(1);
+	for (const LoadTiming& timing : this->_timeline)
+	{
+		std::cout << std::setw(8) << timing.loadStart - timing.requested
+			<< std::setw(9) << timing.loadEnd - timing.loadStart
+			<< std::setw(9) << timing.uploadStart - timing.loadEnd
+			<< std::setw(9) << timing.uploadEnd - timing.uploadStart
+			<< std::setw(9) << timing.uploadEnd
+			<< "  " << timing.name << std::endl;
+		totalLoad += timing.loadEnd - timing.loadStart;
+		totalUpload += timing.uploadEnd - timing.uploadStart;
+	}
+
+	// all requests are waited for at once, so the startup waits for whichever was ready last. What held that one up:
+	// "queued" is waiting for a free worker (the other loads), "wait" is the GL thread being busy (uploads or its own work before waitForRequests())
+	const auto last = std::max_element(this->_timeline.begin(), this->_timeline.end(),
+		[](const LoadTiming& a, const LoadTiming& b) { return a.uploadEnd < b.uploadEnd; });
+	std::cout << "Critical path: '" << last->name << "', ready after " << last->uploadEnd << " ms ("
+		<< last->loadStart - last->requested << " queued, " << last->loadEnd - last->loadStart << " load, "
+		<< last->uploadStart - last->loadEnd << " waiting for the GL thread, " << last->uploadEnd - last->uploadStart << " upload)" << std::endl;
+	std::cout << "Total: " << totalLoad << " ms of loading on " << std::max(ThreadPool::getShared().getThreadCount(), 1u) << " worker(s), "
+		<< totalUpload << " ms of uploading on the GL thread" << std::endl;
+	std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+void AssetRegistry::submit(Request* request)
+{
+	request->timing.name = request->path;
+	request->timing.requested = this->getElapsedMs();
+	this->_pendingCount++;
+
+	ThreadPool& pool = ThreadPool::getShared();
+	if (pool.getThreadCount() == 0)
+	{
+		this->load(*request); // nobody to hand it to
+		return;
+	}
+	pool.submit([this, request]() { this->load(*request); });
+}
+
+/**
+ * Runs on a worker: everything up to (not including) the first OpenGL call. Always ends up in the finished queue, even when it throws
+ */
+void AssetRegistry::load(Request& request)
+{
+	request.timing.loadStart = this->getElapsedMs();
+	try
+	{
+		switch (request.type)
+		{
+		case RequestType::MODEL:
+			if (!Model::prepare(request.path, nullptr, request.modelSource)) throw std::exception("Model could not be loaded");
+			request.model = new Model(request.modelSource);
+			break;
+		case RequestType::ANIMATION_SET:
+		{
+			Assimp::Importer importer;
+			const aiScene* scene = importIfModelCacheIsStale(importer, request.path);
+			if (!Model::prepare(request.path, scene, request.modelSource)) throw std::exception("Model could not be loaded");
+			request.model = new Model(request.modelSource);
+			request.animationSet = new AnimationSet(request.path, scene, request.model, request.bakeTolerance);
+			break;
+		}
+		case RequestType::TEXTURE:
+			if (TextureCache::getShared().contains(request.path, PROJ_CURRENT_DIR, request.loadAsSRGB)) break; // (nothing to decode)
+			request.image = decodeTextureFile(request.path.c_str(), PROJ_CURRENT_DIR);
+			break;
+		case RequestType::IMAGE:
+			request.image = decodeTextureFile(request.path.c_str(), PROJ_CURRENT_DIR, request.flipVertically);
+			break;
+		}
+	}
+	catch (...)
+	{
+		request.error = std::current_exception();
+	}
+	request.timing.loadEnd = this->getElapsedMs();
+
+	{
+		std::lock_guard<std::mutex> lock(this->_finishedMutex);
+		this->_finished.push(&request);
+	}
+	this->_finishedCondition.notify_one();
+}
+
+/**
+ * Runs on the GL thread
+ */
+void AssetRegistry::upload(Request& request)
+{
+	request.timing.uploadStart = this->getElapsedMs();
+	if (!request.error)
+	{
+		switch (request.type)
+		{
+		case RequestType::ANIMATION_SET:
+			this->_animationSets[request.path] = request.animationSet;
+			[[fallthrough]];
+		case RequestType::MODEL:
+			request.model->upload(request.modelSource);
+			this->_models[request.path] = request.model;
+			break;
+		case RequestType::TEXTURE:
+			this->_textures[request.path] = TextureCache::getShared().acquire(request.path, PROJ_CURRENT_DIR, request.loadAsSRGB, &request.image);
+			break;
+		case RequestType::IMAGE:
+			this->_images[request.path] = std::move(request.image);
+			break;
+		}
+	}
+	request.timing.uploadEnd = this->getElapsedMs();
+	this->_timeline.push_back(request.timing);
+}
+
+AssetRegistry::Request* AssetRegistry::popFinished()
+{
+	std::unique_lock<std::mutex> lock(this->_finishedMutex);
+	this->_finishedCondition.wait(lock, [this]() { return !this->_finished.empty(); });
+	Request* request = this->_finished.front();
+	this->_finished.pop();
+	this->_pendingCount--;
+	return request;
+}
+
+double AssetRegistry::getElapsedMs() const
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - this->_startTime).count();
+}
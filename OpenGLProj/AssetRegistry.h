@@ -0,0 +1,155 @@
+#ifndef ASSETREGISTRY_MINE_H
+#define ASSETREGISTRY_MINE_H
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "AnimationSet.h"
+#include "FileUtils.h"
+#include "Model.h"
+
+/**
+ * \brief Loads every model file only once, however many times (and for whatever) it's asked for.
+ *
+ * Both come from their cooked caches when those are up to date (see Model and AnimationSet), without Assimp. A file with both a mesh
+ * and animations is only fully imported when the model's cache is stale, and then that one import gives the Model and the AnimationSet.
+ * Everything handed out is owned by the registry and lives as long as it does.
+ *
+ * Assets can also be requested up front (request...()): the file I/O, Assimp import, animation baking and image decoding then run
+ * on the shared ThreadPool, and the finished payloads are queued up for the thread with the OpenGL context, which uploads them in
+ * waitForRequests(). So startup becomes "request everything, do the GL only work, then wait". See printStartupReport().
+ */
+class AssetRegistry
+{
+public:
+	AssetRegistry();
+	~AssetRegistry();
+
+	AssetRegistry(const AssetRegistry&) = delete;
+	AssetRegistry& operator=(const AssetRegistry&) = delete;
+
+	/**
+	 * \brief Starts loading the model in the file in the background (picked up with getModel())
+	 */
+	void requestModel(const std::string& path);
+
+	/**
+	 * \brief Starts loading the animations and the model in the file in the background, from at most one import (picked up with getAnimationSet()
+	 * and getModel()). Has to come before any requestModel() or getModel() of the same file.
+	 */
+	void requestAnimationSet(const std::string& path, const AnimationBakeTolerance& bakeTolerance = AnimationBakeTolerance());
+
+	/**
+	 * \brief Starts decoding the texture in the background (unless it's in the TextureCache already). It's uploaded by waitForRequests()
+	 * and picked up with getTexture(). The registry holds one reference to it (see TextureCache).
+	 */
+	void requestTexture(const std::string& path, bool loadAsSRGB);
+
+	/**
+	 * \brief Starts decoding the image in the background, for something that uploads it itself (e.g. the Skybox faces). Picked up with takeImage()
+	 */
+	void requestImage(const std::string& path, bool flipVertically);
+
+	/**
+	 * \brief Uploads the requested assets as their loads finish, until all of them are done. Has to be called on the thread with the OpenGL context.
+	 * Rethrows the first exception of a failed load.
+	 */
+	void waitForRequests();
+
+	/**
+	 * \brief The model in the file. For a file that also has animations, ask for getAnimationSet() first so both come from the same import.
+	 * Waits for the requests first if there are any left.
+	 */
+	Model* getModel(const std::string& path);
+
+	/**
+	 * \brief The animations in the file, played on getModel(path) (which is loaded along with them if it wasn't yet).
+	 * Only the first call (or request) for a path picks the bake tolerance. Waits for the requests first if there are any left.
+	 */
+	AnimationSet* getAnimationSet(const std::string& path, const AnimationBakeTolerance& bakeTolerance = AnimationBakeTolerance());
+
+	/**
+	 * \brief Id of a requested texture. Waits for the requests first if there are any left, throws if it was never requested.
+	 */
+	unsigned int getTexture(const std::string& path);
+
+	/**
+	 * \brief Hands over a requested image (only once). Waits for the requests first if there are any left, throws if it was never requested.
+	 */
+	DecodedTexture takeImage(const std::string& path);
+
+	/**
+	 * \brief Prints how long every requested asset took in each stage, and the chain that the wait for all of them came down to
+	 */
+	void printStartupReport() const;
+
+private:
+	enum class RequestType
+	{
+		MODEL,
+		ANIMATION_SET,
+		TEXTURE,
+		IMAGE
+	};
+
+	/**
+	 * \brief When a request went through each stage, in ms since the registry was created
+	 */
+	struct LoadTiming
+	{
+		std::string name;
+		double requested = 0.0;
+		double loadStart = 0.0; // picked up by a worker
+		double loadEnd = 0.0;
+		double uploadStart = 0.0; // picked up by the GL thread
+		double uploadEnd = 0.0;
+	};
+
+	/**
+	 * \brief One asset on its way through the pipeline. The payload is filled by the worker, and only touched by the GL thread once it's queued
+	 */
+	struct Request
+	{
+		RequestType type;
+		std::string path;
+		bool loadAsSRGB = false;
+		bool flipVertically = true;
+		AnimationBakeTolerance bakeTolerance;
+
+		ModelSource modelSource;
+		Model* model = nullptr;
+		AnimationSet* animationSet = nullptr;
+		DecodedTexture image;
+		std::exception_ptr error;
+
+		LoadTiming timing;
+	};
+
+	std::map<std::string, Model*> _models;
+	std::map<std::string, AnimationSet*> _animationSets;
+	std::map<std::string, unsigned int> _textures;
+	std::map<std::string, DecodedTexture> _images;
+
+	std::set<std::pair<RequestType, std::string>> _requested;
+	int _pendingCount = 0; // requested, not uploaded yet
+	std::queue<Request*> _finished; // loaded, waiting for the GL thread
+	std::mutex _finishedMutex;
+	std::condition_variable _finishedCondition;
+
+	std::chrono::steady_clock::time_point _startTime;
+	std::vector<LoadTiming> _timeline; // in the order the assets were ready
+
+	void submit(Request* request);
+	void load(Request& request);
+	void upload(Request& request);
+	Request* popFinished();
+	double getElapsedMs() const;
+};
+
+#endif
@@ -4,16 +4,29 @@
 #include <string>
 #include <vector>
 #include <glm/mat4x4.hpp>
+#include <glm/detail/type_quat.hpp>
 
 /**
- * \brief Map incoming Assimp library data structure members that we need for animations
+ * \brief Map incoming Assimp library data structure members that we need for animations.
+ *
+ * The node tree is flattened depth first into parallel arrays (one element per node), so every parent comes before
+ * its children and the global transforms can be computed in a single forward loop:
+ * global[i] = global[parents[i]] * local[i]
  */
-struct AssimpNodeData
+struct AssimpNodeHierarchy
 {
-	glm::mat4 transformation;
-	std::string name;
-	int childrenCount;
-	std::vector<AssimpNodeData> children;
+	std::vector<int> parents; // index of the parent node, -1 for the root
+	std::vector<glm::mat4> transformations; // local (bind) transformation relative to the parent
+	std::vector<glm::vec3> bindTranslations; // transformations taken apart, for blending nodes only some of the animations have a channel for
+	std::vector<glm::quat> bindRotations; // ^
+	std::vector<glm::vec3> bindScales; // ^
+	std::vector<std::string> names; // only needed while loading (see Animation::bindNodes())
+	std::vector<float> relativeSizes; // length of the bind pose bone chain below each node, relative to the longest one of the whole skeleton (the root's)
+
+	int getNodeCount() const
+	{
+		return (int)this->parents.size();
+	}
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include "BakedAnimation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/quaternion.hpp>
+
+// the pose interpolation runs 4 components at a time with SSE2 where it is available
+#if defined(_M_X64) || defined(__SSE2__)
+#define USE_SSE2 true
+#include <emmintrin.h>
+#else
+#define USE_SSE2 false
+#endif
+
+constexpr auto BAKE_MIN_SAMPLES_PER_SECOND = 30.0f;
+constexpr auto BAKE_MAX_SAMPLES_PER_SECOND = 240.0f;
+constexpr auto DEFAULT_TICKS_PER_SECOND = 25.0f; // for files that don't specify it
+
+glm::vec3 AnimationPose::getTranslation(int channel) const
+{
+	const float* v = &this->values[channel];
+	return glm::vec3(v[TRANSLATION_X * this->stride], v[TRANSLATION_Y * this->stride], v[TRANSLATION_Z * this->stride]);
+}
+
+glm::quat AnimationPose::getRotation(int channel) const
+{
+	const float* v = &this->values[channel];
+	return glm::quat(v[ROTATION_W * this->stride], v[ROTATION_X * this->stride], v[ROTATION_Y * this->stride], v[ROTATION_Z * this->stride]);
+}
+
+glm::vec3 AnimationPose::getScale(int channel) const
+{
+	const float* v = &this->values[channel];
+	return glm::vec3(v[SCALE_X * this->stride], v[SCALE_Y * this->stride], v[SCALE_Z * this->stride]);
+}
+
+glm::mat4 AnimationPose::getTransform(int channel) const
+{
+	return Bone::composeTransform(this->getTranslation(channel), this->getRotation(channel), this->getScale(channel));
+}
+
+BakedAnimation::BakedAnimation(std::vector<Bone>& bones, float duration, float ticksPerSecond, const AnimationBakeTolerance& tolerance)
+{
+	if (ticksPerSecond <= 0.0f) ticksPerSecond = DEFAULT_TICKS_PER_SECOND;
+
+	// only ever runs when cooking the animation cache (see AnimationSet), so checking every rate on the way up is affordable
+	float samplesPerSecond = chooseSamplesPerSecond(bones, duration, ticksPerSecond);
+	this->bakeFrames(bones, duration, ticksPerSecond, samplesPerSecond);
+	while (!this->verify(bones, tolerance) && samplesPerSecond * 2.0f <= BAKE_MAX_SAMPLES_PER_SECOND)
+	{
+		samplesPerSecond *= 2.0f;
+		this->bakeFrames(bones, duration, ticksPerSecond, samplesPerSecond);
+	}
+}
+
+BakedAnimation::BakedAnimation(int channelCount, int frameCount, float ticksPerFrame, float samplesPerSecond, std::vector<float>&& frames)
+:
+_channelCount(channelCount),
+_stride((channelCount + 3) & ~3),
+_frameCount(frameCount),
+_ticksPerFrame(ticksPerFrame),
+_samplesPerSecond(samplesPerSecond),
+_frames(std::move(frames))
+{
+}
+
+/**
+ * Keys per second of the densest track (on average over the animation), rounded up to the next rate of the 30 -> 240 ladder.
+ * Tracks with a key every frame of a 30 fps export bake at 30, so the frames land (close to) on the keys themselves.
+ */
+float BakedAnimation::chooseSamplesPerSecond(const std::vector<Bone>& bones, float duration, float ticksPerSecond)
+{
+	const float seconds = duration / ticksPerSecond;
+	if (!(seconds > 0.0f)) return BAKE_MIN_SAMPLES_PER_SECOND;
+
+	int maxKeyCount = 0;
+	for (const Bone& bone : bones) maxKeyCount = std::max(maxKeyCount, bone.getMaxKeyCount());
+	const float keysPerSecond = (float)std::max(maxKeyCount - 1, 0) / seconds;
+
+	float samplesPerSecond = BAKE_MIN_SAMPLES_PER_SECOND;
+	while (samplesPerSecond < keysPerSecond && samplesPerSecond * 2.0f <= BAKE_MAX_SAMPLES_PER_SECOND) samplesPerSecond *= 2.0f;
+	return samplesPerSecond;
+}
+
+void BakedAnimation::bakeFrames(std::vector<Bone>& bones, float duration, float ticksPerSecond, float samplesPerSecond)
+{
+	this->_channelCount = (int)bones.size();
+	this->_stride = (this->_channelCount + 3) & ~3;
+	this->_samplesPerSecond = samplesPerSecond;
+
+	// the last frame lands exactly on the end of the animation
+	const int intervals = duration > 0.0f ? std::max((int)std::ceil(duration / ticksPerSecond * samplesPerSecond), 1) : 0;
+	this->_frameCount = intervals + 1;
+	this->_ticksPerFrame = intervals > 0 ? duration / (float)intervals : 1.0f;
+
+	const size_t frameSize = (size_t)AnimationPose::COMPONENT_COUNT * this->_stride;
+	this->_frames.assign(frameSize * this->_frameCount, 0.0f);
+
+	for (int frame = 0; frame < this->_frameCount; ++frame)
+	{
+		float* values = &this->_frames[frameSize * frame];
+		const float* previous = frame > 0 ? values - frameSize : nullptr;
+		const float time = std::min((float)frame * this->_ticksPerFrame, duration);
+
+		for (int channel = 0; channel < this->_stride; ++channel)
+		{
+			glm::vec3 translation(0.0f);
+			glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+			glm::vec3 scale(1.0f);
+			if (channel < this->_channelCount) // (the padding is an identity transform so normalizing it is harmless)
+			{
+				bones[channel].update(time);
+				const InterpolatedTransform& transform = bones[channel].getLocalInterpolatedTransforms();
+				translation = transform.translation;
+				rotation = transform.rotation;
+				scale = transform.scale;
+			}
+
+			// q and -q are the same rotation. Keeping every frame in the same hemisphere as the one before it
+			// means sampling never has to check for that (nlerp always takes the short way around)
+			if (previous)
+			{
+				const float dot = rotation.x * previous[AnimationPose::ROTATION_X * this->_stride + channel]
+					+ rotation.y * previous[AnimationPose::ROTATION_Y * this->_stride + channel]
+					+ rotation.z * previous[AnimationPose::ROTATION_Z * this->_stride + channel]
+					+ rotation.w * previous[AnimationPose::ROTATION_W * this->_stride + channel];
+				if (dot < 0.0f) rotation = -rotation;
+			}
+
+			values[AnimationPose::TRANSLATION_X * this->_stride + channel] = translation.x;
+			values[AnimationPose::TRANSLATION_Y * this->_stride + channel] = translation.y;
+			values[AnimationPose::TRANSLATION_Z * this->_stride + channel] = translation.z;
+			values[AnimationPose::ROTATION_X * this->_stride + channel] = rotation.x;
+			values[AnimationPose::ROTATION_Y * this->_stride + channel] = rotation.y;
+			values[AnimationPose::ROTATION_Z * this->_stride + channel] = rotation.z;
+			values[AnimationPose::ROTATION_W * this->_stride + channel] = rotation.w;
+			values[AnimationPose::SCALE_X * this->_stride + channel] = scale.x;
+			values[AnimationPose::SCALE_Y * this->_stride + channel] = scale.y;
+			values[AnimationPose::SCALE_Z * this->_stride + channel] = scale.z;
+		}
+	}
+}
+
+bool BakedAnimation::verify(std::vector<Bone>& bones, const AnimationBakeTolerance& tolerance) const
+{
+	AnimationPose scratchPose;
+	AnimationBakeTolerance maxError = { 0.0f, 0.0f, 0.0f };
+	for (int frame = 0; frame + 1 < this->_frameCount; ++frame)
+	{
+		const float time = ((float)frame + 0.5f) * this->_ticksPerFrame;
+		this->sample(time, scratchPose);
+
+		for (int channel = 0; channel < this->_channelCount; ++channel)
+		{
+			bones[channel].update(time);
+			const InterpolatedTransform& expected = bones[channel].getLocalInterpolatedTransforms();
+
+			const float cosHalfAngle = std::min(std::fabs(glm::dot(scratchPose.getRotation(channel), glm::normalize(expected.rotation))), 1.0f);
+			maxError.translation = std::max(maxError.translation, glm::length(scratchPose.getTranslation(channel) - expected.translation));
+			maxError.rotation = std::max(maxError.rotation, 2.0f * std::acos(cosHalfAngle));
+			maxError.scale = std::max(maxError.scale, glm::length(scratchPose.getScale(channel) - expected.scale));
+		}
+	}
+
+	const bool withinTolerance = maxError.translation <= tolerance.translation && maxError.rotation <= tolerance.rotation && maxError.scale <= tolerance.scale;
+	std::cout << "Baked " << this->_frameCount << " frames at " << this->_samplesPerSecond << " samples per second (max error: "
+		<< maxError.translation << " translation, " << maxError.rotation << " rad rotation, " << maxError.scale << " scale)"
+		<< (withinTolerance ? "" : " -- NOT within tolerance") << std::endl;
+	return withinTolerance;
+}
+
+void BakedAnimation::sample(float animationTime, AnimationPose& outPose) const
+{
+	const size_t frameSize = (size_t)AnimationPose::COMPONENT_COUNT * this->_stride;
+	if (outPose.stride != this->_stride || outPose.values.size() != frameSize)
+	{
+		outPose.stride = this->_stride;
+		outPose.values.resize(frameSize);
+	}
+	if (this->_frameCount == 0 || frameSize == 0) return;
+
+	// written so that NaN ends up at the first frame
+	float frame = animationTime / this->_ticksPerFrame;
+	if (!(frame >= 0.0f)) frame = 0.0f;
+	frame = std::min(frame, (float)(this->_frameCount - 1));
+	const int frame0 = std::min((int)frame, std::max(this->_frameCount - 2, 0));
+	const int frame1 = std::min(frame0 + 1, this->_frameCount - 1);
+	const float alpha = frame - (float)frame0;
+
+	const float* from = &this->_frames[frameSize * frame0];
+	const float* to = &this->_frames[frameSize * frame1];
+	float* out = outPose.values.data();
+
+	// frameSize and _stride are multiples of 4
+#if USE_SSE2
+	const __m128 alpha4 = _mm_set1_ps(alpha);
+	for (size_t i = 0; i < frameSize; i += 4)
+	{
+		const __m128 a = _mm_loadu_ps(from + i);
+		const __m128 b = _mm_loadu_ps(to + i);
+		_mm_storeu_ps(out + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), alpha4)));
+	}
+
+	float* rx = out + AnimationPose::ROTATION_X * this->_stride;
+	float* ry = out + AnimationPose::ROTATION_Y * this->_stride;
+	float* rz = out + AnimationPose::ROTATION_Z * this->_stride;
+	float* rw = out + AnimationPose::ROTATION_W * this->_stride;
+	const __m128 one = _mm_set1_ps(1.0f);
+	for (int i = 0; i < this->_stride; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(rx + i);
+		const __m128 y = _mm_loadu_ps(ry + i);
+		const __m128 z = _mm_loadu_ps(rz + i);
+		const __m128 w = _mm_loadu_ps(rw + i);
+		const __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+		const __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+		_mm_storeu_ps(rx + i, _mm_mul_ps(x, invLength));
+		_mm_storeu_ps(ry + i, _mm_mul_ps(y, invLength));
+		_mm_storeu_ps(rz + i, _mm_mul_ps(z, invLength));
+		_mm_storeu_ps(rw + i, _mm_mul_ps(w, invLength));
+	}
+#else
+	for (size_t i = 0; i < frameSize; ++i)
+		out[i] = from[i] + (to[i] - from[i]) * alpha;
+
+	float* rx = out + AnimationPose::ROTATION_X * this->_stride;
+	float* ry = out + AnimationPose::ROTATION_Y * this->_stride;
+	float* rz = out + AnimationPose::ROTATION_Z * this->_stride;
+	float* rw = out + AnimationPose::ROTATION_W * this->_stride;
+	for (int i = 0; i < this->_stride; ++i)
+	{
+		const float invLength = 1.0f / std::sqrt(rx[i] * rx[i] + ry[i] * ry[i] + rz[i] * rz[i] + rw[i] * rw[i]);
+		rx[i] *= invLength;
+		ry[i] *= invLength;
+		rz[i] *= invLength;
+		rw[i] *= invLength;
+	}
+#endif
+}
+
+int BakedAnimation::getChannelCount() const
+{
+	return this->_channelCount;
+}
+
+int BakedAnimation::getFrameCount() const
+{
+	return this->_frameCount;
+}
+
+float BakedAnimation::getTicksPerFrame() const
+{
+	return this->_ticksPerFrame;
+}
+
+float BakedAnimation::getSamplesPerSecond() const
+{
+	return this->_samplesPerSecond;
+}
+
+const std::vector<float>& BakedAnimation::getFrames() const
+{
+	return this->_frames;
+}
@@ -0,0 +1,111 @@
+#ifndef BAKEDANIMATION_MINE_H
+#define BAKEDANIMATION_MINE_H
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/detail/type_quat.hpp>
+
+#include "Bone.h"
+
+/**
+ * \brief How far sampling a baked animation may be off from sampling its keyframes directly (Bone::update())
+ */
+struct AnimationBakeTolerance
+{
+	float translation = 0.01f; // in model units
+	float rotation = 0.00175f; // in radians (~0.1 degrees)
+	float scale = 0.001f;
+};
+
+/**
+ * \brief Local transform (translation, rotation, scale) of every channel of an animation at one point in time.
+ * Stored as one array per component (all translation x values, then all translation y values, ...) so the whole pose can be
+ * interpolated 4 channels at a time.
+ */
+struct AnimationPose
+{
+	enum Component
+	{
+		TRANSLATION_X, TRANSLATION_Y, TRANSLATION_Z,
+		ROTATION_X, ROTATION_Y, ROTATION_Z, ROTATION_W,
+		SCALE_X, SCALE_Y, SCALE_Z,
+		COMPONENT_COUNT
+	};
+
+	int stride = 0; // floats per component: the channel count rounded up to a multiple of 4
+	std::vector<float> values; // component c of channel i is values[c * stride + i]
+
+	glm::vec3 getTranslation(int channel) const;
+	glm::quat getRotation(int channel) const;
+	glm::vec3 getScale(int channel) const;
+
+	/**
+	 * \brief Same as translation * rotation * scale, but built straight from the components
+	 */
+	glm::mat4 getTransform(int channel) const;
+};
+
+/**
+ * \brief An animation resampled at a fixed rate, done once when the animation is loaded.
+ *
+ * Sampling then no longer has to look for keys per channel: the time directly gives the two frames around it,
+ * and the whole pose is one lerp over every component of every channel (4 at a time with SSE2), followed by
+ * a renormalization of the rotations (nlerp). The frames are stored in the same layout as AnimationPose.
+ *
+ * The rate starts out as the smallest of 30, 60, 120 or 240 samples per second that keeps up with the densest track, and is doubled
+ * for as long as verify() finds the result further off from Bone::update() than the tolerance (up to 240).
+ * Baking is part of cooking the animation cache, so all of this is only done when that cache is missing or stale.
+ */
+class BakedAnimation
+{
+public:
+	BakedAnimation() = default;
+
+	/**
+	 * \param bones				channels of the animation (updated while baking)
+	 * \param duration			in ticks
+	 * \param ticksPerSecond	of the animation
+	 * \param tolerance		how far sampling may be off from the keyframes, picks the rate (see above)
+	 */
+	BakedAnimation(std::vector<Bone>& bones, float duration, float ticksPerSecond, const AnimationBakeTolerance& tolerance);
+
+	/**
+	 * \brief Takes over frames baked before (read back from the animation cache, see AnimationSet), laid out like getFrames()
+	 */
+	BakedAnimation(int channelCount, int frameCount, float ticksPerFrame, float samplesPerSecond, std::vector<float>&& frames);
+
+	/**
+	 * \brief Pose at the given time (in ticks, clamped to the duration). Only (re)allocates the pose the first time it is used for this animation.
+	 */
+	void sample(float animationTime, AnimationPose& outPose) const;
+
+	int getChannelCount() const;
+	int getFrameCount() const;
+	float getTicksPerFrame() const;
+	float getSamplesPerSecond() const;
+
+	/**
+	 * \brief All frames back to back, frame f starts at f * AnimationPose::COMPONENT_COUNT * the channel count rounded up to a multiple of 4
+	 */
+	const std::vector<float>& getFrames() const;
+
+	/**
+	 * \brief Compares the baked frames with Bone::update() halfway in between every two frames (where linear interpolation is the furthest off)
+	 * and logs the largest differences. Slow, only done while baking.
+	 * \param bones		the channels it was baked from (updated while checking)
+	 * \return			whether they are all within the tolerance
+	 */
+	bool verify(std::vector<Bone>& bones, const AnimationBakeTolerance& tolerance) const;
+
+private:
+	int _channelCount = 0;
+	int _stride = 0;
+	int _frameCount = 0;
+	float _ticksPerFrame = 1.0f;
+	float _samplesPerSecond = 0.0f;
+	std::vector<float> _frames; // frame f starts at f * COMPONENT_COUNT * _stride
+
+	void bakeFrames(std::vector<Bone>& bones, float duration, float ticksPerSecond, float samplesPerSecond);
+	static float chooseSamplesPerSecond(const std::vector<Bone>& bones, float duration, float ticksPerSecond);
+};
+
+#endif
@@ -1,10 +1,46 @@
 ﻿#include "Bone.h"
 
+#include <algorithm>
+
 #include "MathConversionUtil.h"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/quaternion.hpp>
 
+constexpr auto KEY_CURSOR_LINEAR_STEPS = 4; // keys the cursor may walk forward before giving up and binary searching instead
+
+namespace
+{
+/**
+ * Index i of the pair of keys (i, i + 1) around animationTime, for a track of at least 2 keys.
+ *
+ * During playback the time only moves forward by a fraction of a key or a few keys per frame, so the cursor
+ * (where the previous call ended up) is walked forward from there: O(1) no matter how long the clip is.
+ * When the time jumped somewhere else (looping around, seeking, a new crossfade) it falls back to a binary search.
+ */
+template<class TKey>
+int findKeyIndex(const std::vector<TKey>& keys, const float animationTime, int& cursor)
+{
+	const int lastIndex = (int)keys.size() - 2;
+	if (!(animationTime >= keys[1].timeStamp)) return cursor = 0; // (NaN ends up here too)
+	if (animationTime >= keys[lastIndex].timeStamp) return cursor = lastIndex;
+
+	int i = std::clamp(cursor, 0, lastIndex);
+	if (keys[i].timeStamp <= animationTime)
+	{
+		for (int step = 0; step < KEY_CURSOR_LINEAR_STEPS && i < lastIndex && keys[i + 1].timeStamp <= animationTime; ++step) ++i;
+		if (animationTime < keys[i + 1].timeStamp) return cursor = i;
+	}
+
+	// first key after the time, the one before it is where the interpolation starts
+	const auto next = std::upper_bound(keys.begin() + 1, keys.end(), animationTime, [](const float time, const TKey& key)
+	{
+		return time < key.timeStamp;
+	});
+	return cursor = (int)(next - keys.begin()) - 1;
+}
+}
+
 Bone::Bone(const std::string& name, const int boneId, const aiNodeAnim* channel)
 :
 _numPositions(channel->mNumPositionKeys),
@@ -48,6 +84,20 @@ _localTransforms(glm::mat4(1.0f), glm::vec3(0.0f), glm::quat(0.0f, 0.0f, 0.0f, 0
 	}
 }
 
+Bone::Bone(const int boneId, BoneKeys&& keys)
+:
+_positions(std::move(keys.positions)),
+_rotations(std::move(keys.rotations)),
+_scales(std::move(keys.scales)),
+_numPositions((int)this->_positions.size()),
+_numRotations((int)this->_rotations.size()),
+_numScalings((int)this->_scales.size()),
+_name(std::move(keys.name)),
+_id(boneId),
+_localTransforms(glm::mat4(1.0f), glm::vec3(0.0f), glm::quat(0.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.0f))
+{
+}
+
 void Bone::update(float animationTime)
 {
 	auto [translationM, translation] = this->interpolatePosition(animationTime);
@@ -83,52 +133,51 @@ int Bone::getBoneId() const
 	return this->_id;
 }
 
-int Bone::getPositionIndex(const float animationTime) const
+int Bone::getMaxKeyCount() const
 {
-	for (int i = 0; i < this->_numPositions - 1; ++i)
-	{
-		if (animationTime < this->_positions[i + 1].timeStamp)
-			return i; // first index of a keyframe that happens after the specified animation time
-	}
-	throw std::exception("Invalid animation time state");
+	return std::max({ this->_numPositions, this->_numRotations, this->_numScalings });
 }
 
-int Bone::getRotationIndex(const float animationTime) const
+const std::vector<KeyPosition>& Bone::getPositionKeys() const
 {
-	for (int i = 0; i < this->_numRotations - 1; ++i)
-	{
-		if (animationTime < this->_rotations[i + 1].timeStamp)
-			return i; // first index of a keyframe that happens after the specified animation time
-	}
-	throw std::exception("Invalid animation time state");
+	return this->_positions;
 }
 
-int Bone::getScaleIndex(const float animationTime) const
+const std::vector<KeyRotation>& Bone::getRotationKeys() const
 {
-	for (int i = 0; i < this->_numScalings - 1; ++i)
-	{
-		if (animationTime < this->_scales[i + 1].timeStamp)
-			return i; // first index of a keyframe that happens after the specified animation time
-	}
-	throw std::exception("Invalid animation time state");
+	return this->_rotations;
+}
+
+const std::vector<KeyScale>& Bone::getScaleKeys() const
+{
+	return this->_scales;
 }
 
-glm::mat4 Bone::interpolateBetweenTwo(
-	const InterpolatedTransform& first, 
-	const InterpolatedTransform& second,
-	float interpolationFactorFirst)
+int Bone::getPositionIndex(const float animationTime)
 {
-	// quite similar to the separate interpolations, btw!
+	return findKeyIndex(this->_positions, animationTime, this->_positionCursor);
+}
 
-	glm::vec3 finalPos = glm::mix(first.translation, second.translation, interpolationFactorFirst);
-	glm::quat finalRotation = glm::normalize(glm::slerp(first.rotation, second.rotation, interpolationFactorFirst));
-	glm::vec3 finalScale = glm::mix(first.scale, second.scale, interpolationFactorFirst);
+int Bone::getRotationIndex(const float animationTime)
+{
+	return findKeyIndex(this->_rotations, animationTime, this->_rotationCursor);
+}
 
-	glm::mat4 translation = glm::translate(glm::mat4(1.0f), finalPos);
-	glm::mat4 rotation = glm::toMat4(finalRotation);
-	glm::mat4 scale = glm::scale(glm::mat4(1.0f), finalScale);
+int Bone::getScaleIndex(const float animationTime)
+{
+	return findKeyIndex(this->_scales, animationTime, this->_scaleCursor);
+}
 
-	return translation * rotation * scale;
+glm::mat4 Bone::composeTransform(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+	// the scale only scales the columns of the rotation, the translation is the last column
+	const glm::mat3 rotationM = glm::mat3_cast(rotation);
+	return glm::mat4(
+		glm::vec4(rotationM[0] * scale.x, 0.0f),
+		glm::vec4(rotationM[1] * scale.y, 0.0f),
+		glm::vec4(rotationM[2] * scale.z, 0.0f),
+		glm::vec4(translation, 1.0f)
+	);
 }
 
 // note from self: this entire thing is equivalent to how I'm handling movement displacement interpolation for my "Nomad" characters
@@ -139,10 +188,10 @@ float Bone::getScaleFactor(const float lastTimeStamp, const float nextTimeStamp,
 	const float midWayLength = animationTime - lastTimeStamp;
 	const float framesDiff = nextTimeStamp - lastTimeStamp;
 	const float scaleFactor = midWayLength / framesDiff;
-	return scaleFactor;
+	return std::clamp(scaleFactor, 0.0f, 1.0f); // (times outside of the track hold the first/last key)
 }
 
-std::tuple<glm::mat4, glm::vec3> Bone::interpolatePosition(const float animationTime) const
+std::tuple<glm::mat4, glm::vec3> Bone::interpolatePosition(const float animationTime)
 {
 	if (this->_numPositions == 1) 
 		return {glm::translate(glm::mat4(1.0f), this->_positions[0].position), this->_positions[0].position };
@@ -159,7 +208,7 @@ std::tuple<glm::mat4, glm::vec3> Bone::interpolatePosition(const float animation
 	return {glm::translate(glm::mat4(1.0f), finalPos), finalPos};
 }
 
-std::tuple<glm::mat4, glm::quat> Bone::interpolateRotation(const float animationTime) const
+std::tuple<glm::mat4, glm::quat> Bone::interpolateRotation(const float animationTime)
 {
 	if (this->_numRotations == 1) 
 		return {glm::toMat4(glm::normalize(this->_rotations[0].orientation)), glm::normalize(this->_rotations[0].orientation) };
@@ -177,7 +226,7 @@ std::tuple<glm::mat4, glm::quat> Bone::interpolateRotation(const float animation
 	return {glm::toMat4(finalRotation), finalRotation};
 }
 
-std::tuple<glm::mat4, glm::vec3> Bone::interpolateScaling(const float animationTime) const
+std::tuple<glm::mat4, glm::vec3> Bone::interpolateScaling(const float animationTime)
 {
 	if (this->_numScalings == 1) 
 		return {glm::scale(glm::mat4(1.0f), this->_scales[0].scale), this->_scales[0].scale };
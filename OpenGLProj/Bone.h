@@ -40,6 +40,17 @@ struct KeyScale : public KeyItemBase
 };
 
 
+/**
+ * \brief Every key of one channel, as stored in the animation cache (see AnimationSet)
+ */
+struct BoneKeys
+{
+	std::string name;
+	std::vector<KeyPosition> positions;
+	std::vector<KeyRotation> rotations;
+	std::vector<KeyScale> scales;
+};
+
 struct InterpolatedTransform
 {
 	// is the same as (translation * rotation * scale) after converting these to matrices
@@ -62,6 +73,11 @@ class Bone
 public:
 	Bone(const std::string& name, int boneId, const aiNodeAnim* channel);
 
+	/**
+	 * \brief Same as above, from keys read back from the animation cache (every track has at least one key)
+	 */
+	Bone(int boneId, BoneKeys&& keys);
+
 	/**
 	 * \brief Interpolates between positions, rotations and scaling keys based on the current time of the animation
 	 *		  and prepares the local transformation matrix by combining all keys' transformations
@@ -74,31 +90,44 @@ public:
 	const std::string& getBoneName() const;
 	int getBoneId() const;
 
+	/**
+	 * \brief Number of keys of its longest track (positions, rotations or scales)
+	 */
+	int getMaxKeyCount() const;
+
+	const std::vector<KeyPosition>& getPositionKeys() const;
+	const std::vector<KeyRotation>& getRotationKeys() const;
+	const std::vector<KeyScale>& getScaleKeys() const;
+
 	/**
 	 * \brief Get the current index on _positions to interpolate to based on the current animation time
 	 * \param animationTime			Animation time at which we must get the Key Position's index
 	 *
-	 *	raises error when no appropriate time can be found for the timestamp
+	 *	times before the first/after the last key are clamped to the first/last pair of keys.
+	 *	Starts looking from where the previous call ended up (see findKeyIndex() in Bone.cpp)
 	 */
-	int getPositionIndex(float animationTime) const;
+	int getPositionIndex(float animationTime);
 
 	/**
 	 * \brief Get the current index on _rotations to interpolate to based on the current animation time
 	 * \param animationTime			Animation time at which we must get the Key Rotation's index
 	 *
-	 *	raises error when no appropriate time can be found for the timestamp
+	 *	same clamping and caching as getPositionIndex()
 	 */
-	int getRotationIndex(float animationTime) const;
+	int getRotationIndex(float animationTime);
 
 	/**
 	 * \brief Get the current index on _scales to interpolate to based on the current animation time
 	 * \param animationTime			Animation time at which we must get the Key Scale's index
 	 *
-	 *	raises error when no appropriate time can be found for the timestamp
+	 *	same clamping and caching as getPositionIndex()
 	 */
-	int getScaleIndex(float animationTime) const;
+	int getScaleIndex(float animationTime);
 
-	static glm::mat4 interpolateBetweenTwo(const InterpolatedTransform& first, const InterpolatedTransform& second, float interpolationFactorFirst);
+	/**
+	 * \brief translation * rotation * scale as one matrix, without building (and multiplying) the three separate matrices
+	 */
+	static glm::mat4 composeTransform(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
 
 private:
 	std::vector<KeyPosition> _positions;
@@ -109,6 +138,11 @@ private:
 	int _numRotations;
 	int _numScalings;
 
+	// key index found by the previous sample of each track, normal playback only moves these forward a little every frame
+	int _positionCursor = 0;
+	int _rotationCursor = 0;
+	int _scaleCursor = 0;
+
 	InterpolatedTransform _localTransforms;
 	std::string _name;
 	int _id; // bone id
@@ -123,21 +157,21 @@ private:
 	 * \param animationTime			Time at which the animation is being computed
 	 * \return						The translation matrix for this animation time
 	 */
-	std::tuple<glm::mat4, glm::vec3> interpolatePosition(float animationTime) const;
+	std::tuple<glm::mat4, glm::vec3> interpolatePosition(float animationTime);
 
 	/**
 	 * \brief figures out which position keys to interpolate between and performs the interpolation. Returns the rotation matrix.
 	 * \param animationTime			Time at which the animation is being computed
 	 * \return						The rotation matrix for this animation time
 	 */
-	std::tuple<glm::mat4, glm::quat> interpolateRotation(float animationTime) const;
+	std::tuple<glm::mat4, glm::quat> interpolateRotation(float animationTime);
 
 	/**
 	 * \brief figures out which position keys to interpolate between and performs the interpolation. Returns the scale matrix.
 	 * \param animationTime			Time at which the animation is being computed
 	 * \return						The scale matrix for this animation time
 	 */
-	std::tuple<glm::mat4, glm::vec3> interpolateScaling(float animationTime) const;
+	std::tuple<glm::mat4, glm::vec3> interpolateScaling(float animationTime);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "BonePaletteBuffer.h"
+
+BonePaletteBuffer::BonePaletteBuffer()
+{
+	glGenBuffers(1, &this->_buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, this->_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::mat4), nullptr, GL_STREAM_DRAW); // (storage must exist before it can be attached)
+
+	glGenTextures(1, &this->_texture);
+	glBindTexture(GL_TEXTURE_BUFFER, this->_texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, this->_buffer);
+
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+BonePaletteBuffer::~BonePaletteBuffer()
+{
+	glDeleteTextures(1, &this->_texture);
+	glDeleteBuffers(1, &this->_buffer);
+}
+
+void BonePaletteBuffer::setupShader(Shader& shader)
+{
+	shader.use();
+	shader.setInt("bonePalette", BONE_PALETTE_TEXTURE_UNIT);
+}
+
+void BonePaletteBuffer::upload(const std::vector<Animator*>& animators)
+{
+	this->_staging.clear();
+	for (Animator* animator : animators) animator->setBonePaletteOffset(-1);
+
+	for (Animator* animator : animators)
+	{
+		if (animator->getSharedPoseSource() != nullptr) continue; // done below
+		this->appendPalette(animator);
+	}
+
+	// animators that copied their pose from another one (see PoseCache) point at the same palette
+	for (Animator* animator : animators)
+	{
+		const Animator* source = animator->getSharedPoseSource();
+		if (source == nullptr) continue;
+
+		if (source->getBonePaletteOffset() != -1) animator->setBonePaletteOffset(source->getBonePaletteOffset());
+		else this->appendPalette(animator); // (the source itself isn't drawn through this buffer)
+	}
+	if (this->_staging.empty()) this->_staging.emplace_back(1.0f); // (a zero sized buffer can't be sampled)
+
+	// a fresh glBufferData every frame lets the driver hand out new storage instead of waiting for last frame's draws
+	glBindBuffer(GL_TEXTURE_BUFFER, this->_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, this->_staging.size() * sizeof(glm::mat4), this->_staging.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glActiveTexture(GL_TEXTURE0 + BONE_PALETTE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, this->_texture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void BonePaletteBuffer::appendPalette(Animator* animator)
+{
+	const std::vector<glm::mat4>& matrices = animator->getFinalBoneMatrices();
+	animator->setBonePaletteOffset((int)this->_staging.size());
+	this->_staging.insert(this->_staging.end(), matrices.begin(), matrices.begin() + animator->getUsedBoneCount());
+}
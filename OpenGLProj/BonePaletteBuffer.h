@@ -0,0 +1,48 @@
+#ifndef BONEPALETTEBUFFER_MINE_H
+#define BONEPALETTEBUFFER_MINE_H
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "Animator.h"
+#include "Shader.h"
+
+// far above the units the mesh materials use, so the samplerBuffer never shares a unit with a sampler2D
+constexpr auto BONE_PALETTE_TEXTURE_UNIT = 15;
+
+/**
+ * \brief The bone matrices of every animated entity in the scene, packed back to back in one texture buffer.
+ *
+ * upload() writes all palettes with a single buffer update per frame and tells every Animator where its own palette starts
+ * (see Animator::getBonePaletteOffset()). Shaders read them through "uniform samplerBuffer bonePalette", 4 texels (the columns) per matrix,
+ * so drawing an entity only has to set its "boneOffset" and "boneCount" (see AnimatedEntity::setupEntityShaderForAnim()).
+ * Palettes are only as long as Animator::getUsedBoneCount(), the shaders clamp the bone ids to boneCount so a bad id can't read the next entity's palette.
+ */
+class BonePaletteBuffer
+{
+public:
+	BonePaletteBuffer();
+	~BonePaletteBuffer();
+
+	BonePaletteBuffer(const BonePaletteBuffer&) = delete;
+	BonePaletteBuffer& operator=(const BonePaletteBuffer&) = delete;
+
+	/**
+	 * \brief Points the shader's bonePalette sampler at BONE_PALETTE_TEXTURE_UNIT. Once per shader, leaves it in use
+	 */
+	static void setupShader(Shader& shader);
+
+	/**
+	 * \brief Packs the (evaluated) bone matrices of the given animators and uploads them, then binds the buffer for this frame's draws.
+	 * Only the bones their models actually use are uploaded, and animators sharing a pose (see PoseCache) share one palette.
+	 */
+	void upload(const std::vector<Animator*>& animators);
+
+private:
+	unsigned int _buffer = 0;
+	unsigned int _texture = 0;
+	std::vector<glm::mat4> _staging; // reused every frame
+
+	void appendPalette(Animator* animator);
+};
+
+#endif
@@ -2,5 +2,6 @@
 #define CONFIGCONSTANTS_MINE_H
 
 constexpr auto USE_SRGB_COLORS = true;
+constexpr auto USE_PRE_SKINNING = true; // skin animated models once per frame and draw them as static geometry in every pass (see SkinningPass)
 
 #endif
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <GLFW/glfw3.h>
 
 #include "AnimatedEntity.h"
+#include "BonePaletteBuffer.h"
 #include "Colors.h"
 #include "ErrorUtils.h"
 #include "FileConstants.h"
@@ -49,6 +50,8 @@ DistanceFieldPostProcessor::~DistanceFieldPostProcessor()
 
 void DistanceFieldPostProcessor::setupShaders()
 {
+	BonePaletteBuffer::setupShader(this->_maskingShader);
+
 	this->_UVMaskShader.use();
 	this->_UVMaskShader.setInt("mask", 0);
 
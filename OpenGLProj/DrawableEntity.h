@@ -1,6 +1,7 @@
 #ifndef DRAWABLEENTITY_MINE_H
 #define DRAWABLEENTITY_MINE_H
 #include "Shader.h"
+#include "ViewFrustum.h"
 
 /**
  * \brief An entity that can be rendered
@@ -10,6 +11,11 @@ class DrawableEntity
 public:
 	virtual ~DrawableEntity() = default;
 	virtual void draw(Shader& shader) = 0;
+
+	/**
+	 * \brief Whether draw(shader) would put anything on screen for the given frustum. Draws by default.
+	 */
+	virtual bool isVisible(const ViewFrustum& frustum) { return true; }
 };
 
 #endif
\ No newline at end of file
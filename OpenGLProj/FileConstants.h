@@ -26,6 +26,7 @@ constexpr auto SHADER_DISTANCEFIELD_FRAG = "distancefield.frag";
 
 constexpr auto SHADER_MESH_VERT = "mesh.vert";
 constexpr auto SHADER_MESH_FRAG = "mesh.frag";
+constexpr auto SHADER_SKINNING_VERT = "skinning.vert"; // (transform feedback only, no fragment shader)
 
 
 constexpr auto SHADER_PARTICLES_VERT = "particles.vert";
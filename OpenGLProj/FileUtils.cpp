@@ -1,70 +1,227 @@
 #include "FileUtils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
 
 #include "ConfigConstants.h"
 #include "stb_image.h"
+#include "TextureCompression.h"
+
+// (S3TC isn't core OpenGL, see detectTextureCompressionSupport(). In case glad was generated without the extensions)
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// set on the GL thread before any request is made, read by the workers decoding textures. Off until it's known (e.g. for --cook)
+static std::atomic<bool> isS3TCSupported = false;
+
+void detectTextureCompressionSupport()
+{
+	// glad has to be generated with both extensions for its flags, otherwise the driver's extension list is searched
+#if defined(GL_EXT_texture_compression_s3tc) && defined(GL_EXT_texture_sRGB)
+	const bool hasS3TC = GLAD_GL_EXT_texture_compression_s3tc;
+	const bool hasSRGB = GLAD_GL_EXT_texture_sRGB;
+#else
+	auto hasExtension = [](const char* name)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; ++i)
+		{
+			if (strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), name) == 0) return true;
+		}
+		return false;
+	};
+	const bool hasS3TC = hasExtension("GL_EXT_texture_compression_s3tc");
+	const bool hasSRGB = hasExtension("GL_EXT_texture_sRGB");
+#endif
+
+	// (the sRGB versions are only needed when colors are loaded as sRGB at all)
+	isS3TCSupported = hasS3TC && (hasSRGB || !USE_SRGB_COLORS);
+	if (!isS3TCSupported) std::cout << "WARNING: no S3TC texture compression, cooked color textures are decoded from their source images instead" << std::endl;
+}
 
 
 
 
-unsigned loadTextureFromFile(const char* path, const std::string& directory, std::optional<GLenum> activeTextureUnit, bool loadAsSRGB)
+DecodedTexture::~DecodedTexture()
+{
+	stbi_image_free(this->data);
+	delete this->cooked;
+}
+
+DecodedTexture::DecodedTexture(DecodedTexture&& other) noexcept
+:
+width(other.width),
+height(other.height),
+channels(other.channels),
+data(other.data),
+cooked(other.cooked)
+{
+	other.data = nullptr;
+	other.cooked = nullptr;
+}
+
+DecodedTexture& DecodedTexture::operator=(DecodedTexture&& other) noexcept
+{
+	if (this == &other) return *this;
+	stbi_image_free(this->data);
+	delete this->cooked;
+	this->width = other.width;
+	this->height = other.height;
+	this->channels = other.channels;
+	this->data = other.data;
+	this->cooked = other.cooked;
+	other.data = nullptr;
+	other.cooked = nullptr;
+	return *this;
+}
+
+DecodedTexture decodeTextureFile(const char* path, const std::string& directory, bool flipVertically)
 {
 	std::string fileName(path);
 	fileName = directory + '/' + fileName;
 
-	unsigned int textureId = -1;
-	glGenTextures(1, &textureId);
-
-	stbi_set_flip_vertically_on_load(true);
-	int width, height, nrChannels;
-	unsigned char* data = stbi_load(fileName.c_str(), &width, &height, &nrChannels, 0);
-	if (data)
+	DecodedTexture texture;
+	if (flipVertically)
 	{
-		GLenum format;
-		GLint internalFormat;
-		switch(nrChannels)
+		texture.cooked = openCookedTexture(fileName);
+		if (texture.cooked != nullptr && !isS3TCSupported
+			&& (texture.cooked->format == TextureBlockFormat::BC1 || texture.cooked->format == TextureBlockFormat::BC3))
+		{
+			delete texture.cooked; // (the driver can't take it, see detectTextureCompressionSupport())
+			texture.cooked = nullptr;
+		}
+		if (texture.cooked != nullptr)
 		{
-		case 1:
-			internalFormat = GL_RED;
-			format = GL_RED;
-			break;
-		case 3:
-			internalFormat = loadAsSRGB ? GL_SRGB : GL_RGB;
-			format = GL_RGB;
-			break;
-		case 4:
-			internalFormat = loadAsSRGB ? GL_SRGB_ALPHA : GL_RGBA;
-			format = GL_RGBA;
-			break;
-		default:
-			std::cout << "Texture had unexpected number of channels!" << std::endl;
-			stbi_image_free(data);
-			return -1;
+			texture.width = texture.cooked->width;
+			texture.height = texture.cooked->height;
+			switch (texture.cooked->format)
+			{
+			case TextureBlockFormat::BC1: texture.channels = 3; break;
+			case TextureBlockFormat::BC3: texture.channels = 4; break;
+			case TextureBlockFormat::BC4: texture.channels = 1; break;
+			case TextureBlockFormat::BC5: texture.channels = 2; break;
+			}
+			return texture;
 		}
+	}
 
-		if (activeTextureUnit.has_value()) glActiveTexture(activeTextureUnit.value());
+	// (the per thread setting, so decodes running in parallel can't flip each other's images)
+	stbi_set_flip_vertically_on_load_thread(flipVertically);
+	texture.data = stbi_load(fileName.c_str(), &texture.width, &texture.height, &texture.channels, 0);
+	stbi_set_flip_vertically_on_load_thread(false); // back to the default for anything else this thread loads (e.g. the terrain height map)
 
-		glBindTexture(GL_TEXTURE_2D, textureId);
-		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+	if (texture.data == nullptr) std::cout << "Failed to load texture (at '" << fileName << "')" << std::endl;
+	return texture;
+}
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+/**
+ * The blocks go to the GPU as they are (no decoding, no glGenerateMipmap(): every mip level is in the file already)
+ */
+static unsigned int uploadCookedTexture(unsigned int textureId, const CookedTexture& cooked, std::optional<GLenum> activeTextureUnit, bool loadAsSRGB)
+{
+	GLenum internalFormat;
+	switch (cooked.format)
+	{
+	case TextureBlockFormat::BC1:
+		internalFormat = loadAsSRGB ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		break;
+	case TextureBlockFormat::BC3:
+		internalFormat = loadAsSRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		break;
+	case TextureBlockFormat::BC4:
+		internalFormat = GL_COMPRESSED_RED_RGTC1;
+		break;
+	default:
+		internalFormat = GL_COMPRESSED_RG_RGTC2;
+		break;
+	}
 
-		glGenerateMipmap(GL_TEXTURE_2D);
+	if (activeTextureUnit.has_value()) glActiveTexture(activeTextureUnit.value());
+
+	glBindTexture(GL_TEXTURE_2D, textureId);
+	const unsigned char* blocks = cooked.blocks;
+	int width = cooked.width;
+	int height = cooked.height;
+	for (int mip = 0; mip < cooked.mipCount; ++mip)
+	{
+		const size_t size = getBlockCompressedSize(cooked.format, width, height);
+		glCompressedTexImage2D(GL_TEXTURE_2D, mip, internalFormat, width, height, 0, (GLsizei)size, blocks);
+		blocks += size;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
 	}
-	else
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, cooked.mipCount - 1);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return textureId;
+}
+
+unsigned uploadTexture(const DecodedTexture& texture, std::optional<GLenum> activeTextureUnit, bool loadAsSRGB)
+{
+	unsigned int textureId = -1;
+	glGenTextures(1, &textureId);
+	if (!texture.isLoaded()) return textureId; // (already logged by decodeTextureFile())
+	if (texture.cooked != nullptr) return uploadCookedTexture(textureId, *texture.cooked, activeTextureUnit, loadAsSRGB);
+
+	GLenum format;
+	GLint internalFormat;
+	switch(texture.channels)
 	{
-		std::cout << "Failed to load texture (at '" << fileName << "')" << std::endl;
+	case 1:
+		internalFormat = GL_RED;
+		format = GL_RED;
+		break;
+	case 3:
+		internalFormat = loadAsSRGB ? GL_SRGB : GL_RGB;
+		format = GL_RGB;
+		break;
+	case 4:
+		internalFormat = loadAsSRGB ? GL_SRGB_ALPHA : GL_RGBA;
+		format = GL_RGBA;
+		break;
+	default:
+		std::cout << "Texture had unexpected number of channels!" << std::endl;
+		return -1;
 	}
 
-	stbi_image_free(data);
+	if (activeTextureUnit.has_value()) glActiveTexture(activeTextureUnit.value());
+
+	glBindTexture(GL_TEXTURE_2D, textureId);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, texture.width, texture.height, 0, format, GL_UNSIGNED_BYTE, texture.data);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glGenerateMipmap(GL_TEXTURE_2D);
 
 	return textureId;
 }
 
+unsigned loadTextureFromFile(const char* path, const std::string& directory, std::optional<GLenum> activeTextureUnit, bool loadAsSRGB)
+{
+	const DecodedTexture texture = decodeTextureFile(path, directory);
+	return uploadTexture(texture, activeTextureUnit, loadAsSRGB);
+}
+
 unsigned loadSRGBColorSpaceTexture(const char* path, const std::string& directory,
 	std::optional<GLenum> activeTextureUnit)
 {
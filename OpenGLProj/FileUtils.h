@@ -7,8 +7,59 @@
 
 const std::string PROJ_CURRENT_DIR = ".";
 
+struct CookedTexture;
+
+/**
+ * \brief Pixels of an image file, decoded but not uploaded (see decodeTextureFile()). Frees the pixels when it goes away.
+ * If the file has been cooked (see cookTexture()), it holds the compressed blocks instead of the pixels.
+ */
+struct DecodedTexture
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0; // (of the cooked format, for a cooked texture)
+	unsigned char* data = nullptr; // nullptr if the file could not be decoded, or it's cooked
+	CookedTexture* cooked = nullptr;
+
+	bool isLoaded() const { return this->data != nullptr || this->cooked != nullptr; }
+
+	DecodedTexture() = default;
+	~DecodedTexture();
+	DecodedTexture(DecodedTexture&& other) noexcept;
+	DecodedTexture& operator=(DecodedTexture&& other) noexcept;
+
+	DecodedTexture(const DecodedTexture&) = delete;
+	DecodedTexture& operator=(const DecodedTexture&) = delete;
+};
+
+/**
+ * \brief Checks whether the driver takes the S3TC formats the cooked color textures use (BC1/BC3, see cookTexture()). They aren't core
+ * OpenGL 3.3 but come from GL_EXT_texture_compression_s3tc (and GL_EXT_texture_sRGB for the sRGB versions). Without them decodeTextureFile()
+ * skips those cooked files and decodes the source image instead (the cooked normal maps are RGTC, which is core).
+ * Call once on the thread with the OpenGL context, right after loading glad and before anything is decoded.
+ */
+void detectTextureCompressionSupport();
+
+/**
+ * \brief CPU half of loadTextureFromFile(): only reads and decodes the file. Makes no OpenGL calls, so it can run on any thread.
+ * An up to date cooked version of the file is mapped instead of decoding it (only when flipped, cooked textures always are, and only
+ * if the driver takes its format, see detectTextureCompressionSupport()).
+ *
+ * \param flipVertically		so the first row ends up at the bottom (texture coordinates start there). Only applies to the calling thread
+ */
+DecodedTexture decodeTextureFile(const char* path, const std::string& directory = "", bool flipVertically = true);
+
+/**
+ * \brief GL half of loadTextureFromFile(): uploads the decoded pixels (with mipmaps), or the compressed blocks of every mip level of a
+ * cooked texture as they are. Has to run on the thread with the OpenGL context.
+ * The parameters are the same as loadTextureFromFile()'s.
+ *
+ * \return						id of the new texture
+ */
+unsigned int uploadTexture(const DecodedTexture& texture, std::optional<GLenum> activeTextureUnit = std::nullopt, bool loadAsSRGB = false);
+
 /**
- * \brief General texture loader
+ * \brief General texture loader. Uses the cooked (block compressed, see cookTexture()) version of the file if it is up to date.
  *
  * \param path					Path to the file
  * \param directory				Base directory that the file resides in
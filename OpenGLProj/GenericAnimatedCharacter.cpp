@@ -1,9 +1,10 @@
 ﻿#include "GenericAnimatedCharacter.h"
 
-#include "InterpolationMathUtil.h"
 #include "WorldMathUtils.h"
 
 constexpr auto FIXED_PITCH = 0.0f;  /* always 0 for now */
+constexpr auto BASE_ANIMATION_LAYER = 0;
+constexpr auto MASKED_ANIMATION_LAYER = 1; // see playMaskedAnimation()
 
 
 GenericAnimatedCharacter::GenericAnimatedCharacter(
@@ -29,11 +30,12 @@ _animationTransitionTime(animationTransitionTime)
 
 void GenericAnimatedCharacter::draw(Shader& shader)
 {
-	const std::vector<glm::mat4> transforms = this->_animator.getFinalBoneMatrices();
-	this->setupEntityShaderForAnim(shader, transforms);
+	this->drawAnimatedModel(shader);
+}
 
-	this->_model->draw(shader);
-	this->clearEntityShaderForAnim(shader);
+bool GenericAnimatedCharacter::isVisible(const ViewFrustum& frustum)
+{
+	return this->_model->isVisible(frustum, ANIMATED_BOUNDS_SCALE);
 }
 
 glm::vec3 GenericAnimatedCharacter::getCurrentPosition() const
@@ -77,6 +79,11 @@ Animator& GenericAnimatedCharacter::getAnimator()
 	return this->_animator;
 }
 
+RenderableGameObject* GenericAnimatedCharacter::getAnimatedModel()
+{
+	return this->_model;
+}
+
 RenderableGameObject* GenericAnimatedCharacter::getRenderableGameModel() const
 {
 	return this->_model;
@@ -104,47 +111,39 @@ void GenericAnimatedCharacter::setYaw(const float newYaw)
 
 void GenericAnimatedCharacter::playAnimation(const std::string& animationName)
 {
-	this->_animator.clearAnimation2();
 	this->_animator.playAnimation(animationName);
-	this->_animation1 = animationName;
 }
 
 void GenericAnimatedCharacter::playAnimationWithTransition(const std::string& animationName)
 {
-	if (!this->_animation1.empty())
+	// (plays right away if nothing was playing yet)
+	this->_animator.getBlendTree().crossFade(BASE_ANIMATION_LAYER, this->_animator.getAnimationByName(animationName), this->_animationTransitionTime);
+}
+
+void GenericAnimatedCharacter::playMaskedAnimation(const std::string& animationName, const BoneMask* mask)
+{
+	AnimationBlendTree& blendTree = this->_animator.getBlendTree();
+	Animation* animation = this->_animator.getAnimationByName(animationName);
+	if (blendTree.getLayer(MASKED_ANIMATION_LAYER).clipCount == 0)
 	{
-		this->_animationInterpolationStart = this->_time->getCurrentTime();
-		this->_animator.startPlaying2ndAnimation(
-			this->_animator.getAnimationByName(animationName)
-		);
-		this->_animation2 = animationName;
-		//std::cout << "Start interpolating " << this->_animation1 << " -> " << this->_animation2 << std::endl;
+		// fades in over the base animation instead of snapping to it
+		blendTree.play(MASKED_ANIMATION_LAYER, animation);
+		blendTree.setLayerWeight(MASKED_ANIMATION_LAYER, 0.0f);
 	}
 	else
 	{
-		this->playAnimation(animationName);
+		blendTree.crossFade(MASKED_ANIMATION_LAYER, animation, this->_animationTransitionTime);
 	}
+	blendTree.setLayerMode(MASKED_ANIMATION_LAYER, BlendMode::OVERRIDE, mask);
+	blendTree.fadeLayer(MASKED_ANIMATION_LAYER, 1.0f, this->_animationTransitionTime);
+}
+
+void GenericAnimatedCharacter::stopMaskedAnimation()
+{
+	this->_animator.getBlendTree().fadeLayer(MASKED_ANIMATION_LAYER, 0.0f, this->_animationTransitionTime);
 }
 
 void GenericAnimatedCharacter::updateAnimationInterpolationForFrame()
 {
-	if (!this->_animation2.empty() && (this->_time->getCurrentTime() <= this->_animationInterpolationStart + this->_animationTransitionTime))
-	{
-		// interpolate between two animations based on time (within the time span of ANIMATION_TRANSITION_TIME)
-		float interpolationFactor = (this->_time->getCurrentTime() - this->_animationInterpolationStart) / this->_animationTransitionTime;
-		interpolationFactor = InterpolationMathUtil::easeInOutCosine(interpolationFactor);
-		//std::cout << "Interpolating " << this->_animation1 << " -> " << this->_animation2 << " @ " << interpolationFactor << std::endl;
-		this->_animator.updateAnimation2(this->_time->getDeltaTime(), interpolationFactor);
-	}
-	else
-	{
-		if (!this->_animation2.empty())
-		{
-			this->_animation1 = this->_animation2;
-			this->_animation2 = ""; // reset the second. Now the first will be played *strictly*
-			this->_animator.flipAnimation1And2();
-			this->_animator.clearAnimation2();
-		}
-		this->_animator.updateAnimation(this->_time->getDeltaTime());
-	}
+	this->_animator.updateAnimation(this->_time->getDeltaTime());
 }
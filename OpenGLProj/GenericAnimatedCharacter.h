@@ -23,6 +23,7 @@ public:
 		);
 
 	void draw(Shader& shader) override;
+	bool isVisible(const ViewFrustum& frustum) override;
 
 	glm::vec3 getCurrentPosition() const override;
 	virtual const glm::vec3& getCurrentFront() const;
@@ -30,8 +31,10 @@ public:
 	virtual float getPitch() const;
 	virtual void rotateTowards(const glm::vec3& position);
 
+	Animator& getAnimator() override;
+	RenderableGameObject* getAnimatedModel() override;
+
 protected:
-	Animator& getAnimator();
 	RenderableGameObject* getRenderableGameModel() const;
 	const WorldTimeManager* getTime() const;
 
@@ -44,6 +47,16 @@ protected:
 	virtual void playAnimationWithTransition(const std::string& animationName);
 	virtual void updateAnimationInterpolationForFrame();
 
+	/**
+	 * \brief Plays the animation over the current one, only on the part of the skeleton the mask covers (faded in). The mask must outlive it
+	 */
+	void playMaskedAnimation(const std::string& animationName, const BoneMask* mask);
+
+	/**
+	 * \brief Fades out the playMaskedAnimation() animation
+	 */
+	void stopMaskedAnimation();
+
 	virtual void updateModelTransform() = 0;
 
 private:
@@ -60,10 +73,6 @@ private:
 	const glm::vec3 _rotateYawOver; // TODO: ^
 
 	const float _animationTransitionTime;
-
-	float _animationInterpolationStart = 0.0f;
-	std::string _animation1 = "";
-	std::string _animation2 = "";
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	this->close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+	this->close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	this->_fileHandle = file;
+	this->_mappingHandle = mapping;
+	this->_data = static_cast<const unsigned char*>(view);
+	this->_size = (size_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (this->_data != nullptr) UnmapViewOfFile(this->_data);
+	if (this->_mappingHandle != nullptr) CloseHandle(this->_mappingHandle);
+	if (this->_fileHandle != nullptr) CloseHandle(this->_fileHandle);
+	this->_data = nullptr;
+	this->_size = 0;
+	this->_mappingHandle = nullptr;
+	this->_fileHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+	this->close();
+
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED)
+	{
+		::close(fd);
+		return false;
+	}
+
+	this->_fileDescriptor = fd;
+	this->_data = static_cast<const unsigned char*>(view);
+	this->_size = (size_t)info.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (this->_data != nullptr) munmap(const_cast<unsigned char*>(this->_data), this->_size);
+	if (this->_fileDescriptor >= 0) ::close(this->_fileDescriptor);
+	this->_data = nullptr;
+	this->_size = 0;
+	this->_fileDescriptor = -1;
+}
+
+#endif
+
+bool MappedFile::isOpen() const
+{
+	return this->_data != nullptr;
+}
+
+const unsigned char* MappedFile::getData() const
+{
+	return this->_data;
+}
+
+size_t MappedFile::getSize() const
+{
+	return this->_size;
+}
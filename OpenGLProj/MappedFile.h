@@ -0,0 +1,41 @@
+#ifndef MAPPEDFILE_MINE_H
+#define MAPPEDFILE_MINE_H
+#include <cstddef>
+#include <string>
+
+/**
+ * \brief Read-only memory mapping of a whole file. The OS pages the contents in on demand,
+ * so nothing is copied until the data is actually touched (e.g. by glBufferData).
+ */
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/**
+	 * \return false if the file does not exist, is empty or could not be mapped
+	 */
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const;
+	const unsigned char* getData() const;
+	size_t getSize() const;
+
+private:
+	const unsigned char* _data = nullptr;
+	size_t _size = 0;
+
+#ifdef _WIN32
+	void* _fileHandle = nullptr;
+	void* _mappingHandle = nullptr;
+#else
+	int _fileDescriptor = -1;
+#endif
+};
+
+#endif
@@ -3,13 +3,15 @@
 #include <utility>
 
 // https://learnopengl.com/Model-Loading/Mesh
-Mesh::Mesh(std::vector<ModelVertex> vertices, std::vector<unsigned> indices, std::vector<Texture> textures):
-vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
+Mesh::Mesh(const ModelVertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, std::vector<Texture> textures):
+textures(std::move(textures)),
+_vertexCount(vertexCount),
+_indexCount(indexCount)
 {
-	this->setupMesh();
+	this->setupMesh(vertices, indices);
 }
 
-void Mesh::setupMesh()
+void Mesh::setupMesh(const ModelVertex* vertices, const unsigned int* indices)
 {
 	glGenVertexArrays(1, &this->_VAO);
 	glGenBuffers(1, &this->_VBO);
@@ -18,9 +20,9 @@ void Mesh::setupMesh()
 	glBindVertexArray(this->_VAO);
 	glBindBuffer(GL_ARRAY_BUFFER, this->_VBO);
 
-	glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(ModelVertex), &this->vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, this->_vertexCount * sizeof(ModelVertex), vertices, GL_STATIC_DRAW);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->_EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(unsigned int), &this->indices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->_indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
 
 
 	//vertex positions
@@ -48,7 +50,52 @@ void Mesh::setupMesh()
 	glBindVertexArray(0);
 }
 
+unsigned int Mesh::createSkinnedVertexArray(unsigned int skinnedVBO) const
+{
+	unsigned int vertexArray;
+	glGenVertexArrays(1, &vertexArray);
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->_EBO);
+
+	// skinned positions and normals
+	glBindBuffer(GL_ARRAY_BUFFER, skinnedVBO);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), (void*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec3), (void*)sizeof(glm::vec3));
+
+	// the rest is the same as the bind pose
+	glBindBuffer(GL_ARRAY_BUFFER, this->_VBO);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(ModelVertex), (void*)offsetof(ModelVertex, texCoords));
+	glEnableVertexAttribArray(5);
+	glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(ModelVertex), (void*)offsetof(ModelVertex, tangent));
+	glEnableVertexAttribArray(6);
+	glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(ModelVertex), (void*)offsetof(ModelVertex, bitangent));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return vertexArray;
+}
+
+void Mesh::drawVertices() const
+{
+	glBindVertexArray(this->_VAO);
+	glDrawArrays(GL_POINTS, 0, (GLsizei)this->_vertexCount);
+	glBindVertexArray(0);
+}
+
+size_t Mesh::getVertexCount() const
+{
+	return this->_vertexCount;
+}
+
 void Mesh::draw(Shader& shader)
+{
+	this->draw(shader, this->_VAO);
+}
+
+void Mesh::draw(Shader& shader, unsigned int vertexArray)
 {
 	unsigned int diffuseNr = 1;
 	unsigned int specularNr = 1;
@@ -80,7 +127,7 @@ void Mesh::draw(Shader& shader)
 	glActiveTexture(GL_TEXTURE0);
 
 	// draw mesh
-	glBindVertexArray(this->_VAO);
-	glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
+	glBindVertexArray(vertexArray);
+	glDrawElements(GL_TRIANGLES, (GLsizei)this->_indexCount, GL_UNSIGNED_INT, 0);
 	glBindVertexArray(0);
 }
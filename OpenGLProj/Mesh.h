@@ -44,21 +44,42 @@ public:
 	inline static const std::string TEXTURE_SPECULAR = "texture_specular";
 	inline static const std::string TEXTURE_NORMAL = "texture_normal";
 
-	// mesh data
-	std::vector<ModelVertex> vertices;
-	std::vector<unsigned int> indices;
+	// mesh data (the vertices and indices only live on the GPU)
 	std::vector<Texture> textures;
 
-	Mesh(std::vector<ModelVertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+	/**
+	 * \brief Uploads the vertices and indices right away, they're not kept around (so they may point into a mapped file, see Model)
+	 */
+	Mesh(const ModelVertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, std::vector<Texture> textures);
 	void draw(Shader& shader);
+
+	/**
+	 * \brief draw(shader), but with the vertices of another vertex array (one made by createSkinnedVertexArray())
+	 */
+	void draw(Shader& shader, unsigned int vertexArray);
+
+	/**
+	 * \brief Vertex array that reads positions and normals (attributes 0 and 1) from skinnedVBO instead, interleaved as written
+	 * by SkinningPass, and everything else from this mesh. Has no bone attributes: meant to be drawn as static geometry.
+	 */
+	unsigned int createSkinnedVertexArray(unsigned int skinnedVBO) const;
+
+	/**
+	 * \brief Draws every vertex once as a point, in order (for transform feedback)
+	 */
+	void drawVertices() const;
+
+	size_t getVertexCount() const;
 private:
 	// render data
 	unsigned int _VAO;
 	unsigned int _VBO;
 	unsigned int _EBO;
+	size_t _vertexCount;
+	size_t _indexCount;
 
 	std::map<std::string, unsigned int> _boneNameToIndexMap;
 
-	void setupMesh();
+	void setupMesh(const ModelVertex* vertices, const unsigned int* indices);
 };
 #endif
\ No newline at end of file
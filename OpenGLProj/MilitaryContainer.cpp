@@ -10,6 +10,11 @@ void MilitaryContainer::draw(Shader& shader)
 	this->_model->draw(shader);
 }
 
+bool MilitaryContainer::isVisible(const ViewFrustum& frustum)
+{
+	return this->_model->isVisible(frustum);
+}
+
 bool MilitaryContainer::hasItems() const
 {
 	return false; // TODO: update...
@@ -13,6 +13,7 @@ public:
 	MilitaryContainer(SphericalBoxedGameObject* model);
 
 	void draw(Shader& shader) override;
+	bool isVisible(const ViewFrustum& frustum) override;
 
 	bool hasItems() const;
 
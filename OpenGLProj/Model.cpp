@@ -1,130 +1,141 @@
 #include "Model.h"
 
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <map>
+#include <set>
+#include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
+#include <assimp/scene.h>
 
 #include "ConfigConstants.h"
-#include "FileUtils.h"
 #include "MathConversionUtil.h"
+#include "TextureCache.h"
+#include "TextureCompression.h"
+
+constexpr auto MODEL_CACHE_EXTENSION = ".modelcache"; // cooked cache lives right next to the model file
+constexpr auto MODEL_CACHE_MAGIC = "MDLC";
+constexpr auto MODEL_CACHE_VERSION = 1u;
+
+static bool importModel(const std::string& path, const aiScene* scene, ModelSource& outSource);
+static void writeCache(const std::string& cachePath, const std::string& sourcePath, const ModelSource& source);
+static bool openCache(MappedFile& file, const std::string& cachePath, const std::string& sourcePath);
+static bool readCache(const std::string& cachePath, const std::string& sourcePath, ModelSource& outSource);
+
+static bool isLoadedAsSRGB(const std::string& textureType)
+{
+	return USE_SRGB_COLORS && textureType != Mesh::TEXTURE_NORMAL; // (normal maps are data, no gamma correction)
+}
 
 
 // https://learnopengl.com/Model-Loading/Model
 // https://www.youtube.com/watch?v=r6Yv_mh79PI
 // https://learnopengl.com/Guest-Articles/2020/Skeletal-Animation
-Model::Model(const char* path)
+Model::Model(const char* path, const aiScene* scene)
 {
-	this->loadModel(path);
+	ModelSource source;
+	if (!prepare(path, scene, source)) throw std::exception("Model could not be loaded");
+	this->takeSkeletonData(source);
+	this->upload(source);
 }
 
-void Model::draw(Shader& shader)
+Model::Model(ModelSource& source)
 {
-	for (unsigned int i = 0; i < this->_meshes.size(); i++)
-	{
-		this->_meshes[i].draw(shader);
-	}
+	this->takeSkeletonData(source);
 }
 
-void Model::loadModel(std::string path)
+Model::~Model()
 {
-	std::cout << "Loading model: '" << path << "'" << std::endl;
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, 
-		aiProcess_Triangulate // if the model does not (entirely) consist of triangles, it should transform all the model's primitive shapes to triangles first
-		| aiProcess_FlipUVs // flips the texture coordinates on the y-axis where necessary during processing
-		| aiProcess_GenNormals
-		| aiProcess_CalcTangentSpace
-		// more interesting options available: https://learnopengl.com/Model-Loading/Model
-		// https://assimp.sourceforge.net/lib_html/postprocess_8h.html
-	);
-
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
-	{
-		std::cout << "Error::ASSIMP::" << importer.GetErrorString() << std::endl;
-		return;
-	}
-	this->_directory = path.substr(0, path.find_last_of('/'));
-	this->processNode(scene->mRootNode, scene);
+	for (const Mesh& mesh : this->_meshes)
+		for (const Texture& texture : mesh.textures) TextureCache::getShared().release(texture.id);
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+bool Model::prepare(const std::string& path, const aiScene* scene, ModelSource& outSource)
 {
-	// process all node's meshes (if any)
-	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+	const std::string cachePath = path + MODEL_CACHE_EXTENSION;
+	outSource.directory = path.substr(0, path.find_last_of('/'));
+
+	if (readCache(cachePath, path, outSource))
 	{
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		this->_meshes.push_back(this->processMesh(mesh, scene)); // this technically flattens the hierarchical relation that was
-		// defined by the model's creator which may disallow hierarchical operations (e.g. move all members of a subsection of the hierarchy tree
+		std::cout << "Loaded model from cache: '" << cachePath << "'" << std::endl;
 	}
-	// then do the same for each of its children
-	for (unsigned int i = 0; i < node->mNumChildren; i++)
+	else
 	{
-		this->processNode(node->mChildren[i], scene);
+		std::cout << "Model cache missing or stale, loading model: '" << path << "'" << std::endl;
+		if (!importModel(path, scene, outSource)) return false;
+		writeCache(cachePath, path, outSource);
 	}
+
+	// every file once, however many meshes use it (and for whatever), and not at all if it's already on the GPU
+	const TextureCache& textureCache = TextureCache::getShared();
+	for (const ModelMeshSource& mesh : outSource.meshes)
+	{
+		for (const ModelTextureReference& texture : mesh.textures)
+		{
+			if (outSource.textureImages.contains(texture.path) || textureCache.contains(texture.path, outSource.directory, isLoadedAsSRGB(texture.type))) continue;
+			outSource.textureImages[texture.path] = decodeTextureFile(texture.path.c_str(), outSource.directory);
+		}
+	}
+	return true;
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+bool Model::isCacheUpToDate(const std::string& path)
 {
-	std::cout << "Processing mesh: '" << mesh->mName.C_Str() << "'" << std::endl;
-
-	std::vector<ModelVertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+	MappedFile file;
+	return openCache(file, path + MODEL_CACHE_EXTENSION, path);
+}
 
-	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+void Model::upload(ModelSource& source)
+{
+	this->_meshes.reserve(source.meshes.size());
+	for (const ModelMeshSource& mesh : source.meshes)
 	{
-		ModelVertex vertex = {
-			{
-				.position = MathConversionUtil::convert(mesh->mVertices[i]),
-			   .normal = MathConversionUtil::convert(mesh->mNormals[i])
-			},
-			{ -1, -1, -1, -1 },
-			{0.0f, 0.0f, 0.0f, 0.0f },
-			MathConversionUtil::convert(mesh->mTangents[i]),
-			MathConversionUtil::convert(mesh->mBitangents[i])
-		};
-
-		// does the mesh contain texture coordinates?
-		vertex.texCoords = mesh->mTextureCoords[0] ? MathConversionUtil::convert(mesh->mTextureCoords[0][i]) : glm::vec2(0.0f, 0.0f);
-
-
-		// process vertex positions, normals and texture coordinates
-		vertices.push_back(vertex);
+		std::vector<Texture> textures;
+		for (const ModelTextureReference& texture : mesh.textures)
+			textures.push_back(this->loadMaterialTexture(texture.type, texture.path, source.textureImages[texture.path]));
+		this->_meshes.emplace_back(mesh.vertexData, mesh.vertexCount, mesh.indexData, mesh.indexCount, std::move(textures));
 	}
+}
 
-	//process indices
-	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+void Model::cookCache(const std::string& path)
+{
+	const std::string cachePath = path + MODEL_CACHE_EXTENSION;
+	ModelSource source;
+	source.directory = path.substr(0, path.find_last_of('/'));
+	if (!readCache(cachePath, path, source))
 	{
-		aiFace face = mesh->mFaces[i];
-		for (unsigned int j = 0; j < face.mNumIndices; j++)
-		{
-			indices.push_back(face.mIndices[j]);
-		}
+		std::cout << "Cooking model: '" << path << "'" << std::endl;
+		if (!importModel(path, nullptr, source)) return;
+		writeCache(cachePath, path, source);
 	}
 
-	// process material
-	if (mesh->mMaterialIndex >= 0)
+	// and its textures (each file once)
+	std::set<std::string> cooked;
+	for (const ModelMeshSource& mesh : source.meshes)
 	{
-		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-		std::vector<Texture> diffuseMaps = this->loadMaterialTextures(material, aiTextureType_DIFFUSE, Mesh::TEXTURE_DIFFUSE);
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-
-		std::vector<Texture> specularMaps = this->loadMaterialTextures(material, aiTextureType_SPECULAR, Mesh::TEXTURE_SPECULAR);
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-
-		std::vector<Texture> normalMaps = this->loadMaterialTextures(material, aiTextureType_NORMALS, Mesh::TEXTURE_NORMAL); // TODO: need to check if "aiTextureType_NORMALS" is OK or if we have to use "aiTextureType_HEIGHT"
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+		for (const ModelTextureReference& texture : mesh.textures)
+		{
+			if (!cooked.insert(texture.path).second) continue;
+			cookTexture(texture.path, source.directory, texture.type == Mesh::TEXTURE_NORMAL);
+		}
 	}
+}
 
-
-	// process bones
-	if (mesh->HasBones())
+void Model::draw(Shader& shader, const std::vector<unsigned int>* vertexArrays)
+{
+	for (unsigned int i = 0; i < this->_meshes.size(); i++)
 	{
-		this->processBones(mesh, vertices);
+		if (vertexArrays != nullptr) this->_meshes[i].draw(shader, (*vertexArrays)[i]);
+		else this->_meshes[i].draw(shader);
 	}
+}
 
-	return Mesh(vertices, indices, textures);
+const std::vector<Mesh>& Model::getMeshes() const
+{
+	return this->_meshes;
 }
 
 std::map<std::string, BoneInfo>& Model::getBoneInfoMap()
@@ -142,7 +153,59 @@ void Model::setBoneCount(int count)
 	this->_boneCounter = count;
 }
 
-void Model::processBones(aiMesh* mesh, std::vector<ModelVertex>& vertices)
+const AssimpNodeHierarchy& Model::getSkeleton() const
+{
+	return this->_skeleton;
+}
+
+glm::vec3 Model::getLocalBoundsMin() const
+{
+	return this->_boundsMin;
+}
+
+glm::vec3 Model::getLocalBoundsMax() const
+{
+	return this->_boundsMax;
+}
+
+void Model::takeSkeletonData(ModelSource& source)
+{
+	this->_directory = source.directory;
+	this->_boneInfoMap = std::move(source.boneInfoMap);
+	this->_boneCounter = source.boneCount;
+	this->_skeleton = std::move(source.skeleton);
+	this->_boundsMin = source.boundsMin;
+	this->_boundsMax = source.boundsMax;
+}
+
+Texture Model::loadMaterialTexture(const std::string& type, const std::string& path, const DecodedTexture& image)
+{
+	// (only uploaded if no other model, terrain, ... has it on the GPU already)
+	return {
+		.id = TextureCache::getShared().acquire(path, this->_directory, isLoadedAsSRGB(type), &image),
+		.type = type,
+		.path = path
+	};
+}
+
+#pragma region IMPORT
+
+static void setVertexBoneData(ModelVertex& data, int boneId, float weight)
+{
+	for (int i = 0; i < MAX_NUM_BONES_PER_VERTEX; ++i)
+	{
+		if (data.boneIds[i] < 0)
+		{
+			data.weights[i] = weight;
+			data.boneIds[i] = boneId;
+			return;
+		}
+	}
+	//std::cout << "Extra influence by bone " << boneId << std::endl;
+	//throw std::exception("Tried setting a fourth influencing bone for a vertex!");
+}
+
+static void processBones(aiMesh* mesh, std::vector<ModelVertex>& vertices, ModelSource& source)
 {
 	std::cout << "Processing " << mesh->mNumBones << " bones" << std::endl;
 	for (unsigned int i = 0; i < mesh->mNumBones; i++)
@@ -153,21 +216,21 @@ void Model::processBones(aiMesh* mesh, std::vector<ModelVertex>& vertices)
 		std::cout << "Processing bone: '" << boneName << "'" << std::endl;
 
 		// store mapping info (bone name (string) to bone data [id + transformation matrix to go from local to bone space for a vertex]
-		if (!this->_boneInfoMap.contains(boneName))
+		if (!source.boneInfoMap.contains(boneName))
 		{
 			// consider this a new bone
-			boneId = this->_boneCounter;
-			this->_boneInfoMap[boneName] = {
-				.id = this->_boneCounter,
+			boneId = source.boneCount;
+			source.boneInfoMap[boneName] = {
+				.id = source.boneCount,
 				.offset = MathConversionUtil::convert(bone->mOffsetMatrix)
 			};
 
-			this->_boneCounter++;
+			source.boneCount++;
 		}
 		else
 		{
 			// reuse bone (already processed before)
-			boneId = this->_boneInfoMap[boneName].id;
+			boneId = source.boneInfoMap[boneName].id;
 		}
 		assert(boneId != -1);
 
@@ -185,50 +248,439 @@ void Model::processBones(aiMesh* mesh, std::vector<ModelVertex>& vertices)
 	}
 }
 
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName)
+static void collectMaterialTextures(aiMaterial* mat, aiTextureType type, const std::string& typeName, std::vector<ModelTextureReference>& outTextures)
 {
-	std::vector<Texture> textures;
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 	{
 		aiString str;
 		mat->GetTexture(type, i, &str);
-		bool skip = false;
+		outTextures.push_back({ .type = typeName, .path = str.C_Str() });
+	}
+}
 
-		for (unsigned int j = 0; j < this->_loadedTextures.size(); j++)
-		{
-			if (std::strcmp(this->_loadedTextures[j].path.data(), str.C_Str()) == 0)
+static ModelMeshSource processMesh(aiMesh* mesh, const aiScene* scene, ModelSource& source)
+{
+	std::cout << "Processing mesh: '" << mesh->mName.C_Str() << "'" << std::endl;
+
+	ModelMeshSource result;
+	std::vector<ModelVertex>& vertices = result.vertices;
+	std::vector<unsigned int>& indices = result.indices;
+	vertices.reserve(mesh->mNumVertices);
+
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	{
+		ModelVertex vertex = {
 			{
-				textures.push_back(this->_loadedTextures[j]); // loaded already
-				skip = true;
-				break;
-			}
-		}
+				.position = MathConversionUtil::convert(mesh->mVertices[i]),
+			   .normal = MathConversionUtil::convert(mesh->mNormals[i])
+			},
+			{ -1, -1, -1, -1 },
+			{0.0f, 0.0f, 0.0f, 0.0f },
+			MathConversionUtil::convert(mesh->mTangents[i]),
+			MathConversionUtil::convert(mesh->mBitangents[i])
+		};
 
-		if (!skip)
+		// does the mesh contain texture coordinates?
+		vertex.texCoords = mesh->mTextureCoords[0] ? MathConversionUtil::convert(mesh->mTextureCoords[0][i]) : glm::vec2(0.0f, 0.0f);
+
+
+		// process vertex positions, normals and texture coordinates
+		vertices.push_back(vertex);
+
+		source.boundsMin = glm::min(source.boundsMin, vertex.position);
+		source.boundsMax = glm::max(source.boundsMax, vertex.position);
+	}
+
+	//process indices
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	{
+		aiFace face = mesh->mFaces[i];
+		for (unsigned int j = 0; j < face.mNumIndices; j++)
 		{
-			// if texture hasn't been loaded already, load it
-			Texture texture = {
-			.id = loadTextureFromFile(str.C_Str(), this->_directory, std::nullopt, USE_SRGB_COLORS && typeName != Mesh::TEXTURE_NORMAL),
-			.type = typeName,
-			.path = str.C_Str()
-			};
-			textures.push_back(texture);
+			indices.push_back(face.mIndices[j]);
 		}
 	}
-	return textures;
+
+	// process material (only the references, the textures themselves are loaded when the model is created)
+	if (mesh->mMaterialIndex >= 0)
+	{
+		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+		collectMaterialTextures(material, aiTextureType_DIFFUSE, Mesh::TEXTURE_DIFFUSE, result.textures);
+		collectMaterialTextures(material, aiTextureType_SPECULAR, Mesh::TEXTURE_SPECULAR, result.textures);
+		collectMaterialTextures(material, aiTextureType_NORMALS, Mesh::TEXTURE_NORMAL, result.textures); // TODO: need to check if "aiTextureType_NORMALS" is OK or if we have to use "aiTextureType_HEIGHT"
+	}
+
+
+	// process bones
+	if (mesh->HasBones())
+	{
+		processBones(mesh, vertices, source);
+	}
+
+	return result;
 }
 
-void Model::setVertexBoneData(ModelVertex& data, int boneId, float weight)
+static void processNode(aiNode* node, const aiScene* scene, ModelSource& source)
 {
-	for (int i = 0; i < MAX_NUM_BONES_PER_VERTEX; ++i)
+	// process all node's meshes (if any)
+	for (unsigned int i = 0; i < node->mNumMeshes; i++)
 	{
-		if (data.boneIds[i] < 0)
+		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+		source.meshes.push_back(processMesh(mesh, scene, source)); // this technically flattens the hierarchical relation that was
+		// defined by the model's creator which may disallow hierarchical operations (e.g. move all members of a subsection of the hierarchy tree
+	}
+	// then do the same for each of its children
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+	{
+		processNode(node->mChildren[i], scene, source);
+	}
+}
+
+/**
+ * Depth first, so a node is always added before any of its children (same as AnimationSet::readHierarchyData())
+ */
+static void readSkeleton(const aiNode* node, int parentIndex, AssimpNodeHierarchy& skeleton)
+{
+	const int index = skeleton.getNodeCount();
+	skeleton.parents.push_back(parentIndex);
+	skeleton.transformations.push_back(MathConversionUtil::convert(node->mTransformation));
+	skeleton.names.emplace_back(node->mName.data);
+
+	for (unsigned int i = 0; i < node->mNumChildren; ++i)
+		readSkeleton(node->mChildren[i], index, skeleton);
+}
+
+const aiScene* Model::importScene(Assimp::Importer& importer, const std::string& path)
+{
+	std::cout << "Loading model: '" << path << "'" << std::endl;
+	const aiScene* scene = importer.ReadFile(path,
+		aiProcess_Triangulate // if the model does not (entirely) consist of triangles, it should transform all the model's primitive shapes to triangles first
+		| aiProcess_FlipUVs // flips the texture coordinates on the y-axis where necessary during processing
+		| aiProcess_GenNormals
+		| aiProcess_CalcTangentSpace
+		// (none of these touch the node tree or the animations)
+		// more interesting options available: https://learnopengl.com/Model-Loading/Model
+		// https://assimp.sourceforge.net/lib_html/postprocess_8h.html
+	);
+
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	{
+		std::cout << "Error::ASSIMP::" << importer.GetErrorString() << std::endl;
+		return nullptr;
+	}
+	return scene;
+}
+
+/**
+ * \param scene		imports the file itself if nullptr
+ */
+static bool importModel(const std::string& path, const aiScene* scene, ModelSource& outSource)
+{
+	Assimp::Importer importer;
+	if (scene == nullptr) scene = Model::importScene(importer, path);
+	if (scene == nullptr) return false;
+
+	processNode(scene->mRootNode, scene, outSource);
+	readSkeleton(scene->mRootNode, -1, outSource.skeleton);
+
+	for (ModelMeshSource& mesh : outSource.meshes)
+	{
+		mesh.vertexData = mesh.vertices.data();
+		mesh.vertexCount = mesh.vertices.size();
+		mesh.indexData = mesh.indices.data();
+		mesh.indexCount = mesh.indices.size();
+	}
+	return true;
+}
+
+#pragma endregion
+
+#pragma region CACHE
+
+/**
+ * Layout of the cooked cache file:
+ *	- ModelCacheHeader
+ *	- meshCount ModelCacheMesh
+ *	- textureCount ModelCacheTexture
+ *	- boneInfoCount ModelCacheBone
+ *	- nodeCount ModelCacheNode
+ *	- vertexCount ModelVertex (all meshes one after the other)
+ *	- indexCount unsigned int (^)
+ *	- stringsSize chars (all names and paths, not null terminated)
+ *
+ * Everything is stored exactly the way it's laid out in memory (so it only works on the same platform/compiler it was written with,
+ * which is fine for a local cache). Any change to the import of the model or to these structs must bump MODEL_CACHE_VERSION.
+ */
+struct ModelCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t vertexSize;
+	int32_t boneCount;
+	uint64_t sourceFileSize;
+	int64_t sourceWriteTime;
+	uint64_t meshCount;
+	uint64_t textureCount;
+	uint64_t boneInfoCount;
+	uint64_t nodeCount;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t stringsSize;
+	float boundsMin[3];
+	float boundsMax[3];
+};
+
+struct ModelCacheString
+{
+	uint32_t offset; // in the strings at the end of the file
+	uint32_t length;
+};
+
+struct ModelCacheMesh
+{
+	uint64_t firstVertex;
+	uint64_t vertexCount;
+	uint64_t firstIndex;
+	uint64_t indexCount;
+	uint32_t firstTexture;
+	uint32_t textureCount;
+};
+
+struct ModelCacheTexture
+{
+	ModelCacheString type;
+	ModelCacheString path;
+};
+
+struct ModelCacheBone
+{
+	ModelCacheString name;
+	int32_t id;
+	glm::mat4 offset;
+};
+
+struct ModelCacheNode
+{
+	ModelCacheString name;
+	int32_t parent;
+	glm::mat4 transformation;
+};
+
+static ModelCacheHeader makeCacheKey(const std::string& sourcePath)
+{
+	ModelCacheHeader key = {};
+	memcpy(key.magic, MODEL_CACHE_MAGIC, sizeof(key.magic));
+	key.version = MODEL_CACHE_VERSION;
+	key.vertexSize = sizeof(ModelVertex);
+	key.sourceFileSize = std::filesystem::file_size(sourcePath);
+	key.sourceWriteTime = std::filesystem::last_write_time(sourcePath).time_since_epoch().count();
+	return key;
+}
+
+static size_t getCacheFileSize(const ModelCacheHeader& header)
+{
+	return sizeof(ModelCacheHeader)
+		+ header.meshCount * sizeof(ModelCacheMesh)
+		+ header.textureCount * sizeof(ModelCacheTexture)
+		+ header.boneInfoCount * sizeof(ModelCacheBone)
+		+ header.nodeCount * sizeof(ModelCacheNode)
+		+ header.vertexCount * sizeof(ModelVertex)
+		+ header.indexCount * sizeof(unsigned int)
+		+ header.stringsSize;
+}
+
+/**
+ * Maps the cache and checks it against the source file. False (and nothing mapped) if it's missing or stale
+ */
+static bool openCache(MappedFile& file, const std::string& cachePath, const std::string& sourcePath)
+{
+	if (!std::filesystem::exists(sourcePath) || !file.open(cachePath)) return false;
+	if (file.getSize() < sizeof(ModelCacheHeader))
+	{
+		file.close();
+		return false;
+	}
+
+	ModelCacheHeader header;
+	memcpy(&header, file.getData(), sizeof(ModelCacheHeader));
+	const ModelCacheHeader expected = makeCacheKey(sourcePath);
+
+	const bool isUpToDate = memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+		&& header.version == expected.version
+		&& header.vertexSize == expected.vertexSize
+		&& header.sourceFileSize == expected.sourceFileSize
+		&& header.sourceWriteTime == expected.sourceWriteTime
+		&& file.getSize() == getCacheFileSize(header);
+	if (!isUpToDate)
+	{
+		file.close();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Leaves outSource untouched if the cache can't be used. Otherwise the meshes point into the mapping (outSource.cacheFile),
+ * which is only needed until everything is on the GPU
+ */
+static bool readCache(const std::string& cachePath, const std::string& sourcePath, ModelSource& outSource)
+{
+	MappedFile& file = outSource.cacheFile;
+	if (!openCache(file, cachePath, sourcePath)) return false;
+
+	ModelCacheHeader header;
+	memcpy(&header, file.getData(), sizeof(ModelCacheHeader));
+
+	const unsigned char* cursor = file.getData() + sizeof(ModelCacheHeader);
+	auto readRecords = [&cursor]<typename T>(std::vector<T>& records, uint64_t count)
+	{
+		records.resize(count);
+		memcpy(records.data(), cursor, count * sizeof(T));
+		cursor += count * sizeof(T);
+	};
+	std::vector<ModelCacheMesh> meshes;
+	std::vector<ModelCacheTexture> textures;
+	std::vector<ModelCacheBone> bones;
+	std::vector<ModelCacheNode> nodes;
+	readRecords(meshes, header.meshCount);
+	readRecords(textures, header.textureCount);
+	readRecords(bones, header.boneInfoCount);
+	readRecords(nodes, header.nodeCount);
+
+	// the vertices and indices go to the GPU straight from the mapped file
+	const ModelVertex* vertices = reinterpret_cast<const ModelVertex*>(cursor);
+	cursor += header.vertexCount * sizeof(ModelVertex);
+	const unsigned int* indices = reinterpret_cast<const unsigned int*>(cursor);
+	cursor += header.indexCount * sizeof(unsigned int);
+	const char* strings = reinterpret_cast<const char*>(cursor);
+
+	// everything is checked before anything is created, a damaged cache is just treated as a stale one
+	auto isValid = [&header](const ModelCacheString& string) { return (uint64_t)string.offset + string.length <= header.stringsSize; };
+	bool isDamaged = false;
+	for (const ModelCacheMesh& mesh : meshes)
+	{
+		isDamaged |= mesh.firstVertex + mesh.vertexCount > header.vertexCount || mesh.firstIndex + mesh.indexCount > header.indexCount
+			|| (uint64_t)mesh.firstTexture + mesh.textureCount > header.textureCount;
+	}
+	for (const ModelCacheTexture& texture : textures)
+		isDamaged |= !isValid(texture.type) || !isValid(texture.path);
+	for (const ModelCacheBone& bone : bones)
+		isDamaged |= !isValid(bone.name) || bone.id < 0 || bone.id >= header.boneCount;
+	// the hierarchy is walked forward (parents before their children), and the bone ids index the bone matrices
+	for (uint64_t node = 0; node < header.nodeCount; ++node)
+		isDamaged |= !isValid(nodes[node].name) || nodes[node].parent < -1 || (int64_t)nodes[node].parent >= (int64_t)node;
+	for (uint64_t vertex = 0; vertex < header.vertexCount && !isDamaged; ++vertex)
+	{
+		for (const int boneId : vertices[vertex].boneIds)
+			isDamaged |= boneId < -1 || boneId >= header.boneCount;
+	}
+	if (isDamaged)
+	{
+		file.close();
+		return false;
+	}
+
+	auto readString = [strings](const ModelCacheString& string) { return std::string(strings + string.offset, string.length); };
+
+	outSource.meshes.resize(meshes.size());
+	for (size_t m = 0; m < meshes.size(); ++m)
+	{
+		const ModelCacheMesh& mesh = meshes[m];
+		ModelMeshSource& meshSource = outSource.meshes[m];
+		for (uint32_t i = mesh.firstTexture; i < mesh.firstTexture + mesh.textureCount; ++i)
+			meshSource.textures.push_back({ .type = readString(textures[i].type), .path = readString(textures[i].path) });
+		meshSource.vertexData = vertices + mesh.firstVertex;
+		meshSource.vertexCount = (size_t)mesh.vertexCount;
+		meshSource.indexData = indices + mesh.firstIndex;
+		meshSource.indexCount = (size_t)mesh.indexCount;
+	}
+
+	for (const ModelCacheBone& bone : bones)
+		outSource.boneInfoMap[readString(bone.name)] = { .id = bone.id, .offset = bone.offset };
+	outSource.boneCount = header.boneCount;
+
+	for (const ModelCacheNode& node : nodes)
+	{
+		outSource.skeleton.parents.push_back(node.parent);
+		outSource.skeleton.transformations.push_back(node.transformation);
+		outSource.skeleton.names.push_back(readString(node.name));
+	}
+
+	outSource.boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	outSource.boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+	return true;
+}
+
+static void writeCache(const std::string& cachePath, const std::string& sourcePath, const ModelSource& source)
+{
+	std::string strings;
+	auto addString = [&strings](const std::string& string)
+	{
+		const ModelCacheString stored = { (uint32_t)strings.size(), (uint32_t)string.size() };
+		strings += string;
+		return stored;
+	};
+
+	std::vector<ModelCacheMesh> meshes;
+	std::vector<ModelCacheTexture> textures;
+	uint64_t vertexCount = 0;
+	uint64_t indexCount = 0;
+	for (const ModelMeshSource& mesh : source.meshes)
+	{
+		meshes.push_back({ vertexCount, mesh.vertices.size(), indexCount, mesh.indices.size(), (uint32_t)textures.size(), (uint32_t)mesh.textures.size() });
+		for (const ModelTextureReference& texture : mesh.textures)
+			textures.push_back({ addString(texture.type), addString(texture.path) });
+		vertexCount += mesh.vertices.size();
+		indexCount += mesh.indices.size();
+	}
+
+	std::vector<ModelCacheBone> bones;
+	for (const auto& [name, info] : source.boneInfoMap)
+		bones.push_back({ addString(name), info.id, info.offset });
+
+	std::vector<ModelCacheNode> nodes;
+	for (int node = 0; node < source.skeleton.getNodeCount(); ++node)
+		nodes.push_back({ addString(source.skeleton.names[node]), source.skeleton.parents[node], source.skeleton.transformations[node] });
+
+	ModelCacheHeader header = makeCacheKey(sourcePath);
+	header.boneCount = source.boneCount;
+	header.meshCount = meshes.size();
+	header.textureCount = textures.size();
+	header.boneInfoCount = bones.size();
+	header.nodeCount = nodes.size();
+	header.vertexCount = vertexCount;
+	header.indexCount = indexCount;
+	header.stringsSize = strings.size();
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		header.boundsMin[axis] = source.boundsMin[axis];
+		header.boundsMax[axis] = source.boundsMax[axis];
+	}
+
+	// written to a temporary file first so a cache is never left half-written
+	const std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(meshes.data()), meshes.size() * sizeof(ModelCacheMesh));
+		out.write(reinterpret_cast<const char*>(textures.data()), textures.size() * sizeof(ModelCacheTexture));
+		out.write(reinterpret_cast<const char*>(bones.data()), bones.size() * sizeof(ModelCacheBone));
+		out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(ModelCacheNode));
+		for (const ModelMeshSource& mesh : source.meshes)
+			out.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(ModelVertex));
+		for (const ModelMeshSource& mesh : source.meshes)
+			out.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+		out.write(strings.data(), strings.size());
+		if (!out)
 		{
-			data.weights[i] = weight;
-			data.boneIds[i] = boneId;
+			std::cout << "Could not write model cache: '" << cachePath << "'" << std::endl; // not fatal, just slower next time
 			return;
 		}
 	}
-	//std::cout << "Extra influence by bone " << boneId << std::endl;
-	//throw std::exception("Tried setting a fourth influencing bone for a vertex!");
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error) std::cout << "Could not write model cache: '" << cachePath << "' (" << error.message() << ")" << std::endl;
 }
+
+#pragma endregion
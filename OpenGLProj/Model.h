@@ -1,23 +1,128 @@
 #ifndef MODEL_MINE_H
 #define MODEL_MINE_H
+#include <cfloat>
+#include <map>
+#include <string>
+
+#include "AssimpNode.h"
+#include "FileUtils.h"
+#include "MappedFile.h"
 #include "Mesh.h"
 #include "Shader.h"
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
+struct aiScene;
+namespace Assimp { class Importer; }
+
+struct ModelTextureReference
+{
+	std::string type; // Mesh::TEXTURE_...
+	std::string path; // relative to the model's directory
+};
+
+struct ModelMeshSource
+{
+	// only filled by an import (see vertexData)
+	std::vector<ModelVertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<ModelTextureReference> textures;
+
+	// what gets uploaded: points into either the vectors above or the mapped cache file
+	const ModelVertex* vertexData = nullptr;
+	size_t vertexCount = 0;
+	const unsigned int* indexData = nullptr;
+	size_t indexCount = 0;
+};
+
+/**
+ * \brief Everything a Model is made of, before anything is uploaded (what gets cooked, plus the decoded material textures).
+ * Filled by Model::prepare().
+ */
+struct ModelSource
+{
+	std::string directory;
+	std::vector<ModelMeshSource> meshes;
+	std::map<std::string, BoneInfo> boneInfoMap;
+	int boneCount = 0;
+	AssimpNodeHierarchy skeleton;
+	glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+	glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+
+	MappedFile cacheFile; // the meshes point into this when they were read from the cache
+	std::map<std::string, DecodedTexture> textureImages; // by path (see ModelTextureReference)
+};
 
 /**
  * \brief A 3D model container. Contains one or more Meshes.
+ *
+ * The source file (FBX, ...) is only imported (with Assimp) when its cooked cache is missing or stale: the finished vertices,
+ * indices, texture references, bones and skeleton are stored in a binary file right next to it, which is memory mapped on
+ * the next launch and uploaded to the GPU straight from the mapping (see cookCache()).
+ *
+ * Loading is split in a CPU half (prepare(), any thread) and a GL half (upload()), so the first can run on a worker (see AssetRegistry).
  */
 class Model
 {
 public:
-	Model(const char* path);
+	/**
+	 * \brief Loads the whole model right away (prepare() + upload()), on the thread with the OpenGL context. Throws if the file could not be read
+	 *
+	 * \param scene		optional, the file already imported with importScene() (see AssetRegistry). Only used if the cache is stale
+	 */
+	Model(const char* path, const aiScene* scene = nullptr);
+
+	/**
+	 * \brief Takes over the bones, skeleton and bounds of a prepared model, without any OpenGL calls (so an AnimationSet can
+	 * already be built for it on the same worker). There is nothing to draw until upload() is called with the same source.
+	 */
+	explicit Model(ModelSource& source);
+
+	/**
+	 * \brief Releases its textures (see TextureCache)
+	 */
+	~Model();
+
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+
+	/**
+	 * \brief CPU half of loading: reads the cache (or imports the file and writes the cache) and decodes the material textures.
+	 * Makes no OpenGL calls, so it can run on any thread.
+	 *
+	 * \param scene		same as for the constructor
+	 * \return false (and logged) if the file could not be read
+	 */
+	static bool prepare(const std::string& path, const aiScene* scene, ModelSource& outSource);
+
+	/**
+	 * \brief Whether prepare() can read the model from its cooked cache, i.e. without any import (as far as the header can tell)
+	 */
+	static bool isCacheUpToDate(const std::string& path);
+
+	/**
+	 * \brief GL half of loading: creates the meshes and textures from the source. The source can go away afterwards.
+	 */
+	void upload(ModelSource& source);
+
+	/**
+	 * \brief Reads the file with everything a Model needs from it (which covers the animations in it as well).
+	 * The scene lives as long as the importer. nullptr (and logged) if the file could not be read.
+	 */
+	static const aiScene* importScene(Assimp::Importer& importer, const std::string& path);
+
+	/**
+	 * \brief Offline "cook" step: makes sure the cooked cache of this model, and the block compressed versions of its textures
+	 * (see cookTexture()), are up to date (without needing an OpenGL context)
+	 */
+	static void cookCache(const std::string& path);
 
 	/**
 	 * \brief Draw the model with the given shader
+	 *
+	 * \param vertexArrays		optional, one per mesh to draw it with instead of its own vertices (see SkinningPass)
 	 */
-	void draw(Shader& shader);
+	void draw(Shader& shader, const std::vector<unsigned int>* vertexArrays = nullptr);
+
+	const std::vector<Mesh>& getMeshes() const;
 
 	std::map<std::string, BoneInfo>& getBoneInfoMap();
 
@@ -25,23 +130,31 @@ public:
 
 	void setBoneCount(int count);
 
+	/**
+	 * \brief Node tree of the file (parents, local bind transformations and names only)
+	 */
+	const AssimpNodeHierarchy& getSkeleton() const;
+
+	/**
+	 * \brief Axis aligned bounds of all the vertices of the model (model space, bind pose)
+	 */
+	glm::vec3 getLocalBoundsMin() const;
+	glm::vec3 getLocalBoundsMax() const;
+
 private:
-	std::vector<Texture> _loadedTextures;
 	// model data
 	std::vector<Mesh> _meshes;
 	std::string _directory; // store the directory of the file path that we'll later need when loading textures
 	// model animation data
 	std::map<std::string, BoneInfo> _boneInfoMap;
 	int _boneCounter = 0;
+	AssimpNodeHierarchy _skeleton;
+	// bounds
+	glm::vec3 _boundsMin = glm::vec3(FLT_MAX);
+	glm::vec3 _boundsMax = glm::vec3(-FLT_MAX);
 
-	void loadModel(std::string path);
-	void processNode(aiNode* node, const aiScene* scene);
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-	void processBones(aiMesh* mesh, std::vector<ModelVertex>& vertices);
-	std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
-
-	static void setVertexBoneData(ModelVertex& data, int boneId, float weight);
-
+	void takeSkeletonData(ModelSource& source);
+	Texture loadMaterialTexture(const std::string& type, const std::string& path, const DecodedTexture& image);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -27,7 +27,6 @@ constexpr auto A_LONG_TIME = 999999.0f; // TODO: <- remove this large number as
 const std::string WALKING_ANIM = "walking";
 const std::string RUNNING_ANIM_1 = "running1";
 const std::string RUNNING_ANIM_2 = "running2";
-const std::string RUNNING_LOOK_BEHIND_ANIM = "runninglookbehind";
 const std::string RUNNING_FALL_FLAT_ANIM = "fallflat";
 const std::string CRAWLING_ANIM = "crawling";
 const std::string GETTING_UP_ANIM = "gettingup";
@@ -42,6 +41,8 @@ const std::string IDLE_LOOKAROUND_ANIM = "idlelookaround1";
 const std::string SPOOKED_ANIM = "spooked";
 const std::string CRAWLING_OFFSET_FORWARDS_ANIM = "crawling2";
 
+const std::string UPPER_BODY_ROOT_NODE = "mixamorig:Spine1"; // for animations that only play on the upper body (see playMaskedAnimation())
+
 const std::vector<std::string> IDLE_ANIMS = {
 	IDLE1_ANIM,
 	IDLE_LOOKAROUND_ANIM,
@@ -166,7 +167,8 @@ NomadCharacter::NomadCharacter(
 	_terrain(terrain),
 	_sound(sound),
 	_dialogueManager(dialogueManager),
-	_model(nomadGameObject)
+	_model(nomadGameObject),
+	_upperBodyMask(animations->createBoneMask(UPPER_BODY_ROOT_NODE))
 {}
 
 void NomadCharacter::onNewFrame()
@@ -180,6 +182,7 @@ void NomadCharacter::onNewFrame()
 	if (this->_tmp_nextBehaviourChoiceOverride > -1.0f && currentTime >= this->_tmp_nextBehaviourChoiceOverride)
 	{
 		// TODO: temporary. remove. Not sure if we even need anything like this later down the line...
+		this->stopMaskedAnimation();
 		this->playAnimationWithTransition(RUNNING_ANIM_2);
 		this->_currentMovementSound = this->_sound->playTracked3D(NOMAD_SAND_RUNNING_TRACK, true, currentPos);
 		this->_tmp_nextBehaviourChoiceOverride = -1.0f;
@@ -270,7 +273,8 @@ void NomadCharacter::reactToSandworm()
 
 void NomadCharacter::playLookBackAnimWhileRunning()
 {
-	this->playAnimationWithTransition(RUNNING_LOOK_BEHIND_ANIM);
+	// looks back with the upper body only, the legs keep running
+	this->playMaskedAnimation(LOOK_BEHIND_RIGHT_ANIM, &this->_upperBodyMask);
 	this->_currentMovementSound = this->_sound->playTracked3D(NOMAD_SAND_WALKING_TRACK, true, this->getCurrentPosition());
 	this->_tmp_nextBehaviourChoiceOverride = this->getTime()->getCurrentTime() + 2.0f;
 }
@@ -113,6 +113,7 @@ private:
 	UICharacterDialogueDisplayManager* _dialogueManager;
 
 	SphericalBoxedGameObject* _model;
+	const BoneMask _upperBodyMask;
 
 	MOVEMENT_STATE _movementState = MOVEMENT_STATE::IDLE;
 
@@ -12,6 +12,14 @@ const std::string FLYING_ANIM = "flying";
 
 const float ORNITHOPTER_MODEL_SCALE = 3.0f;
 
+// mostly seen from kilometers away, but the spinning blades get choppy quickly when the rate drops
+const AnimationLodSettings ORNITHOPTER_ANIMATION_LOD = {
+	.reducedRateScreenSize = 0.1f,
+	.reducedRateInterval = 2,
+	.lowRateScreenSize = 0.01f,
+	.lowRateInterval = 3
+};
+
 
 OrnithopterCharacter::OrnithopterCharacter(const WorldTimeManager* time, SoundManager* sound, RenderableGameObject* ornithropterObject, AnimationSet* animations):
 _time(time),
@@ -20,6 +28,7 @@ _model(ornithropterObject),
 _animator(animations)
 {
 	this->_animator.playAnimation(FLYING_ANIM);
+	this->_animator.setLodSettings(ORNITHOPTER_ANIMATION_LOD);
 
 	this->_currentSound = AudioPlayer(this->_sound->playTracked3D(ORNITHOPTER_TRACK, true, glm::vec3(1000, 300, 1000)));
 	this->_currentSound.setMinimumDistance(ORNITHOPTER_SOUND_MIN_DISTANCE);
@@ -46,9 +55,20 @@ void OrnithopterCharacter::onNewFrame()
 
 void OrnithopterCharacter::draw(Shader& shader)
 {
-	const std::vector<glm::mat4> transforms = this->_animator.getFinalBoneMatrices();
-	this->setupEntityShaderForAnim(shader, transforms);
+	this->drawAnimatedModel(shader);
+}
+
+bool OrnithopterCharacter::isVisible(const ViewFrustum& frustum)
+{
+	return this->_model->isVisible(frustum, ANIMATED_BOUNDS_SCALE);
+}
 
-	this->_model->draw(shader);
-	this->clearEntityShaderForAnim(shader);
+RenderableGameObject* OrnithopterCharacter::getAnimatedModel()
+{
+	return this->_model;
+}
+
+Animator& OrnithopterCharacter::getAnimator()
+{
+	return this->_animator;
 }
@@ -15,6 +15,9 @@ public:
 
 	void onNewFrame() override;
 	void draw(Shader& shader) override;
+	bool isVisible(const ViewFrustum& frustum) override;
+	Animator& getAnimator() override;
+	RenderableGameObject* getAnimatedModel() override;
 
 private:
 	const WorldTimeManager* _time;
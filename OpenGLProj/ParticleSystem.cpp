@@ -1,5 +1,6 @@
 ﻿#include "ParticleSystem.h"
 
+#include <cfloat>
 #include <iostream>
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/mat4x4.hpp>
@@ -8,6 +9,7 @@
 #include "ConfigConstants.h"
 #include "ErrorUtils.h"
 #include "FileUtils.h"
+#include "TextureCache.h"
 #include "WorldMathUtils.h"
 
 
@@ -37,8 +39,8 @@ _particleLifetime(particleLifetime),
 _centerPosition(particlesCenter),
 _particleSize(particleSize)
 {
-	// particle texture
-	this->_textureId = loadSRGBColorSpaceTexture(particleTexturePath.c_str(), PROJ_CURRENT_DIR, GL_TEXTURE0);
+	// particle texture (every particle system with the same texture shares it, see TextureCache)
+	this->_textureId = TextureCache::getShared().acquire(particleTexturePath, PROJ_CURRENT_DIR, USE_SRGB_COLORS);
 	
 	for (unsigned int i = 0; i < this->_nrParticles; ++i)
 	{
@@ -46,6 +48,11 @@ _particleSize(particleSize)
 	}
 }
 
+ParticleSystem::~ParticleSystem()
+{
+	TextureCache::getShared().release(this->_textureId);
+}
+
 void ParticleSystem::onNewFrame()
 {
 	const float deltaTime = this->_time->getDeltaTime();
@@ -61,6 +68,9 @@ void ParticleSystem::onNewFrame()
 	}
 	
 	// update all particles
+	this->_hasAliveParticles = false;
+	this->_aliveBoundsMin = glm::vec3(FLT_MAX);
+	this->_aliveBoundsMax = glm::vec3(-FLT_MAX);
 	for (unsigned int i = 0; i < this->_nrParticles; ++i)
 	{
 		Particle& p = this->_particles[i];
@@ -69,10 +79,23 @@ void ParticleSystem::onNewFrame()
 		if (p.life > 0.0f) // particle is alive, thus update it:
 		{
 			this->updateAliveParticle(p, deltaTime);
+
+			this->_hasAliveParticles = true;
+			this->_aliveBoundsMin = glm::min(this->_aliveBoundsMin, p.position);
+			this->_aliveBoundsMax = glm::max(this->_aliveBoundsMax, p.position);
 		}
 	}
 }
 
+bool ParticleSystem::isVisible(const ViewFrustum& frustum) const
+{
+	if (!this->_hasAliveParticles) return false;
+
+	// the billboards (a [-1, 1] quad scaled by the particle size) stick out of their center by at most their diagonal
+	const glm::vec3 padding = glm::vec3(glm::length(this->_particleSize));
+	return frustum.isBoxVisible(this->_aliveBoundsMin - padding, this->_aliveBoundsMax + padding);
+}
+
 void ParticleSystem::draw(Shader& particleShader, const glm::mat4& view, const glm::vec3& cameraPos)
 {
 	//this->sortParticles(cameraPos);
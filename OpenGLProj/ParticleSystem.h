@@ -7,6 +7,7 @@
 #include "Particle.h"
 #include "Quad.h"
 #include "Shader.h"
+#include "ViewFrustum.h"
 #include "WorldTimeManager.h"
 
 // TODO: Some interesting particles I'd like to do (later):
@@ -20,7 +21,7 @@
 class ParticleSystem : public FrameRequester
 {
 public:
-	virtual ~ParticleSystem() = default;
+	virtual ~ParticleSystem();
 
 	ParticleSystem(
 		WorldTimeManager* time, 
@@ -36,6 +37,11 @@ public:
 
 	virtual void draw(Shader& particleShader, const glm::mat4& view, const glm::vec3& cameraPos);
 
+	/**
+	 * \brief Tests the bounds of all currently alive particles (as of the last onNewFrame()) against the view frustum
+	 */
+	bool isVisible(const ViewFrustum& frustum) const;
+
 	void setCenterPosition(const glm::vec3& position);
 	WorldTimeManager* getTimeManager() const;
 	unsigned int getNumParticles() const;
@@ -94,6 +100,11 @@ private:
 	glm::vec3 _centerPosition;
 	glm::vec2 _particleSize;
 
+	// bounds of the alive particle positions, updated every frame
+	bool _hasAliveParticles = false;
+	glm::vec3 _aliveBoundsMin = glm::vec3(0.0f);
+	glm::vec3 _aliveBoundsMax = glm::vec3(0.0f);
+
 	unsigned int _lastUsedParticle = 0;
 	unsigned int _textureId;
 
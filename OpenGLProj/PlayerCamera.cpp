@@ -70,6 +70,7 @@ void PlayerCamera::processInput(GLFWwindow* window)
 	const float jumpingMultiplier = this->_isJumping ? 0.5 : 1.0f; // decrease amount of (x,z) movement we can do while jumping
 	const float cameraSpeed = this->getDeltaTime() * (this->_speedMultiplierBase * sprintingMultiplier * jumpingMultiplier);
 	bool hasMoved = false;
+	const glm::vec3 posBeforeMoving = this->_cameraPos;
 
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 	{
@@ -102,7 +103,11 @@ void PlayerCamera::processInput(GLFWwindow* window)
 	{
 		// ignore the 'y' we determined above with this "Player" camera,
 		// we have our own "y" that we will get (potentially interpolate) from the height map, using the terrain
-		this->_cameraPos.y = this->_terrain->getWorldHeightAt(this->_cameraPos.x, this->_cameraPos.z) + this->_playerHeight;
+		float worldHeight;
+		if (this->_terrain->tryGetWorldHeightAt(this->_cameraPos.x, this->_cameraPos.z, worldHeight) == TerrainQueryStatus::OK)
+			this->_cameraPos.y = worldHeight + this->_playerHeight;
+		else
+			this->_cameraPos = posBeforeMoving; // edge of the map, don't let the player walk off of it
 
 		if (!this->_isMoving || (this->_lastShiftPressed != isSprinting)) // if we have just started moving or we switched walk->sprint or sprint->walk
 		{
@@ -176,7 +181,8 @@ bool PlayerCamera::isSpeeding() const
 void PlayerCamera::teleportToFloor()
 {
 	auto ourPos = this->getPos();
-	auto worldHeight = this->_terrain->getWorldHeightAt(ourPos.x, ourPos.z);
+	float worldHeight;
+	if (this->_terrain->tryGetWorldHeightAt(ourPos.x, ourPos.z, worldHeight) != TerrainQueryStatus::OK) return;
 	if (fabs((ourPos.y - this->_playerHeight) - worldHeight) > 0.01)
 	{
 		this->_cameraPos.y = worldHeight + this->_playerHeight;
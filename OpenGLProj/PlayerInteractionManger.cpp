@@ -5,6 +5,7 @@
 #include "WorldMathUtils.h"
 
 const glm::vec3 ITEM_PLACEMENT_SMALL_OFFSET_Y = glm::vec3(0.0, 0.1, 0.0);
+constexpr auto ITEM_DROP_MAX_DISTANCE = 6.0f; // how far away the player can place an item by looking at the ground
 bool hasSeenThumper = false; // <- TODO: remove, temporary, for the assignment only.
 
 PlayerInteractionManger::PlayerInteractionManger(
@@ -130,7 +131,13 @@ bool PlayerInteractionManger::handleDropItemInteraction(const glm::vec3& cameraP
 	{
 		// drop the item
 		Thumper* thump = this->_player->removeCarriedItem().getObject();
-		thump->setPosition(this->_terrain->getWorldHeightVecFor(cameraPos.x + (cameraFront.x * 2.5f), cameraPos.z + (cameraFront.z * 2.5f)) + ITEM_PLACEMENT_SMALL_OFFSET_Y);
+
+		// put it where the player is looking if that's close enough, otherwise just on the ground a bit ahead
+		const std::optional<TerrainRayHit> lookedAt = this->_terrain->raycast(cameraPos, cameraFront, ITEM_DROP_MAX_DISTANCE);
+		const glm::vec3 dropPos = lookedAt.has_value()
+			? lookedAt->position
+			: this->_terrain->getWorldHeightVecFor(cameraPos.x + (cameraFront.x * 2.5f), cameraPos.z + (cameraFront.z * 2.5f));
+		thump->setPosition(dropPos + ITEM_PLACEMENT_SMALL_OFFSET_Y);
 		thump->setIsCarried(false);
 
 		this->_worldItemsThatPlayerCanPickUp->insert(thump);
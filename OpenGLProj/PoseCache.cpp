@@ -0,0 +1,51 @@
+#include "PoseCache.h"
+
+float PoseCacheStats::getHitRate() const
+{
+	return this->lookups > 0 ? (float)this->hits / (float)this->lookups : 0.0f;
+}
+
+PoseCache::PoseCache(float timeStep)
+:
+_timeStep(timeStep)
+{}
+
+void PoseCache::beginFrame()
+{
+	this->_entries.clear();
+	this->_frameStats = PoseCacheStats();
+}
+
+int PoseCache::lookup(const PoseKey& key, int animatorIndex)
+{
+	this->_frameStats.lookups++;
+	this->_totalStats.lookups++;
+
+	for (const Entry& entry : this->_entries)
+	{
+		if (entry.key == key)
+		{
+			this->_frameStats.hits++;
+			this->_totalStats.hits++;
+			return entry.owner;
+		}
+	}
+
+	this->_entries.push_back({ key, animatorIndex });
+	return -1;
+}
+
+float PoseCache::getTimeStep() const
+{
+	return this->_timeStep;
+}
+
+const PoseCacheStats& PoseCache::getFrameStats() const
+{
+	return this->_frameStats;
+}
+
+const PoseCacheStats& PoseCache::getTotalStats() const
+{
+	return this->_totalStats;
+}
@@ -0,0 +1,78 @@
+#ifndef POSECACHE_MINE_H
+#define POSECACHE_MINE_H
+#include <vector>
+
+class Animation;
+class AnimationSet;
+
+/**
+ * \brief What a single-animation pose is a function of: the skeleton, the clip and the (quantized) time in it
+ */
+struct PoseKey
+{
+	const AnimationSet* animationSet;
+	const Animation* clip;
+	int step; // time in the clip, in PoseCache::getTimeStep() steps
+
+	bool operator==(const PoseKey& other) const = default;
+};
+
+struct PoseCacheStats
+{
+	unsigned int lookups = 0;
+	unsigned int hits = 0;
+
+	/**
+	 * \brief hits / lookups, 0 if nothing was looked up
+	 */
+	float getHitRate() const;
+};
+
+/**
+ * \brief Lets animators that land on the same PoseKey in a frame share one evaluated pose (see Animator::evaluateAll()).
+ *
+ * Think of instances of the same model in the same state, like the thumpers: the first one with a key computes the pose,
+ * the others copy its bone matrices and share its palette in the BonePaletteBuffer (so they could even be drawn instanced).
+ * Poses that end up shared are sampled at the start of their time step rather than at the exact animation time, which is what makes them line up.
+ * An animator that is alone on its key keeps its exact time.
+ *
+ * Only plain single-animation poses are cached: blended ones, and ones where the animation LOD holds some of the nodes, depend on more than the key.
+ */
+class PoseCache
+{
+public:
+	/**
+	 * \param timeStep		in seconds. Animators whose animation times fall in the same step share a pose
+	 */
+	explicit PoseCache(float timeStep = 1.0f / 60.0f);
+
+	/**
+	 * \brief Forgets the keys of the previous frame
+	 */
+	void beginFrame();
+
+	/**
+	 * \brief Index of the animator that already owns this key this frame, otherwise registers animatorIndex as its owner and returns -1.
+	 * Counts towards the stats.
+	 */
+	int lookup(const PoseKey& key, int animatorIndex);
+
+	float getTimeStep() const;
+
+	const PoseCacheStats& getFrameStats() const;
+	const PoseCacheStats& getTotalStats() const;
+
+private:
+	struct Entry
+	{
+		PoseKey key;
+		int owner;
+	};
+
+	float _timeStep;
+	std::vector<Entry> _entries; // a linear search is plenty for the handful of animators in a scene
+	PoseCacheStats _frameStats;
+	PoseCacheStats _totalStats;
+};
+
+#endif
@@ -1,5 +1,7 @@
 #include "RenderableGameObject.h"
 
+#include <algorithm>
+#include <glm/glm.hpp>
 #include <glm/mat4x4.hpp>
 
 RenderableGameObject::RenderableGameObject(const char* modelFilePath)
@@ -47,7 +49,44 @@ glm::mat3 RenderableGameObject::getNormalMatrix() const
 void RenderableGameObject::draw(Shader& shader)
 {
 	this->fillShaderUnifs(shader);
-	this->_model->draw(shader);
+	this->_model->draw(shader, this->_skinnedVertexArrays);
+}
+
+void RenderableGameObject::setSkinnedVertexArrays(const std::vector<unsigned int>* vertexArrays)
+{
+	this->_skinnedVertexArrays = vertexArrays;
+}
+
+bool RenderableGameObject::isPreSkinned() const
+{
+	return this->_skinnedVertexArrays != nullptr;
+}
+
+bool RenderableGameObject::isVisible(const ViewFrustum& frustum, float boundsScale) const
+{
+	glm::vec3 worldCenter;
+	float worldRadius;
+	if (!this->getWorldBoundingSphere(worldCenter, worldRadius, boundsScale)) return true; // nothing to go off of
+
+	return frustum.isSphereVisible(worldCenter, worldRadius);
+}
+
+bool RenderableGameObject::getWorldBoundingSphere(glm::vec3& outCenter, float& outRadius, float boundsScale) const
+{
+	const glm::vec3 localMin = this->_model->getLocalBoundsMin();
+	const glm::vec3 localMax = this->_model->getLocalBoundsMax();
+	if (localMin.x > localMax.x) return false; // no vertices (model failed to load?)
+
+	// bounding sphere around the local bounds, moved into the world.
+	// The radius scales with the largest axis scaling of the model transform
+	outCenter = glm::vec3(this->_modelTransform * glm::vec4((localMin + localMax) * 0.5f, 1.0f));
+	const float maxScale = std::max({
+		glm::length(glm::vec3(this->_modelTransform[0])),
+		glm::length(glm::vec3(this->_modelTransform[1])),
+		glm::length(glm::vec3(this->_modelTransform[2]))
+	});
+	outRadius = glm::length(localMax - localMin) * 0.5f * maxScale * boundsScale;
+	return true;
 }
 
 void RenderableGameObject::fillShaderUnifs(Shader& shader)
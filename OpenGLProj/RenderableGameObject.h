@@ -7,6 +7,7 @@
 
 #include "Model.h"
 #include "Shader.h"
+#include "ViewFrustum.h"
 
 /**
  * \brief A RenderableGameObject holds world transformation related data for a model (and its meshes)
@@ -37,6 +38,26 @@ public:
 
 	virtual void draw(Shader& shader);
 
+	/**
+	 * \brief Makes draw() use these vertex arrays (one per mesh) instead of the model's own. For animated models that were
+	 * already skinned this frame (see SkinningPass), nullptr to go back to the model's vertices.
+	 */
+	void setSkinnedVertexArrays(const std::vector<unsigned int>* vertexArrays);
+	bool isPreSkinned() const;
+
+	/**
+	 * \brief Tests the bounding sphere of the model (in its current world transform) against the view frustum
+	 *
+	 * \param boundsScale		scales up the bounding sphere, for models that can move outside of their bind pose bounds (animated ones)
+	 */
+	virtual bool isVisible(const ViewFrustum& frustum, float boundsScale = 1.0f) const;
+
+	/**
+	 * \brief Bounding sphere around the local bounds of the model, in its current world transform
+	 * \return false if the model has no bounds to go off of
+	 */
+	bool getWorldBoundingSphere(glm::vec3& outCenter, float& outRadius, float boundsScale = 1.0f) const;
+
 protected:
 	void fillShaderUnifs(Shader& shader);
 
@@ -46,6 +67,8 @@ private:
 
 	glm::mat4 _modelTransform;
 	glm::mat3 _normalMatrix;
+
+	const std::vector<unsigned int>* _skinnedVertexArrays = nullptr;
 };
 
 #endif
\ No newline at end of file
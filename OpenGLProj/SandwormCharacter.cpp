@@ -15,6 +15,11 @@ constexpr auto PARTICLE_SPAWN_ALONG_LINE_LENGTH = 8.0f; // in meters
 constexpr auto MAX_OFFSET_Y = 0.0f; // in meters
 constexpr auto GO_UP_PER_FRAME = 0.1f;
 constexpr auto INITIAL_YAW = -180.0f;
+constexpr auto HIDDEN_BELOW_OFFSET_Y = UNDERGROUND_OFFSET; // fully under the sand, nothing of the animation can be seen
+constexpr auto TRAIL_STAMP_SPACING = 4.0f; // in meters, the worm presses down a new part of its trail every time it moved this far
+constexpr auto TRAIL_RADIUS = 16.0f; // in meters
+constexpr auto TRAIL_DEPTH_PER_STAMP = 0.08f; // in meters, the stamps overlap so the trail ends up a few times deeper than this
+constexpr auto TRAIL_MAX_DEPTH = 1.0f; // in meters below the original sand, so going over the same spot again doesn't keep digging
 
 // animations that I made myself (as I made this model myself, initially following along with a tutorial for the model itself)
 const std::string TPOSE_ANIM = "tpose";
@@ -49,7 +54,7 @@ const BehaviourStage DISAPPEAR_BELOW_GROUND = {
 
 SandWormCharacter::SandWormCharacter(
 	const WorldTimeManager* time,
-	const Terrain* terrain,
+	Terrain* terrain,
 	SoundManager* sound,
 	RenderableGameObject* sandwormGameObject,
 	AnimationSet* animations,
@@ -185,6 +190,11 @@ void SandWormCharacter::updateModelTransform()
 	this->_model->setModelTransform(model);
 }
 
+bool SandWormCharacter::isAnimationHidden() const
+{
+	return this->_yPosOffset <= HIDDEN_BELOW_OFFSET_Y;
+}
+
 void SandWormCharacter::interpolateMoveState(const float currentTime)
 {
 	float t = (currentTime - this->_movementStartTime) / (this->_movementEndTime - this->_movementStartTime); // t = range [0, 1]
@@ -193,6 +203,13 @@ void SandWormCharacter::interpolateMoveState(const float currentTime)
 	this->setCurrentPosition(this->_terrain->getWorldHeightVecFor(pos.x, pos.z));
 	this->_yPosOffset = std::min(_yPosOffset + GO_UP_PER_FRAME, MAX_OFFSET_Y);
 	this->updateModelTransform();
+
+	// trail in the sand (the terrain merges all of the stamps of a frame into one upload)
+	if (!this->_lastTrailStampPos.has_value() || glm::distance(pos, this->_lastTrailStampPos.value()) >= TRAIL_STAMP_SPACING)
+	{
+		this->_terrain->applyDisplacement(pos.x, pos.z, TRAIL_RADIUS, -TRAIL_DEPTH_PER_STAMP, TerrainDisplacementProfile::SMOOTH, TRAIL_MAX_DEPTH);
+		this->_lastTrailStampPos = pos;
+	}
 }
 
 void SandWormCharacter::enqueueBehaviourStage(const BehaviourStage& behaviourStage, const float executeAfterSeconds)
@@ -221,11 +238,18 @@ void SandWormCharacter::updateParticlePlacement()
 
 	// pos 1
 	glm::vec3 posLeft = headPos + (currentFront * PARTICLE_OFFSET_FRONT) + (HEAD_RADIUS * headDirXZPerpendicularUnitVector);
-	posLeft = this->_terrain->getWorldHeightVecFor(posLeft.x, posLeft.z);
 
 	// pos 2
 	glm::vec3 posRight = headPos + (currentFront * PARTICLE_OFFSET_FRONT) - (HEAD_RADIUS * headDirXZPerpendicularUnitVector);
-	posRight = this->_terrain->getWorldHeightVecFor(posRight.x, posRight.z);
+
+	// both on the ground, in one go. Off grid (worm at the edge of the map) -> just keep the dust where the head is
+	const float xs[] = { posLeft.x, posRight.x };
+	const float zs[] = { posLeft.z, posRight.z };
+	float ys[2];
+	TerrainQueryStatus status[2];
+	this->_terrain->getWorldHeightsAt(xs, zs, 2, ys, status);
+	posLeft.y = (status[0] == TerrainQueryStatus::OK) ? ys[0] : headPos.y;
+	posRight.y = (status[1] == TerrainQueryStatus::OK) ? ys[1] : headPos.y;
 
 	const glm::vec3 spawnAlongVectorFromCenter = -currentFront * PARTICLE_SPAWN_ALONG_LINE_LENGTH;
 
@@ -248,9 +272,13 @@ float SandWormCharacter::getYDifferenceHeadAndBody() const
 {
 	const glm::vec3 headPos = this->getHeadPosition();
 	const glm::vec3 middleOfBodyPos = this->getCurrentPosition();
-	const float middleOfBodyY = this->_terrain->getWorldHeightVecFor(middleOfBodyPos.x, middleOfBodyPos.z).y;
-	const float headY = this->_terrain->getWorldHeightVecFor(headPos.x, headPos.z).y;
-	const float yDiff = headY - middleOfBodyY;
+	const float xs[] = { middleOfBodyPos.x, headPos.x };
+	const float zs[] = { middleOfBodyPos.z, headPos.z };
+	float ys[2];
+	if (this->_terrain->getWorldHeightsAt(xs, zs, 2, ys) > 0)
+		return 0.0f; // part of the worm is off the map, treat it as flat
+
+	const float yDiff = ys[1] - ys[0];
 	return yDiff;
 }
 
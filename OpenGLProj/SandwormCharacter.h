@@ -1,6 +1,8 @@
 ﻿#ifndef SANDWORMCHARACTER_MINE_H
 #define SANDWORMCHARACTER_MINE_H
 
+#include <optional>
+
 #include "Animator.h"
 #include "GenericAnimatedCharacter.h"
 #include "ParticleSystem.h"
@@ -30,7 +32,7 @@ public:
 
 	SandWormCharacter(
 		const WorldTimeManager* time, 
-		const Terrain* terrain, 
+		Terrain* terrain, 
 		SoundManager* sound, 
 		RenderableGameObject* sandwormGameObject, 
 		AnimationSet* animations,
@@ -50,9 +52,10 @@ public:
 
 protected:
 	void updateModelTransform() override;
+	bool isAnimationHidden() const override;
 	
 private:
-	const Terrain* _terrain;
+	Terrain* _terrain; // not const: the worm leaves a trail in it
 	SoundManager* _sound;
 
 	RenderableGameObject* _model;
@@ -65,6 +68,7 @@ private:
 	glm::vec3 _movementStartPos = glm::vec3(0.0f);
 	glm::vec3 _movementTarget = glm::vec3(0.0f);
 	float _movementStartTime = 0.0f;
+	std::optional<glm::vec3> _lastTrailStampPos;
 
 	float _yPosOffset = 0.0f;
 
@@ -131,6 +131,29 @@ Shader::Shader(const char* vShaderCode, const char* fShaderCode, const char* geo
     if (geom != 0) glDeleteShader(geom);
 }
 
+Shader Shader::forTransformFeedback(const char* vertexPath, const std::vector<const char*>& varyings)
+{
+    assertFileExists(vertexPath);
+    const std::string vertexCode = readFile(vertexPath);
+    if (vertexCode.empty())
+        throw std::exception("Shader source could not be read");
+
+    unsigned int vertex = compileShader(vertexCode.c_str(), GL_VERTEX_SHADER);
+
+    // (the varyings have to be known before linking)
+    const unsigned int programId = glCreateProgram();
+    glAttachShader(programId, vertex);
+    glTransformFeedbackVaryings(programId, (GLsizei)varyings.size(), varyings.data(), GL_INTERLEAVED_ATTRIBS);
+    glLinkProgram(programId);
+    checkLinkSuccess(programId);
+
+    glDeleteShader(vertex);
+    return Shader(programId);
+}
+
+Shader::Shader(unsigned int programId) : ID(programId)
+{}
+
 void Shader::use()
 {
     glUseProgram(this->ID);
@@ -5,6 +5,7 @@
 
 #include <string>
 #include <sstream>
+#include <vector>
 #include <glm/fwd.hpp>
 
 /**
@@ -37,6 +38,13 @@ public:
      */
     static Shader fromSource(const char* vertexShaderCode, const char* fragmentShaderCode, const char* geomShaderCode = nullptr);
 
+    /**
+     * Build a vertex-only shader whose outputs are captured with transform feedback (interleaved, in the given order)
+     * \param vertexPath file path to shader
+     * \param varyings names of the vertex shader outputs to capture
+     */
+    static Shader forTransformFeedback(const char* vertexPath, const std::vector<const char*>& varyings);
+
     /**
      * \brief Makes use the shader/programs associated with the shader for now.
      * Required before calling any of the setX functions 
@@ -54,6 +62,8 @@ public:
     void setVec2(const std::string& name, const glm::vec2& vec) const;
 
 private:
+    explicit Shader(unsigned int programId);
+
     static std::string readFile(const std::string& fileName);
     static void checkLinkSuccess(GLuint shaderProgramId);
     static unsigned int compileShader(const char* shaderSourceCode, GLenum type);
@@ -0,0 +1,86 @@
+#include "SkinningPass.h"
+
+#include "BonePaletteBuffer.h"
+#include "FileConstants.h"
+
+SkinningPass::SkinningPass()
+:
+_shader(Shader::forTransformFeedback(SHADER_SKINNING_VERT, { "SkinnedPos", "SkinnedNormal" }))
+{
+	BonePaletteBuffer::setupShader(this->_shader);
+}
+
+SkinningPass::~SkinningPass()
+{
+	for (const std::unique_ptr<SkinnedEntity>& skinned : this->_entities)
+	{
+		skinned->entity->getAnimatedModel()->setSkinnedVertexArrays(nullptr);
+		glDeleteVertexArrays((GLsizei)skinned->vertexArrays.size(), skinned->vertexArrays.data());
+		glDeleteBuffers((GLsizei)skinned->buffers.size(), skinned->buffers.data());
+	}
+}
+
+void SkinningPass::add(AnimatedEntity* entity)
+{
+	std::unique_ptr<SkinnedEntity> skinned = std::make_unique<SkinnedEntity>();
+	skinned->entity = entity;
+
+	const std::vector<Mesh>& meshes = entity->getAnimatedModel()->getObjectModel()->getMeshes();
+	skinned->buffers.resize(meshes.size());
+	glGenBuffers((GLsizei)meshes.size(), skinned->buffers.data());
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, skinned->buffers[i]);
+		glBufferData(GL_ARRAY_BUFFER, meshes[i].getVertexCount() * 2 * sizeof(glm::vec3), nullptr, GL_DYNAMIC_COPY);
+		skinned->vertexArrays.push_back(meshes[i].createSkinnedVertexArray(skinned->buffers[i]));
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	this->_entities.push_back(std::move(skinned));
+}
+
+void SkinningPass::run()
+{
+	bool isShaderInUse = false;
+	for (const std::unique_ptr<SkinnedEntity>& skinned : this->_entities)
+	{
+		const Animator& animator = skinned->entity->getAnimator();
+		if (animator.getBonePaletteOffset() == -1) continue; // not uploaded, keeps whatever it has
+		if (skinned->isSkinned && skinned->skinnedPoseVersion == animator.getPoseVersion()) continue;
+
+		if (!isShaderInUse)
+		{
+			this->_shader.use();
+			glEnable(GL_RASTERIZER_DISCARD);
+			isShaderInUse = true;
+		}
+		this->skin(*skinned);
+	}
+	if (isShaderInUse) glDisable(GL_RASTERIZER_DISCARD);
+}
+
+void SkinningPass::skin(SkinnedEntity& skinned)
+{
+	Animator& animator = skinned.entity->getAnimator();
+	RenderableGameObject* model = skinned.entity->getAnimatedModel();
+	this->_shader.setInt("boneOffset", animator.getBonePaletteOffset());
+	this->_shader.setInt("boneCount", animator.getUsedBoneCount());
+
+	const std::vector<Mesh>& meshes = model->getObjectModel()->getMeshes();
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, skinned.buffers[i]);
+		glBeginTransformFeedback(GL_POINTS);
+		meshes[i].drawVertices();
+		glEndTransformFeedback();
+	}
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+
+	skinned.skinnedPoseVersion = animator.getPoseVersion();
+	if (!skinned.isSkinned)
+	{
+		// only from now on the buffers hold something worth drawing
+		model->setSkinnedVertexArrays(&skinned.vertexArrays);
+		skinned.isSkinned = true;
+	}
+}
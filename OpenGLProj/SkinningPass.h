@@ -0,0 +1,54 @@
+#ifndef SKINNINGPASS_MINE_H
+#define SKINNINGPASS_MINE_H
+#include <memory>
+#include <vector>
+
+#include "AnimatedEntity.h"
+#include "Shader.h"
+
+/**
+ * \brief Skins animated models once per frame on the GPU, into vertex buffers of their own (transform feedback).
+ *
+ * After run(), the models of the added entities draw those buffers as static geometry (see RenderableGameObject::setSkinnedVertexArrays()),
+ * so every pass that draws them (the main pass, the outline masking pass, ...) gets the skinned vertices without redoing the skinning.
+ * Reads the bone matrices from the BonePaletteBuffer, so it must run after its upload() for the frame.
+ *
+ * Entities whose pose didn't change since their last skinning (held or frozen by the animation LOD) are skipped.
+ */
+class SkinningPass
+{
+public:
+	SkinningPass();
+	~SkinningPass();
+
+	SkinningPass(const SkinningPass&) = delete;
+	SkinningPass& operator=(const SkinningPass&) = delete;
+
+	/**
+	 * \brief Gives the entity's model its own skinned vertex buffers. Models shared between entities are fine,
+	 * every RenderableGameObject gets its own buffers.
+	 */
+	void add(AnimatedEntity* entity);
+
+	/**
+	 * \brief Skins all the entities that have a new pose this frame
+	 */
+	void run();
+
+private:
+	struct SkinnedEntity
+	{
+		AnimatedEntity* entity;
+		std::vector<unsigned int> buffers; // per mesh: skinned position + normal, interleaved
+		std::vector<unsigned int> vertexArrays; // per mesh: the skinned buffer, plus the rest of the mesh's vertex attributes
+		unsigned int skinnedPoseVersion = 0;
+		bool isSkinned = false;
+	};
+
+	Shader _shader;
+	std::vector<std::unique_ptr<SkinnedEntity>> _entities; // (stable addresses, the models point at their vertexArrays)
+
+	void skin(SkinnedEntity& skinned);
+};
+
+#endif
@@ -4,7 +4,6 @@
 
 #include "ConfigConstants.h"
 #include "ErrorUtils.h"
-#include "stb_image.h"
 
 const float Skybox::_skyboxVertices[] = {
 	// positions          
@@ -51,33 +50,38 @@ const float Skybox::_skyboxVertices[] = {
 	 1.0f, -1.0f,  1.0f
 };
 
+static std::vector<DecodedTexture> decodeFaces(const std::vector<std::string>& faces)
+{
+	std::vector<DecodedTexture> decoded;
+	for (const std::string& face : faces)
+		decoded.push_back(decodeTextureFile(face.c_str(), PROJ_CURRENT_DIR, false));
+	return decoded;
+}
+
+Skybox::Skybox(Shader* shader, const std::vector<std::string>& faces) : Skybox(shader, decodeFaces(faces))
+{
+}
+
 // cubemap / skybox https://learnopengl.com/Advanced-OpenGL/Cubemaps
-Skybox::Skybox(Shader* shader, const std::vector<std::string>& faces) : _shader(shader)
+Skybox::Skybox(Shader* shader, const std::vector<DecodedTexture>& faces) : _shader(shader)
 {
 	glGenTextures(1, &this->_textureId);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, this->_textureId);
 
-	stbi_set_flip_vertically_on_load(false);
-
-	int width, height, nrChannels;
-
 	const GLenum format = GL_RGB;
 	const GLint internalFormat = USE_SRGB_COLORS ? GL_SRGB : GL_RGB;
 
 	for (unsigned int i = 0; i < faces.size(); i++)
 	{
-		unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-		if (data)
+		if (faces[i].data)
 		{
 			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-				0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data
+				0, internalFormat, faces[i].width, faces[i].height, 0, format, GL_UNSIGNED_BYTE, faces[i].data
 			);
-			stbi_image_free(data);
 		}
 		else
 		{
-			std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
-			stbi_image_free(data);
+			std::cout << "Cubemap tex failed to load (face " << i << ")" << std::endl;
 		}
 	}
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
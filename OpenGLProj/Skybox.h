@@ -1,5 +1,6 @@
 #ifndef SKYBOX_MINE_H
 #define SKYBOX_MINE_H
+#include "FileUtils.h"
 #include "Shader.h"
 
 #include <glm/glm.hpp>
@@ -10,6 +11,11 @@ class Skybox
 public:
 	Skybox(Shader* shader, const std::vector<std::string>& faces);
 
+	/**
+	 * \param faces		already decoded (not flipped) in the same order as the paths above, e.g. by AssetRegistry::requestImage()
+	 */
+	Skybox(Shader* shader, const std::vector<DecodedTexture>& faces);
+
 	void render(glm::mat4 view, glm::mat4 projection);
 private:
 	unsigned int _textureId;
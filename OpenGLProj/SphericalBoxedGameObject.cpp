@@ -47,6 +47,12 @@ void SphericalBoxedGameObject::setShowBoundingSphere(bool doShow)
 	this->_showBoundingSphere = doShow;
 }
 
+bool SphericalBoxedGameObject::isVisible(const ViewFrustum& frustum, float boundsScale) const
+{
+	return RenderableGameObject::isVisible(frustum, boundsScale)
+		|| frustum.isSphereVisible(glm::vec3(this->getWorldMidPoint()), this->_boundingSphereRadius * boundsScale);
+}
+
 void SphericalBoxedGameObject::draw(Shader& shader)
 {
 	RenderableGameObject::draw(shader);
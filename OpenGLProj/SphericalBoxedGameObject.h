@@ -48,6 +48,11 @@ public:
 
 	void draw(Shader& shader) override;
 
+	/**
+	 * \brief Visible if either the model bounds or the bounding sphere (which may stick out of the model) are within the frustum
+	 */
+	bool isVisible(const ViewFrustum& frustum, float boundsScale = 1.0f) const override;
+
 private:
 	float _boundingSphereRadius;
 	glm::vec3 _boundingSphereMidPoint;
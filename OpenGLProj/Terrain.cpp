@@ -1,16 +1,34 @@
 ﻿#include "Terrain.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <iostream>
 #include <vector>
 #include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
 
 #include "Colors.h"
 #include "ErrorUtils.h"
-#include "FileUtils.h"
 #include "ResourceUtils.h"
 #include "stb_image.h"
+#include "TerrainTileStreamer.h"
+#include "ThreadPool.h"
 
 #define RENDER_AS_MESH false
+// repacks every vertex with the scalar path and checks the SSE2 rows are bit-identical to it (slow, debugging only)
+#define VERIFY_SIMD_PACKING false
+
+// the vertex generation (packVertexRow) and the batched height queries (getWorldHeightsAt) run 4 at a time with SSE2 where it is available
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define USE_SSE2 true
+#include <emmintrin.h>
+#else
+#define USE_SSE2 false
+#endif
 
 #if RENDER_AS_MESH
 #define DEBUG_RENDER_AS_MESH_CONFIG_PRE glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -23,6 +41,12 @@
 
 constexpr auto RESIZE_FACTOR = 2.0f;
 constexpr auto TEXTURE_DIV_SCALING = 4.0f;
+constexpr auto DIRTY_BLOCK_SIZE = 64; // vertices, deformations are merged into one dirty rect per block this size (see applyDisplacement())
+constexpr auto DISPLACEMENT_EDGE_FADE = 16; // vertices, deformations fade out over this many towards the edge of the grid (see applyDisplacement())
+
+constexpr auto TERRAIN_CACHE_EXTENSION = ".terraincache"; // cooked cache lives right next to the height map
+constexpr auto TERRAIN_CACHE_MAGIC = "TRNC";
+constexpr auto TERRAIN_CACHE_VERSION = 3u;
 
 /*
  * this builds out the following "tiles":
@@ -45,18 +69,18 @@ TODO/note:
 	very nice patterns.
 	But it looks better than nothing
 
--	this "tile" system could be optimized by using lower resolution "tiles"/meshes
-	(so 8bit heightmaps vs 16bit as I use now) when they are further away.
-	If I have some extra time I will implement this, such that based on your current
-	tile the tiles further away will be lower-res.
-	... You could probably also scale down the meshes with more "steps" as is done in
-	modern video games, but I will definitely not do anything this complex for this project.
+-	the terrain itself is now drawn in chunks with a lower resolution further away
+	(see TerrainChunkTree, CDLOD).
 
--	There's currently "seams" in the edges where the tiles meet each other because the
-	average vertex normal computation does not include normals at the other side of the tile
-	when computing something for one of the edges. The fix is obviously to take normals for all
-	the "virtual tiles" that would form seams (so you'd pretend that there's triangles there even
-	though there are not).
+-	the tiles around it are no longer mirrored copies of this mesh (negative scale flips the
+	triangle winding and the tangents): TerrainTileStreamer builds them as their own
+	(lower resolution) meshes from the mirrored height map instead, in the background.
+	The matrices below are kept around for reference only.
+
+-	the normals used to have "seams" in the edges where the tiles meet each other because the
+	average of the triangle normals did not include the triangles at the other side of the tile.
+	They're now central differences over the height field with an apron from the (mirrored)
+	neighbouring tile instead, see packVertexRow().
 
 The main problem I have is that the heightmap that I am using is basically
 just the best looking SMOOTH "desert" height map I could get. It doesn't really look very good.
@@ -132,134 +156,160 @@ void Terrain::populateModelMatrices()
 	// _renderMatrices.emplace_back(this->_terrainModelRB, this->_terrainNormalMatrixRB);
 }
 
-void Terrain::generateVerticesFromHeightMap(unsigned short* data, int nChannels, float yScale, float yShift)
+void Terrain::generateHeightsFromHeightMap(unsigned short* data, int nChannels, float yScale, float yShift, unsigned int zBegin, unsigned int zEnd)
 {
-	int index = 0;
-	for (unsigned int z = 0; z < this->_height; ++z)
+	// (x and z are implied by the grid position, see terrain.vert)
+	for (unsigned int z = zBegin; z < zEnd; ++z)
 	{
 		for (unsigned int x = 0; x < this->_width; ++x)
 		{
 			unsigned short* texel = data + (x + this->_width * z) * nChannels;
-			unsigned short y = texel[0];
-
-			const float xPos = -this->_width / RESIZE_FACTOR + x;
-			const float yPos = (float)y * yScale - yShift;
-			const float zPos = -this->_height / RESIZE_FACTOR + z;
-
-			this->_vertices[index].pos = glm::vec3(
-				xPos, // x
-				yPos, // y
-				zPos // z
-			);
-			this->_vertices[index].texture = glm::vec2(
-				xPos / TEXTURE_DIV_SCALING,
-				zPos / TEXTURE_DIV_SCALING
-			);
-
-			this->_heightMap[x + this->_width * z] = yPos;
-
-			index++;
+			this->_heightMap[x + this->_width * z] = (float)texel[0] * yScale - yShift;
 		}
 	}
 }
 
-void Terrain::mapTriangles()
+/**
+ * Octahedral encoding (https://jcgt.org/published/0003/02/01/): the unit sphere is projected onto an octahedron, which is unfolded into a square.
+ * The octahedron is folded around y here, so the upper hemisphere (where nearly all the terrain normals are) covers the inner diamond.
+ * Must match octDecode() in terrain.vert. (v doesn't need to be normalized, the projection takes care of that)
+ */
+void octEncodeUnitVector(const glm::vec3& v, int16_t out[2])
 {
-	for (unsigned int i = 0; i < this->_height - 1; i++)
+	const glm::vec3 n = v / (std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z));
+	glm::vec2 e = glm::vec2(n.x, n.z);
+	if (n.y < 0.0f)
 	{
-		for (unsigned int j = 0; j < this->_width - 1; j++)
-		{
-			// every set of 4 pixels is considered as the vertices.
-			// These 4 pixels are split into two triangles
-
-			// first/left triangle:  (clockwise)
-			//                  0---2
-			//                  | / |
-			//                  1----
-			const unsigned int index0 = j + (this->_width * i);
-			const unsigned int index1 = j + (this->_width * (i + 1));
-			const unsigned int index2 = (j + 1) + (this->_width * i);
-			this->_indices.push_back(index0); // 0
-			this->_indices.push_back(index1); // 1
-			this->_indices.push_back(index2); // 2
-
-			// second/right triangle:  (clockwise)
-			//                  ----2
-			//                  | / |
-			//                  1---3
-			const unsigned int index3 = (j + 1) + (this->_width * (i + 1));
-			this->_indices.push_back(index1); // 1
-			this->_indices.push_back(index3); // 3
-			this->_indices.push_back(index2); // 2
-
-			// the normals will later be averaged for smooth surface rendering (Phong)!
-			this->insertNormContribution(index0, index1, index2); // 3.1 calculate normals for smooth surface rendering 
-			this->insertNormContribution(index1, index3, index2); // (https://www.youtube.com/watch?v=bwq_y0zxpQM&list=PLA0dXqQjCx0S9qG5dWLsheiCJV-_eLUM0&index=6)
-
-			// compute tangent/bitangent! (^ they will also be averaged just as the normals are!)
-			this->insertTangentAndBitangentContribution(index0, index1, index2, index3);
-		}
+		e = glm::vec2(
+			(1.0f - std::fabs(n.z)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - std::fabs(n.x)) * (n.z >= 0.0f ? 1.0f : -1.0f)
+		);
 	}
+	out[0] = (int16_t)std::round(std::clamp(e.x, -1.0f, 1.0f) * 32767.0f);
+	out[1] = (int16_t)std::round(std::clamp(e.y, -1.0f, 1.0f) * 32767.0f);
 }
 
-void Terrain::insertNormContribution(unsigned int index0, unsigned int index1, unsigned int index2)
+/**
+ * Normal and tangent of a vertex from the slopes of the height field around it (grid spacing of 1):
+ * the normal is (-dh/dx, 1, -dh/dz) and since the texture coordinates run along x/z the tangent follows x (negated, that's the
+ * direction the normal mapping in terrain.frag expects).
+ */
+static void _packSlopes(float dhdx, float dhdz, PackedTerrainVertex& vert)
 {
-	glm::vec3 v1 = this->_vertices[index0].pos - this->_vertices[index1].pos;
-	glm::vec3 v2 = this->_vertices[index0].pos - this->_vertices[index2].pos;
-	glm::vec3 contrib = glm::cross(v1, v2);
-
-	this->_vertices[index0].normal += contrib;
-	this->_vertices[index1].normal += contrib;
-	this->_vertices[index2].normal += contrib;
+	octEncodeUnitVector(glm::vec3(-dhdx, 1.0f, -dhdz), vert.normal);
+	octEncodeUnitVector(glm::vec3(-1.0f, -dhdx, 0.0f), vert.tangent);
 }
 
-void Terrain::insertTangentAndBitangentContribution(unsigned index0, unsigned index1, unsigned index2, unsigned index3)
+/**
+ * Central differences over the height field, columns [xBegin, xEnd) of one row at a time (out[0] is column xBegin).
+ * Every vertex only reads the heights around it and writes itself, so rows can be done in any order/on any thread.
+ *
+ * The grid has a one vertex apron on every side, taken from the neighbouring tiles. Those are mirrored copies of the
+ * height map (see TerrainTileStreamer), so the row/column just past the edge is the same as the one just before it.
+ * The slope across the edge thus comes out as 0, same as on the tiles. Along the edge the tiles take their differences over
+ * every TILE_STRIDE-th vertex instead, so the normals on both sides are close but not the same.
+ */
+void Terrain::packVertexRow(unsigned int z, int xBegin, int xEnd, PackedTerrainVertex* out) const
 {
-	// first/left triangle:  (clockwise)
-	//                  0---2
-	//                  | / |
-	//                  1----
+	const int width = this->_width;
+	const float* above = &this->_heightMap[(size_t)width * (z == 0 ? 1 : z - 1)];
+	const float* row = &this->_heightMap[(size_t)width * z];
+	const float* below = &this->_heightMap[(size_t)width * (z == this->_height - 1 ? this->_height - 2 : z + 1)];
 
-	// second/right triangle:  (clockwise)
-	//                  ----2
-	//                  | / |
-	//                  1---3
+	auto packColumn = [&](int x)
+	{
+		const float left = row[x == 0 ? 1 : x - 1];
+		const float right = row[x == width - 1 ? width - 2 : x + 1];
+		out[x - xBegin].height = row[x];
+		_packSlopes((right - left) * 0.5f, (below[x] - above[x]) * 0.5f, out[x - xBegin]);
+	};
 
-	TerrainVertex& v0 = this->_vertices[index0];
-	TerrainVertex& v1 = this->_vertices[index1];
-	TerrainVertex& v2 = this->_vertices[index2];
-	TerrainVertex& v3 = this->_vertices[index3];
+	int x = xBegin;
+	if (x == 0) packColumn(x++); // (left apron)
+
+#if USE_SSE2
+	// 4 vertices at a time, for everything that has both of its x neighbours inside of the row.
+	// Same result as _packSlopes() (to the bit, same operations in the same order), but with the octahedral encoding worked out for these two specific vectors:
+	// - normal (-dhdx, 1, -dhdz): y is always positive, so it's just x and z divided by the L1 norm
+	// - tangent (-1, -dhdx, 0): y is negative for dhdx > 0, in which case it folds over onto (-1, 1 - 1 / (1 + |dhdx|))
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 minusHalf = _mm_set1_ps(-0.5f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 snormMax = _mm_set1_ps(32767.0f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	// std::round() (halfway cases away from zero, _mm_cvtps_epi32 would round those to even): truncate, then step away from zero
+	// if what got cut off is at least a half. (that difference is exact, no rounding can sneak in there)
+	auto roundToInt = [&](__m128 v)
+	{
+		const __m128i truncated = _mm_cvttps_epi32(v);
+		const __m128 fraction = _mm_sub_ps(v, _mm_cvtepi32_ps(truncated));
+		const __m128i up = _mm_castps_si128(_mm_cmpge_ps(fraction, half)); // -1 where it needs to go up
+		const __m128i down = _mm_castps_si128(_mm_cmple_ps(fraction, minusHalf));
+		return _mm_add_epi32(_mm_sub_epi32(truncated, up), down);
+	};
 
-	auto [tangentTriangle1, biTangentTriangle1] = computeTangentAndBitangentForTriangle(
-		v2.pos,
-		v1.pos,
-		v0.pos,
-		v2.texture,
-		v1.texture,
-		v0.texture
-	);
-	v0.tangent += tangentTriangle1;
-	v1.tangent += tangentTriangle1;
-	v2.tangent += tangentTriangle1;
-	v0.biTangent += biTangentTriangle1;
-	v1.biTangent += biTangentTriangle1;
-	v2.biTangent += biTangentTriangle1;
-
-	auto [tangentTriangle2, biTangentTriangle2] = computeTangentAndBitangentForTriangle(
-		v2.pos,
-		v3.pos,
-		v1.pos,
-		v2.texture,
-		v3.texture,
-		v1.texture
-	);
-	v1.tangent += tangentTriangle2;
-	v3.tangent += tangentTriangle2;
-	v2.tangent += tangentTriangle2;
-	v1.biTangent += tangentTriangle2;
-	v3.biTangent += biTangentTriangle2;
-	v2.biTangent += biTangentTriangle2;
+	alignas(16) int32_t normalX[4], normalZ[4], tangentX[4], tangentZ[4];
+	for (; x + 4 <= std::min(xEnd, width - 1); x += 4)
+	{
+		const __m128 dhdx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + x + 1), _mm_loadu_ps(row + x - 1)), half);
+		const __m128 dhdz = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(below + x), _mm_loadu_ps(above + x)), half);
+		const __m128 absDhdx = _mm_andnot_ps(signBit, dhdx);
+		const __m128 absDhdz = _mm_andnot_ps(signBit, dhdz);
+
+		const __m128 normalNorm = _mm_add_ps(_mm_add_ps(absDhdx, one), absDhdz);
+		_mm_store_si128((__m128i*)normalX, roundToInt(_mm_mul_ps(_mm_div_ps(_mm_xor_ps(dhdx, signBit), normalNorm), snormMax)));
+		_mm_store_si128((__m128i*)normalZ, roundToInt(_mm_mul_ps(_mm_div_ps(_mm_xor_ps(dhdz, signBit), normalNorm), snormMax)));
+
+		const __m128 tangentX0 = _mm_div_ps(one, _mm_add_ps(one, absDhdx)); // -n.x
+		const __m128 folded = _mm_cmpgt_ps(dhdx, zero);
+		const __m128 unfoldedX = _mm_xor_ps(_mm_mul_ps(tangentX0, snormMax), signBit); // n.x
+		const __m128 foldedX = _mm_xor_ps(snormMax, signBit); // -1
+		const __m128 foldedZ = _mm_mul_ps(_mm_sub_ps(one, tangentX0), snormMax); // 1 - |n.x|
+		_mm_store_si128((__m128i*)tangentX, roundToInt(_mm_or_ps(_mm_and_ps(folded, foldedX), _mm_andnot_ps(folded, unfoldedX))));
+		_mm_store_si128((__m128i*)tangentZ, roundToInt(_mm_and_ps(folded, foldedZ)));
+
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			PackedTerrainVertex& vert = out[x - xBegin + lane];
+			vert.height = row[x + lane];
+			vert.normal[0] = (int16_t)normalX[lane];
+			vert.normal[1] = (int16_t)normalZ[lane];
+			vert.tangent[0] = (int16_t)tangentX[lane];
+			vert.tangent[1] = (int16_t)tangentZ[lane];
+		}
+	}
+#endif
 
+	for (; x < xEnd; ++x) packColumn(x); // whatever is left + the right apron
+}
+
+/**
+ * A single column never fills up a batch of 4, so packing the vertices one by one goes through the scalar path only
+ * (packColumn(), i.e. octEncodeUnitVector()). Logs the vertices where that's not the exact same as what's in _packedVertices.
+ */
+void Terrain::verifyPackedVertices() const
+{
+	size_t mismatchCount = 0;
+	for (int z = 0; z < this->_height; ++z)
+	{
+		for (int x = 0; x < this->_width; ++x)
+		{
+			PackedTerrainVertex expected;
+			this->packVertexRow(z, x, x + 1, &expected);
+			const PackedTerrainVertex& actual = this->_packedVertices[(size_t)this->_width * z + x];
+			if (memcmp(&expected, &actual, sizeof(PackedTerrainVertex)) == 0) continue;
+
+			if (mismatchCount++ < 10)
+			{
+				std::cout << "Packed vertex (" << x << ", " << z << ") differs from the scalar path: normal (" << actual.normal[0] << ", " << actual.normal[1]
+					<< ") instead of (" << expected.normal[0] << ", " << expected.normal[1] << "), tangent (" << actual.tangent[0] << ", " << actual.tangent[1]
+					<< ") instead of (" << expected.tangent[0] << ", " << expected.tangent[1] << ")" << std::endl;
+			}
+		}
+	}
+	std::cout << "SIMD vertex packing: " << mismatchCount << " of " << this->_packedVertices.size() << " vertices differ from the scalar path" << std::endl;
 }
 
 /**
@@ -271,68 +321,281 @@ void Terrain::insertTangentAndBitangentContribution(unsigned index0, unsigned in
 Terrain::Terrain(
 	Shader* shader, 
 	const std::string& sourceHeightMapPath, // must be 16-bit
-	const std::string& texturePath0, 
-	const std::string& texturePath1,
-	const std::string& textureNormalMap,
+	unsigned int textureId0,
+	unsigned int textureId1,
+	unsigned int textureNormalId,
 	float yScaleMult, 
 	float yShift,
 	const glm::vec3& sunPos,
 	const glm::vec3& sunLightColor)
 :
-_shader(shader),
+Terrain(sourceHeightMapPath, yScaleMult, yShift) // all the CPU side mesh data (from the cooked cache if possible)
+{
+	this->_shader = shader;
+
+	this->populateModelMatrices(); // for terrain "tiling"
+
+	// textures (loaded along with the other assets, see AssetRegistry)
+	this->_textureId0 = textureId0; // texture0
+	this->_textureId1 = textureId1;  // texture1
+	this->_textureNormalId = textureNormalId; // texture2 (normal map)
+
+	// 5. OpenGL initialization of triangle data
+	this->setupMesh();
+	this->setupHeightMapTexture();
+	this->releaseMeshSource(); // it all lives on the GPU now (only the height map is still needed on the CPU)
+
+	// 6. Shader configuration
+	this->setupShader(sunPos, sunLightColor);
+
+	glBindVertexArray(0);
+
+	// 7. the world around it (filled in over the next frames), built from the heights as they are now
+	this->_sourceHeightMap = this->_heightMap;
+	this->_tileStreamer = new TerrainTileStreamer(
+		this->_width,
+		this->_height,
+		&this->_sourceHeightMap,
+		glm::vec2(-this->_width / RESIZE_FACTOR, -this->_height / RESIZE_FACTOR)
+	);
+}
+
+Terrain::Terrain(const std::string& sourceHeightMapPath, float yScaleMult, float yShift)
+:
+_shader(nullptr),
+_chunkTree(nullptr),
+_heightPyramid(nullptr),
+_tileStreamer(nullptr),
 _terrainModel(glm::mat4(1.0f)),
 _terrainNormalMatrix(glm::mat3(glm::transpose(glm::inverse(_terrainModel))))
 {
-	int width, height, nChannels;
 	assertFileExists(sourceHeightMapPath);
-	assertFileExists(texturePath0);
-	assertFileExists(texturePath1);
-	assertFileExists(textureNormalMap);
+	const std::string cachePath = sourceHeightMapPath + TERRAIN_CACHE_EXTENSION;
+
+	if (this->loadFromCache(cachePath, sourceHeightMapPath, yScaleMult, yShift))
+	{
+		std::cout << "Loaded terrain from cache: '" << cachePath << "'" << std::endl;
+	}
+	else
+	{
+		std::cout << "Terrain cache missing or stale, generating from: '" << sourceHeightMapPath << "'" << std::endl;
+		this->generateFromHeightMap(sourceHeightMapPath, yScaleMult, yShift);
+		this->writeCache(cachePath, sourceHeightMapPath, yScaleMult, yShift);
+	}
+
+	// cheap to build (a single pass over the height map + the much smaller levels above), so not worth caching
+	this->_heightPyramid = new TerrainHeightPyramid(this->_width, this->_height, this->_heightMap);
+}
+
+void Terrain::cookCache(const std::string& sourceHeightMapPath, float yScaleMult, float yShift)
+{
+	Terrain terrain(sourceHeightMapPath, yScaleMult, yShift); // (re)writes the cache whenever it's not up to date
+}
+
+void Terrain::generateFromHeightMap(const std::string& sourceHeightMapPath, float yScaleMult, float yShift)
+{
+	int width, height, nChannels;
 
 	// load 16-bit heightmap image
 	unsigned short* data = stbi_load_16(sourceHeightMapPath.c_str(), &width, &height, &nChannels, 0);
+	if (data == nullptr) throw std::exception("Height map could not be loaded");
 	if (width == 1 || height == 1) throw std::exception("Height map must have a width and height dimension of at least 2px");
 
 	// 0. setup
 	this->_width = width;
 	this->_height = height;
 	this->_heightMap.resize(this->_height * this->_width); // fill out to be referenced later
-	this->_vertices.resize(this->_width * this->_height); // make space
-
-	this->populateModelMatrices(); // for terrain "tiling"
-
-	// load textures
-	this->_textureId0 = loadSRGBColorSpaceTexture(texturePath0.c_str(), PROJ_CURRENT_DIR, GL_TEXTURE0); // texture0
-	this->_textureId1 = loadSRGBColorSpaceTexture(texturePath1.c_str(), PROJ_CURRENT_DIR, GL_TEXTURE1);  // texture1
-	this->_textureNormalId = loadDataTexture(textureNormalMap.c_str(), PROJ_CURRENT_DIR, GL_TEXTURE2); // texture2 (normal map)
+	this->_packedVertices.resize(this->_width * this->_height); // make space
 
 	// vertex generation
 	const float yScale = yScaleMult / 65536.0f; // 16-bit image gives more possible levels...
 
-	// 1. generate vertices from the height map. The x and z are evenly spaced on a grid.
-	// The height map (color) gives the height of the vertex = the y coordinate
-	this->generateVerticesFromHeightMap(data, nChannels, yScale, yShift);
+	// (steps 1 - 2 are split up in bands of rows over all cores. Step 2 needs the rows around it, so step 1 must be fully done first)
+	ThreadPool& pool = ThreadPool::getShared();
+
+	// 1. the height map (color) gives the height of every vertex = the y coordinate. The x and z are evenly spaced on a grid
+	pool.parallelFor(0, this->_height, [&](unsigned int zBegin, unsigned int zEnd) {
+		this->generateHeightsFromHeightMap(data, nChannels, yScale, yShift, zBegin, zEnd);
+	});
 	stbi_image_free(data);
 
-	// 2. the indices array here maps out the vertices composing individual triangles to prevent repetitions
-	this->mapTriangles();
+	// 2. normals/tangents from the slopes of the height field, straight into the compact GPU format
+	pool.parallelFor(0, this->_height, [this](unsigned int zBegin, unsigned int zEnd) {
+		for (unsigned int z = zBegin; z < zEnd; ++z) this->packVertexRow(z, 0, this->_width, &this->_packedVertices[(size_t)this->_width * z]);
+	});
+#if VERIFY_SIMD_PACKING
+	this->verifyPackedVertices();
+#endif
+
+	// 3. (the index buffer is built per LOD level by the chunk tree, see TerrainChunkTree::appendQuadrantIndices)
+
+	// 4. the indices of every LOD level, split up into chunks
+	this->_chunkTree = new TerrainChunkTree(
+		this->_width, 
+		this->_height, 
+		this->_heightMap, 
+		glm::vec2(-this->_width / RESIZE_FACTOR, -this->_height / RESIZE_FACTOR)
+	);
+
+	this->_meshVertices = this->_packedVertices.data();
+	this->_meshVertexCount = this->_packedVertices.size();
+	this->_meshIndices = this->_chunkTree->getIndices().data();
+	this->_meshIndexCount = this->_chunkTree->getIndices().size();
+}
+
+/**
+ * Layout of the cooked cache file:
+ *	- TerrainCacheHeader
+ *	- width * height PackedTerrainVertex
+ *	- width * height floats (_heightMap)
+ *	- nodeCount TerrainChunkNode
+ *	- indexCount unsigned int
+ *
+ * Everything is stored exactly the way it's laid out in memory (so it only works on the same platform/compiler it was written with,
+ * which is fine for a local cache). Any change to the generation of the mesh or to these structs must bump TERRAIN_CACHE_VERSION.
+ */
+struct TerrainCacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t vertexSize;
+	uint32_t nodeSize;
+	int32_t width;
+	int32_t height;
+	float yScaleMult;
+	float yShift;
+	uint64_t sourceFileSize;
+	int64_t sourceWriteTime;
+	uint64_t nodeCount;
+	uint64_t indexCount;
+};
+
+static TerrainCacheHeader makeCacheKey(const std::string& sourceHeightMapPath, float yScaleMult, float yShift)
+{
+	TerrainCacheHeader key = {};
+	memcpy(key.magic, TERRAIN_CACHE_MAGIC, sizeof(key.magic));
+	key.version = TERRAIN_CACHE_VERSION;
+	key.vertexSize = sizeof(PackedTerrainVertex);
+	key.nodeSize = sizeof(TerrainChunkNode);
+	key.yScaleMult = yScaleMult;
+	key.yShift = yShift;
+	key.sourceFileSize = std::filesystem::file_size(sourceHeightMapPath);
+	key.sourceWriteTime = std::filesystem::last_write_time(sourceHeightMapPath).time_since_epoch().count();
+	return key;
+}
+
+bool Terrain::loadFromCache(const std::string& cachePath, const std::string& sourceHeightMapPath, float yScaleMult, float yShift)
+{
+	if (!this->_cacheFile.open(cachePath)) return false;
+	if (this->_cacheFile.getSize() < sizeof(TerrainCacheHeader))
+	{
+		this->_cacheFile.close();
+		return false;
+	}
 
-	// 3. normalize all the vertex normals (average of all the plane normals that share this vertex. Up to 6 but possibly less!)
-	for (unsigned int i = 0; i < this->_vertices.size(); ++i)
+	TerrainCacheHeader header;
+	memcpy(&header, this->_cacheFile.getData(), sizeof(TerrainCacheHeader));
+	const TerrainCacheHeader expected = makeCacheKey(sourceHeightMapPath, yScaleMult, yShift);
+
+	const size_t gridSize = (size_t)header.width * (size_t)header.height;
+	const size_t expectedFileSize = sizeof(TerrainCacheHeader)
+		+ gridSize * sizeof(PackedTerrainVertex)
+		+ gridSize * sizeof(float)
+		+ header.nodeCount * sizeof(TerrainChunkNode)
+		+ header.indexCount * sizeof(unsigned int);
+
+	const bool isUpToDate = memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+		&& header.version == expected.version
+		&& header.vertexSize == expected.vertexSize
+		&& header.nodeSize == expected.nodeSize
+		&& header.yScaleMult == expected.yScaleMult
+		&& header.yShift == expected.yShift
+		&& header.sourceFileSize == expected.sourceFileSize
+		&& header.sourceWriteTime == expected.sourceWriteTime
+		&& header.width > 1 && header.height > 1
+		&& this->_cacheFile.getSize() == expectedFileSize;
+	if (!isUpToDate)
 	{
-		TerrainVertex& vert = this->_vertices[i];
-		vert.normal = glm::normalize(vert.normal);
-		vert.tangent = -glm::normalize(vert.tangent); // correct the direction of this vector for normal mapping
-		vert.biTangent = glm::normalize(vert.biTangent);
+		this->_cacheFile.close();
+		return false;
 	}
 
-	// 4. OpenGL initialization of triangle data
-	this->setupMesh();
+	this->_width = header.width;
+	this->_height = header.height;
 
-	// 5. Shader configuration
-	this->setupShader(sunPos, sunLightColor);
+	const unsigned char* cursor = this->_cacheFile.getData() + sizeof(TerrainCacheHeader);
 
-	glBindVertexArray(0);
+	// the vertices and indices go to the GPU straight from the mapped file
+	this->_meshVertices = reinterpret_cast<const PackedTerrainVertex*>(cursor);
+	this->_meshVertexCount = gridSize;
+	cursor += gridSize * sizeof(PackedTerrainVertex);
+
+	this->_heightMap.resize(gridSize);
+	memcpy(this->_heightMap.data(), cursor, gridSize * sizeof(float));
+	cursor += gridSize * sizeof(float);
+
+	std::vector<TerrainChunkNode> nodes(header.nodeCount);
+	memcpy(nodes.data(), cursor, header.nodeCount * sizeof(TerrainChunkNode));
+	cursor += header.nodeCount * sizeof(TerrainChunkNode);
+	this->_chunkTree = new TerrainChunkTree(
+		this->_width,
+		this->_height,
+		glm::vec2(-this->_width / RESIZE_FACTOR, -this->_height / RESIZE_FACTOR),
+		std::move(nodes)
+	);
+
+	this->_meshIndices = reinterpret_cast<const unsigned int*>(cursor);
+	this->_meshIndexCount = header.indexCount;
+
+	return true;
+}
+
+void Terrain::writeCache(const std::string& cachePath, const std::string& sourceHeightMapPath, float yScaleMult, float yShift) const
+{
+	TerrainCacheHeader header = makeCacheKey(sourceHeightMapPath, yScaleMult, yShift);
+	header.width = this->_width;
+	header.height = this->_height;
+	header.nodeCount = this->_chunkTree->getNodes().size();
+	header.indexCount = this->_meshIndexCount;
+
+	// written to a temporary file first so a cache is never left half-written
+	const std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(this->_meshVertices), this->_meshVertexCount * sizeof(PackedTerrainVertex));
+		out.write(reinterpret_cast<const char*>(this->_heightMap.data()), this->_heightMap.size() * sizeof(float));
+		out.write(reinterpret_cast<const char*>(this->_chunkTree->getNodes().data()), header.nodeCount * sizeof(TerrainChunkNode));
+		out.write(reinterpret_cast<const char*>(this->_meshIndices), this->_meshIndexCount * sizeof(unsigned int));
+		if (!out)
+		{
+			std::cout << "Could not write terrain cache: '" << cachePath << "'" << std::endl; // not fatal, just slower next time
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error) std::cout << "Could not write terrain cache: '" << cachePath << "' (" << error.message() << ")" << std::endl;
+}
+
+void Terrain::releaseMeshSource()
+{
+	this->_meshVertices = nullptr;
+	this->_meshVertexCount = 0;
+	this->_meshIndices = nullptr;
+	this->_meshIndexCount = 0;
+
+	this->_cacheFile.close();
+	std::vector<PackedTerrainVertex>().swap(this->_packedVertices);
+	this->_chunkTree->releaseIndices();
+}
+
+Terrain::~Terrain()
+{
+	delete this->_chunkTree;
+	delete this->_heightPyramid;
+	delete this->_tileStreamer;
 }
 
 void Terrain::setupMesh()
@@ -343,25 +606,37 @@ void Terrain::setupMesh()
 
 	glGenBuffers(1, &this->_VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, this->_VBO);
-	glBufferData(GL_ARRAY_BUFFER, this->_vertices.size() * sizeof(TerrainVertex), &this->_vertices[0], GL_STATIC_DRAW);
+	// (dynamic: rows get rewritten when the terrain is deformed, see applyDisplacement())
+	glBufferData(GL_ARRAY_BUFFER, this->_meshVertexCount * sizeof(PackedTerrainVertex), this->_meshVertices, GL_DYNAMIC_DRAW);
 
+	// (position x/z and the texture coordinates are derived from gl_VertexID in terrain.vert)
 	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (void*)0);
+	glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(PackedTerrainVertex), (void*)0);
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (void*)offsetof(TerrainVertex, texture));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (void*)offsetof(TerrainVertex, normal));
+	glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedTerrainVertex), (void*)offsetof(PackedTerrainVertex, normal));
 	// normal texture mapping
-	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (void*)offsetof(TerrainVertex, tangent));
-	glEnableVertexAttribArray(4);
-	glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex), (void*)offsetof(TerrainVertex, normal));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(PackedTerrainVertex), (void*)offsetof(PackedTerrainVertex, tangent));
 	
 
 
 	glGenBuffers(1, &this->_EBO);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->_EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->_indices.size() * sizeof(unsigned int), &this->_indices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->_meshIndexCount * sizeof(unsigned int), this->_meshIndices, GL_STATIC_DRAW);
+}
+
+void Terrain::setupHeightMapTexture()
+{
+	// exact (unfiltered) heights of the grid so the vertex shader can look up the heights of the coarser LOD levels
+	glGenTextures(1, &this->_heightMapTextureId);
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, this->_heightMapTextureId);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, this->_width, this->_height, 0, GL_RED, GL_FLOAT, &this->_heightMap[0]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 }
 
 void Terrain::setupShader(const glm::vec3& sunPos, const glm::vec3& sunLightColor)
@@ -376,6 +651,12 @@ void Terrain::setupShader(const glm::vec3& sunPos, const glm::vec3& sunLightColo
 	this->_shader->setInt("material.normal", 2); // material (texture references) -- texture2
 	this->_shader->setVec3("material.specular", glm::vec3(0.949, 0.776, 0.431));
 	this->_shader->setFloat("material.shininess", 0.5f);
+	// LOD morphing
+	this->_shader->setInt("heightMapTex", 3); // texture3
+	this->_shader->setVec2("gridOffset", glm::vec2(this->_width / RESIZE_FACTOR, this->_height / RESIZE_FACTOR));
+	// compact vertex format (the grid size is set per draw, see render())
+	this->_shader->setFloat("texCoordDivisor", TEXTURE_DIV_SCALING);
+	this->_shader->setInt("tileStride", TerrainTileStreamer::getTileStride()); // (the edge is stitched to the tiles around it)
 	// light (sun)
 	this->_shader->setVec3("lightPos", sunPos);
 	this->_shader->setVec3("light.ambient", sunLightColor * 0.5f);
@@ -383,100 +664,15 @@ void Terrain::setupShader(const glm::vec3& sunPos, const glm::vec3& sunLightColo
 	this->_shader->setVec3("light.specular", sunLightColor * 0.00f);
 }
 
-std::pair<std::pair<glm::vec3, glm::vec3>, std::pair<glm::vec3, glm::vec3>> Terrain::computeTangentAndBitangentForTrianglePlane(
-	const glm::vec3& p1,
-	const glm::vec3& p2, 
-	const glm::vec3& p3, 
-	const glm::vec3& p4, 
-	const glm::vec2& uv1, 
-	const glm::vec2& uv2,
-	const glm::vec2& uv3, 
-	const glm::vec2& uv4)
-{
-	// triangle 1
-	glm::vec3 edge1 = p2 - p1;
-	glm::vec3 edge2 = p3 - p1;
-	glm::vec2 deltaUV1 = uv2 - uv1;
-	glm::vec2 deltaUV2 = uv3 - uv1;
-
-	float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-	glm::vec3 tangent1 = glm::vec3(
-		f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x),
-		f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y),
-		f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z)
-	);
-
-	glm::vec3 bitangent1 = glm::vec3(
-		f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x),
-		f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y),
-		f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z)
-	);
-
-	//triangle 2
-	edge1 = p3 - p1;
-	edge2 = p4 - p1;
-	deltaUV1 = uv3 - uv1;
-	deltaUV2 = uv4 - uv1;
-
-	f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-	glm::vec3 tangent2 = glm::vec3(
-		f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x),
-		f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y),
-		f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z)
-	);
-
-	glm::vec3 bitangent2 = glm::vec3(
-		f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x),
-		f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y),
-		f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z)
-	);
-
-	return {
-		{tangent1, bitangent1},
-		{tangent2, bitangent2}
-	};
-}
-
-std::tuple<glm::vec3, glm::vec3> Terrain::computeTangentAndBitangentForTriangle(
-	const glm::vec3& p1,
-	const glm::vec3& p2, 
-	const glm::vec3& p3, 
-	const glm::vec2& uv1, 
-	const glm::vec2& uv2, 
-	const glm::vec2& uv3)
-{
-	glm::vec3 edge1 = p2 - p1;
-	glm::vec3 edge2 = p3 - p1;
-	glm::vec2 deltaUV1 = uv2 - uv1;
-	glm::vec2 deltaUV2 = uv3 - uv1;
-
-	float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-	glm::vec3 tangent = glm::vec3(
-		f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x),
-		f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y),
-		f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z)
-	);
-
-	glm::vec3 bitangent = glm::vec3(
-		f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x),
-		f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y),
-		f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z)
-	);
-
-
-	return { tangent, bitangent };
-}
-
-void Terrain::render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos)
+void Terrain::render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos, CullingStats* cullingStats)
 {
 	this->_shader->use();
 	this->_shader->setMat4("view", view);
 	this->_shader->setMat4("projection", projection);
 	this->_shader->setVec3("viewPos", viewPos);
 
+	this->uploadDirtyRects();
+
 	DEBUG_RENDER_AS_MESH_CONFIG_PRE
 
 	glBindVertexArray(this->_VAO);
@@ -486,101 +682,339 @@ void Terrain::render(const glm::mat4& view, const glm::mat4& projection, const g
 	glBindTexture(GL_TEXTURE_2D, this->_textureId1);
 	glActiveTexture(GL_TEXTURE2);
 	glBindTexture(GL_TEXTURE_2D, this->_textureNormalId);
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, this->_heightMapTextureId);
+
+	this->_shader->setInt("gridWidth", this->_width);
+	this->_shader->setInt("gridStride", 1);
+	this->_shader->setInt("gridBorder", 0);
 
 	for (std::pair<glm::mat4, glm::mat3>& p : this->_renderMatrices)
 	{
 		this->_shader->setMat4("model", p.first);
 		this->_shader->setMat3("normalMatrix", p.second);
-		glDrawElements(GL_TRIANGLES, this->_indices.size(), GL_UNSIGNED_INT, 0);
+
+		// LOD selection happens in the local space of the terrain (= the space of the chunk bounds)
+		const glm::vec3 localViewPos = glm::vec3(glm::inverse(p.first) * glm::vec4(viewPos, 1.0f));
+		this->_shader->setVec3("lodCameraPos", localViewPos);
+		this->_chunkTree->select(localViewPos, ViewFrustum(projection * view * p.first), this->_lodDraws, cullingStats);
+
+		for (const TerrainChunkDraw& draw : this->_lodDraws)
+		{
+			this->_shader->setInt("lodStride", 1 << draw.level);
+			this->_shader->setFloat("lodMorphStart", this->_chunkTree->getMorphStart(draw.level));
+			this->_shader->setFloat("lodMorphEnd", this->_chunkTree->getMorphEnd(draw.level));
+			glDrawElements(GL_TRIANGLES, draw.indexCount, GL_UNSIGNED_INT, (void*)(draw.indexOffset * sizeof(unsigned int)));
+		}
 	}
 
+	// the surrounding tiles (same shader and textures, their own vertex buffers)
+	this->_tileStreamer->update(glm::vec3(glm::inverse(this->_terrainModel) * glm::vec4(viewPos, 1.0f)));
+	this->_tileStreamer->render(this->_shader, this->_terrainModel, projection * view, cullingStats);
+
 	glBindVertexArray(0);
 
 	DEBUG_RENDER_AS_MESH_CONFIG_POST
 }
 
-float _barycentricWeightPart1(float x0, float y0, float x1, float y1, float x2, float y2)
+/**
+ * The tiles around the terrain are built from _sourceHeightMap and never see any of this, on purpose: they're scenery, and this
+ * way the workers can keep reading it while the terrain changes (and tiles built before or after a change still agree).
+ * Only the edge of the grid has to match them (see snapToTileEdge() in terrain.vert), so the displacement fades out
+ * towards it and the edge vertices always keep their source heights.
+ */
+void Terrain::applyDisplacement(float x, float z, float radius, float amount, TerrainDisplacementProfile profile, float maxOffset)
 {
-	return (y1 - y2) * (x0 - x2) + (x2 - x1) * (y0 - y2);
+	if (!(radius > 0.0f) || amount == 0.0f) return;
+
+	// grid space, same as tryGetWorldHeightAt()
+	const float centerX = x + this->_width / RESIZE_FACTOR;
+	const float centerZ = z + this->_height / RESIZE_FACTOR;
+	const int x0 = std::max((int)std::ceil(centerX - radius), 0);
+	const int z0 = std::max((int)std::ceil(centerZ - radius), 0);
+	const int x1 = std::min((int)std::floor(centerX + radius), this->_width - 1);
+	const int z1 = std::min((int)std::floor(centerZ + radius), this->_height - 1);
+	if (x0 > x1 || z0 > z1) return; // entirely off grid
+
+	for (int gz = z0; gz <= z1; ++gz)
+	{
+		for (int gx = x0; gx <= x1; ++gx)
+		{
+			const float dx = (float)gx - centerX;
+			const float dz = (float)gz - centerZ;
+			const float t = std::sqrt(dx * dx + dz * dz) / radius;
+			if (t >= 1.0f) continue;
+
+			const float weight = (profile == TerrainDisplacementProfile::SMOOTH) ? 0.5f * (1.0f + std::cos(t * glm::pi<float>())) : 1.0f - t;
+			const int toEdge = std::min(std::min(gx, this->_width - 1 - gx), std::min(gz, this->_height - 1 - gz));
+			const float edgeFade = std::min((float)toEdge / DISPLACEMENT_EDGE_FADE, 1.0f);
+
+			const size_t index = gx + (size_t)this->_width * gz;
+			const float source = this->_sourceHeightMap[index];
+			this->_heightMap[index] = std::clamp(this->_heightMap[index] + amount * weight * edgeFade, source - maxOffset, source + maxOffset);
+		}
+	}
+
+	// raycasts need to see this right away, the pyramid is cheap to patch up
+	this->_heightPyramid->update(x0, z0, x1, z1);
+
+	// the normals of the vertices right around the changed ones change as well (central differences)
+	const TerrainGridRect changed = {
+		std::max(x0 - 1, 0),
+		std::max(z0 - 1, 0),
+		std::min(x1 + 1, this->_width - 1),
+		std::min(z1 + 1, this->_height - 1)
+	};
+
+	// merged per block of the grid, so two stamps far apart don't turn into one rect covering everything in between
+	for (int blockZ = changed.z0 / DIRTY_BLOCK_SIZE; blockZ <= changed.z1 / DIRTY_BLOCK_SIZE; ++blockZ)
+	{
+		for (int blockX = changed.x0 / DIRTY_BLOCK_SIZE; blockX <= changed.x1 / DIRTY_BLOCK_SIZE; ++blockX)
+		{
+			const TerrainGridRect inBlock = {
+				std::max(changed.x0, blockX * DIRTY_BLOCK_SIZE),
+				std::max(changed.z0, blockZ * DIRTY_BLOCK_SIZE),
+				std::min(changed.x1, (blockX + 1) * DIRTY_BLOCK_SIZE - 1),
+				std::min(changed.z1, (blockZ + 1) * DIRTY_BLOCK_SIZE - 1)
+			};
+			const auto [entry, isNew] = this->_dirtyRects.try_emplace({ blockX, blockZ }, inBlock);
+			if (isNew) continue;
+
+			TerrainGridRect& dirty = entry->second;
+			dirty.x0 = std::min(dirty.x0, inBlock.x0);
+			dirty.z0 = std::min(dirty.z0, inBlock.z0);
+			dirty.x1 = std::max(dirty.x1, inBlock.x1);
+			dirty.z1 = std::max(dirty.z1, inBlock.z1);
+		}
+	}
 }
 
-float _barycentricWeightPart2(float x0, float y0, float x1, float y1, float x2, float y2)
+/**
+ * Brings the GPU copies (vertex buffer, height map texture) and the chunk bounds up to date with all of the
+ * applyDisplacement() calls since the last frame. Only the vertices of the dirty rects are repacked, every row of
+ * a rect goes up with its own glBufferSubData (the rows of a rect aren't contiguous in the buffer).
+ */
+void Terrain::uploadDirtyRects()
 {
-	return (y2 - y1) * (x0 - x2) + (x1 - x2) * (y0 - y2);
+	if (this->_dirtyRects.empty()) return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, this->_VBO);
+	// the heights of the coarser LOD levels are looked up from this one
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, this->_heightMapTextureId);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, this->_width);
+
+	for (const auto& [block, dirty] : this->_dirtyRects)
+	{
+		const int columnCount = dirty.x1 - dirty.x0 + 1;
+		this->_dirtyRows.resize(columnCount);
+		for (int z = dirty.z0; z <= dirty.z1; ++z)
+		{
+			this->packVertexRow(z, dirty.x0, dirty.x1 + 1, this->_dirtyRows.data());
+			const size_t firstVertex = (size_t)this->_width * z + dirty.x0;
+			glBufferSubData(GL_ARRAY_BUFFER, firstVertex * sizeof(PackedTerrainVertex), columnCount * sizeof(PackedTerrainVertex), this->_dirtyRows.data());
+		}
+
+		const size_t firstVertex = (size_t)this->_width * dirty.z0 + dirty.x0;
+		glTexSubImage2D(GL_TEXTURE_2D, 0, dirty.x0, dirty.z0, columnCount, dirty.z1 - dirty.z0 + 1, GL_RED, GL_FLOAT, &this->_heightMap[firstVertex]);
+
+		this->_chunkTree->updateBounds(dirty.x0, dirty.z0, dirty.x1, dirty.z1, this->_heightMap);
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	this->_dirtyRects.clear();
 }
 
-float _barycentricWeightPart3(float x0, float y0, float x1, float y1, float x2, float y2)
+/**
+ * Height (and slope) inside one grid cell. (fx, fz) is the position inside the cell in [0, 1].
+ * The cell is split along the 1-2 diagonal, same as the mesh (see TerrainChunkTree::appendQuadrantIndices):
+ *                  0---2
+ *                  | / |
+ *                  1---3
+ * fx + fz < 1 is triangle <0, 1, 2>, everything else is triangle <1, 3, 2>.
+ * Interpolating over the triangle then just boils down to walking along its two legs.
+ */
+static void _sampleTerrainCell(float h0, float h1, float h2, float h3, float fx, float fz, float& outHeight, float& outDhDx, float& outDhDz)
 {
-	return (y1 - y2) * (x0 - x2) + (x2 - x1) * (y0 - y2);
+	if (fx + fz < 1.0f)
+	{
+		outDhDx = h2 - h0;
+		outDhDz = h1 - h0;
+		outHeight = h0 + fx * outDhDx + fz * outDhDz;
+	}
+	else
+	{
+		outDhDx = h3 - h1;
+		outDhDz = h3 - h2;
+		outHeight = h3 - (1.0f - fx) * outDhDx - (1.0f - fz) * outDhDz;
+	}
 }
 
-float Terrain::getWorldHeightAt(float x, float z) const
+static glm::vec3 _slopeToNormal(float dhdx, float dhdz)
 {
-	constexpr float allowedError = 0.001f;
+	// cross product of the two legs (1, dhdx, 0) and (0, dhdz, 1), one grid step is one world unit
+	return glm::normalize(glm::vec3(-dhdx, 1.0f, -dhdz));
+}
 
+TerrainQueryStatus Terrain::tryGetWorldHeightAt(float x, float z, float& outHeight, glm::vec3* outNormal) const
+{
 	const float xIndex = x + this->_width / RESIZE_FACTOR;
 	const float zIndex = z + this->_height / RESIZE_FACTOR;
 
-	const float xFloor = std::floor(xIndex);
-	const float zFloor = std::floor(zIndex);
+	// written so that NaN ends up off grid as well
+	if (!(xIndex >= 0.0f && xIndex <= (float)(this->_width - 1) && zIndex >= 0.0f && zIndex <= (float)(this->_height - 1)))
+	{
+		outHeight = 0.0f;
+		if (outNormal) *outNormal = glm::vec3(0.0f, 1.0f, 0.0f);
+		return TerrainQueryStatus::OFF_GRID;
+	}
+
+	// points on the last row/column use the cell before them (at fx/fz = 1)
+	const int x0 = std::min((int)xIndex, this->_width - 2);
+	const int z0 = std::min((int)zIndex, this->_height - 2);
+	const int index0 = x0 + this->_width * z0;
+
+	float dhdx;
+	float dhdz;
+	_sampleTerrainCell(
+		this->_heightMap[index0],
+		this->_heightMap[index0 + this->_width],
+		this->_heightMap[index0 + 1],
+		this->_heightMap[index0 + this->_width + 1],
+		xIndex - (float)x0,
+		zIndex - (float)z0,
+		outHeight, dhdx, dhdz);
+
+	if (outNormal) *outNormal = _slopeToNormal(dhdx, dhdz);
+	return TerrainQueryStatus::OK;
+}
+
+size_t Terrain::getWorldHeightsAt(const float* xs, const float* zs, size_t count, float* outHeights, TerrainQueryStatus* outStatus, glm::vec3* outNormals) const
+{
+	size_t offGridCount = 0;
+	size_t i = 0;
+
+#if USE_SSE2
+	// 4 points at a time. Only the height fetches stay scalar (no gather before AVX2), the cell lookup,
+	// the triangle selection and the interpolation all happen in SSE2 registers
+	const __m128 halfWidth = _mm_set1_ps(this->_width / RESIZE_FACTOR);
+	const __m128 halfHeight = _mm_set1_ps(this->_height / RESIZE_FACTOR);
+	const __m128 maxX = _mm_set1_ps((float)(this->_width - 1));
+	const __m128 maxZ = _mm_set1_ps((float)(this->_height - 1));
+	const __m128 maxCellX = _mm_set1_ps((float)(this->_width - 2));
+	const __m128 maxCellZ = _mm_set1_ps((float)(this->_height - 2));
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	alignas(16) int cellXs[4], cellZs[4];
+	alignas(16) float h0[4], h1[4], h2[4], h3[4];
+	alignas(16) float dhdxOut[4], dhdzOut[4];
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 xIndex = _mm_add_ps(_mm_loadu_ps(xs + i), halfWidth);
+		const __m128 zIndex = _mm_add_ps(_mm_loadu_ps(zs + i), halfHeight);
+
+		// ordered compares are false for NaN, so those end up off grid too
+		const __m128 onGrid = _mm_and_ps(
+			_mm_and_ps(_mm_cmpge_ps(xIndex, zero), _mm_cmple_ps(xIndex, maxX)),
+			_mm_and_ps(_mm_cmpge_ps(zIndex, zero), _mm_cmple_ps(zIndex, maxZ)));
+		const int onGridMask = _mm_movemask_ps(onGrid);
+
+		// off grid lanes get clamped, so they still read valid memory; their result is masked away below
+		const __m128 xClamped = _mm_min_ps(_mm_max_ps(xIndex, zero), maxX);
+		const __m128 zClamped = _mm_min_ps(_mm_max_ps(zIndex, zero), maxZ);
+		const __m128 x0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(xClamped)), maxCellX);
+		const __m128 z0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(zClamped)), maxCellZ);
+		const __m128 fx = _mm_sub_ps(xClamped, x0);
+		const __m128 fz = _mm_sub_ps(zClamped, z0);
+
+		// the cell index itself is computed in integers: a float only holds every integer up to 2^24, which a 4097x4097 map already goes past
+		// (and SSE2 has no 32 bit integer multiply, so that part is per lane)
+		_mm_store_si128((__m128i*)cellXs, _mm_cvttps_epi32(x0));
+		_mm_store_si128((__m128i*)cellZs, _mm_cvttps_epi32(z0));
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			const float* cell = this->_heightMap.data() + (size_t)cellZs[lane] * this->_width + cellXs[lane];
+			h0[lane] = cell[0];
+			h1[lane] = cell[this->_width];
+			h2[lane] = cell[1];
+			h3[lane] = cell[this->_width + 1];
+		}
+		const __m128 v0 = _mm_load_ps(h0);
+		const __m128 v1 = _mm_load_ps(h1);
+		const __m128 v2 = _mm_load_ps(h2);
+		const __m128 v3 = _mm_load_ps(h3);
+
+		// both triangles for all lanes, then pick per lane (see _sampleTerrainCell for the scalar version)
+		const __m128 lowerTriangle = _mm_cmplt_ps(_mm_add_ps(fx, fz), one);
+		const __m128 dhdx = _mm_or_ps(_mm_and_ps(lowerTriangle, _mm_sub_ps(v2, v0)), _mm_andnot_ps(lowerTriangle, _mm_sub_ps(v3, v1)));
+		const __m128 dhdz = _mm_or_ps(_mm_and_ps(lowerTriangle, _mm_sub_ps(v1, v0)), _mm_andnot_ps(lowerTriangle, _mm_sub_ps(v3, v2)));
+		const __m128 lowerHeight = _mm_add_ps(_mm_add_ps(v0, _mm_mul_ps(fx, dhdx)), _mm_mul_ps(fz, dhdz));
+		const __m128 upperHeight = _mm_sub_ps(_mm_sub_ps(v3, _mm_mul_ps(_mm_sub_ps(one, fx), dhdx)), _mm_mul_ps(_mm_sub_ps(one, fz), dhdz));
+		const __m128 height = _mm_or_ps(_mm_and_ps(lowerTriangle, lowerHeight), _mm_andnot_ps(lowerTriangle, upperHeight));
+
+		_mm_storeu_ps(outHeights + i, _mm_and_ps(onGrid, height));
+
+		if (outNormals)
+		{
+			_mm_store_ps(dhdxOut, dhdx);
+			_mm_store_ps(dhdzOut, dhdz);
+		}
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			const bool laneOnGrid = (onGridMask >> lane) & 1;
+			if (!laneOnGrid) offGridCount++;
+			if (outStatus) outStatus[i + lane] = laneOnGrid ? TerrainQueryStatus::OK : TerrainQueryStatus::OFF_GRID;
+			if (outNormals) outNormals[i + lane] = laneOnGrid ? _slopeToNormal(dhdxOut[lane], dhdzOut[lane]) : glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+	}
+#endif
+
+	// whatever doesn't fill up a full SIMD batch
+	for (; i < count; ++i)
+	{
+		const TerrainQueryStatus status = this->tryGetWorldHeightAt(xs[i], zs[i], outHeights[i], outNormals ? &outNormals[i] : nullptr);
+		if (status != TerrainQueryStatus::OK) offGridCount++;
+		if (outStatus) outStatus[i] = status;
+	}
 
-	const int xFloorInt0 = (int)xFloor;
-	const int zFloorInt0 = (int)zFloor;
+	return offGridCount;
+}
 
-	if (xFloor < 0 || xFloor >= this->_width || zFloor < 0 || zFloor >= this->_height)
+float Terrain::getWorldHeightAt(float x, float z) const
+{
+	float height;
+	if (this->tryGetWorldHeightAt(x, z, height) != TerrainQueryStatus::OK)
 		throw std::exception("Invalid player position (not on grid)"); // must actually be within the map
+	return height;
+}
+
+std::optional<TerrainRayHit> Terrain::raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDist) const
+{
+	const float dirLength = glm::length(dir);
+	if (dirLength == 0.0f || maxDist <= 0.0f) return std::nullopt;
+	const glm::vec3 unitDir = dir / dirLength;
+
+	// the pyramid works in grid space, which is just the world shifted by half the grid (same as getWorldHeightAt)
+	const glm::vec3 gridOffset(this->_width / RESIZE_FACTOR, 0.0f, this->_height / RESIZE_FACTOR);
 
-	// assume that we are standing exactly on the vertex
-	if (fabs(xIndex - xFloor) < allowedError && fabs(zIndex - zFloor) < allowedError)
-		return this->getWorldHeight(xFloorInt0, zFloorInt0); // resulting value is already scaled/transformed to world scale
-
-	// otherwise we will interpolate the appropriate height across the triangle.
-	// (Barycentric Coordinates solution)
-
-	// which triangle?
-	//                  0---2   triangle 1
-	//                  | / |
-	//                  1----
-	// or
-	//                  ----2   triangle 2
-	//                  | / |
-	//                  1---3
-	// we compute to what side of the line splitting the 2 triangles our point
-	// (xIndex, zIndex) lies, using the dot products of "1" and "2"
-	const int xFloor1 = xFloorInt0;
-	const int zFloor1 = zFloorInt0 + 1;
-	const int xFloor2 = xFloorInt0 + 1;
-	const int zFloor2 = zFloorInt0;
-
-
-	const float d = (xIndex - xFloor1) * (zFloor2 - zFloor1) - (zIndex - zFloor1) * (xFloor2 - xFloor1);
-	// (d <= 0) -> triangle 1
-	// (d > 0)  -> triangle 2
-
-	// interpolate height (= y coordinate) across the triangle
-	// (mainly referenced this article https://codeplea.com/triangular-interpolation
-	// while implementing but obviously I have read about them separately before)
-
-	// choose triangle 1 (vertex "0") or triangle 2 (vertex "3")
-	const int xFloorOpt = d > 0 ? xFloorInt0 : (xFloorInt0 + 1);
-	const int zFloorOpt = d > 0 ? zFloorInt0 : (zFloorInt0 + 1);
-
-	// get weights (how much every vertex will "contribute" to the final "height" that a point on this triangle should be at)
-	float w1 = _barycentricWeightPart1(xIndex, zIndex, xFloor1, zFloor1, xFloor2, zFloor2)
-				/ _barycentricWeightPart1(xFloorOpt, zFloorOpt, xFloor1, zFloor1, xFloor2, zFloor2);
-
-	float w2 = _barycentricWeightPart2(xIndex, zIndex, xFloorOpt, zFloorOpt, xFloor2, zFloor2)
-				/ _barycentricWeightPart3(xFloorOpt, zFloorOpt, xFloor1, zFloor1, xFloor2, zFloor2);
-
-	float w3 = 1 - w1 - w2;
-
-	if (w1 < 0 || w2 < 0 || w3 < 0)
-		throw std::exception("Point is not inside triangle!");
-
-	// apply weights to results
-	return (w1 * this->getWorldHeight(xFloorOpt, zFloorOpt))
-		+ (w2 * this->getWorldHeight(xFloor1, zFloor1))
-		+ (w3 * this->getWorldHeight(xFloor2, zFloor2));
+	float distance;
+	glm::vec3 normal;
+	if (!this->_heightPyramid->intersect(origin + gridOffset, unitDir, maxDist, distance, normal)) return std::nullopt;
+
+	return TerrainRayHit{ origin + unitDir * distance, normal, distance };
+}
+
+size_t Terrain::raycast(const TerrainRay* rays, size_t count, std::optional<TerrainRayHit>* outHits) const
+{
+	size_t hitCount = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		outHits[i] = this->raycast(rays[i].origin, rays[i].dir, rays[i].maxDist);
+		if (outHits[i].has_value()) hitCount++;
+	}
+	return hitCount;
 }
 
 glm::vec3 Terrain::getWorldHeightVecFor(float x, float z) const
@@ -1,41 +1,151 @@
 #ifndef TERRAIN_MINE_H
 #define TERRAIN_MINE_H
+#include <cfloat>
+#include <cstdint>
+#include <map>
+#include <optional>
 #include <string>
 #include <vector>
 #include <glm/glm.hpp>
 
+#include "MappedFile.h"
 #include "Shader.h"
+#include "TerrainChunkTree.h"
+#include "TerrainHeightPyramid.h"
 
-struct TerrainVertex
+/**
+ * \brief What ends up in the vertex buffer (and the cache), 12 bytes per vertex.
+ *
+ * x/z follow from the grid index (gl_VertexID) and the texture coordinates from x/z, so only the height is stored.
+ * The normal and tangent are octahedral encoded unit vectors as 2 x snorm16 each.
+ * No bitangent: terrain.vert rebuilds it as cross(N, T).
+ */
+struct PackedTerrainVertex
 {
-	glm::vec3 pos;
-	glm::vec2 texture;
-	glm::vec3 normal = glm::vec3(0.0f);
-	glm::vec3 tangent = glm::vec3(0.0f);
-	glm::vec3 biTangent = glm::vec3(0.0f);
+	float height;
+	int16_t normal[2];
+	int16_t tangent[2];
+};
+static_assert(sizeof(PackedTerrainVertex) == 12, "PackedTerrainVertex must stay tightly packed for the vertex buffer");
+
+/**
+ * \brief Octahedral encoding of a unit vector into 2 x snorm16 (see PackedTerrainVertex)
+ */
+void octEncodeUnitVector(const glm::vec3& v, int16_t out[2]);
+
+class TerrainTileStreamer;
+
+enum class TerrainQueryStatus
+{
+	OK,
+	OFF_GRID // (x, z) is outside of the height map, the height is reported as 0 and the normal as straight up
+};
+
+struct TerrainRay
+{
+	glm::vec3 origin;
+	glm::vec3 dir; // does not need to be normalized
+	float maxDist;
+};
+
+struct TerrainRayHit
+{
+	glm::vec3 position;
+	glm::vec3 normal; // of the triangle that was hit
+	float distance; // along the (normalized) ray direction
+};
+
+enum class TerrainDisplacementProfile
+{
+	SMOOTH, // cosine falloff from the center to the radius (trails, footprints)
+	CONE // linear falloff from the center to the radius
+};
+
+/**
+ * \brief Inclusive rect of grid vertices
+ */
+struct TerrainGridRect
+{
+	int x0;
+	int z0;
+	int x1;
+	int z1;
 };
 
 
 class Terrain
 {
 public:
+	/**
+	 * \param textureId0			base color (sRGB if USE_SRGB_COLORS)
+	 * \param textureId1			darker base color (^)
+	 * \param textureNormalId		normal map
+	 */
 	Terrain(
 		Shader* shader, 
 		const std::string& sourceHeightMapPath, 
-		const std::string& texturePath0, 
-		const std::string& texturePath1,
-		const std::string& textureNormalMap,
+		unsigned int textureId0,
+		unsigned int textureId1,
+		unsigned int textureNormalId,
 		float yScaleMult, 
 		float yShift,
 		const glm::vec3& sunPos,
 		const glm::vec3& sunLightColor);
+	~Terrain();
+
+	Terrain(const Terrain&) = delete;
+	Terrain& operator=(const Terrain&) = delete;
+
+	/**
+	 * \brief Offline "cook" step: makes sure the binary cache of the finished mesh for this height map is up to date
+	 * (without needing an OpenGL context). The constructor picks this cache up instead of regenerating everything from the image.
+	 */
+	static void cookCache(const std::string& sourceHeightMapPath, float yScaleMult, float yShift);
 
 	/**
-	 * \brief render mesh strip by strip
+	 * \brief render the chunks picked by the LOD quadtree (see TerrainChunkTree). Chunks outside of the view frustum are skipped.
+	 * Also streams in and draws the tiles around this terrain (see TerrainTileStreamer).
 	 */
-	void render(const glm::mat4&view, const glm::mat4& projection, const glm::vec3& viewPos);
+	void render(const glm::mat4&view, const glm::mat4& projection, const glm::vec3& viewPos, CullingStats* cullingStats = nullptr);
 
+	/**
+	 * \brief Raises (amount > 0) or lowers (amount < 0) the terrain in a circle around (x, z), scaled by the falloff profile.
+	 * Height queries and raycasts see the change right away. The GPU side is only brought up to date at the next render(),
+	 * with the edits of the frame merged into one dirty rect per block of the grid, and only the vertices in those uploaded.
+	 * The tiles around the terrain keep the original heights, so the displacement fades out towards the edge of the grid.
+	 *
+	 * \param maxOffset		how far any height may end up from its original height (either way), over all calls together
+	 */
+	void applyDisplacement(float x, float z, float radius, float amount, TerrainDisplacementProfile profile = TerrainDisplacementProfile::SMOOTH, float maxOffset = FLT_MAX);
+
+	/**
+	 * \brief Same as tryGetWorldHeightAt() but throws if the point is off grid.
+	 */
 	float getWorldHeightAt(float x, float z) const;
+	/**
+	 * \brief Interpolated height (and optionally the surface normal) of the triangle under (x, z). Never throws.
+	 */
+	TerrainQueryStatus tryGetWorldHeightAt(float x, float z, float& outHeight, glm::vec3* outNormal = nullptr) const;
+	/**
+	 * \brief Batched version of tryGetWorldHeightAt(): all arrays hold count elements. Runs 4 points at a time with SSE2 if available.
+	 *
+	 * \param outStatus		may be nullptr if the caller only needs the returned count
+	 * \param outNormals		may be nullptr if not needed
+	 * \return number of points that were off grid (so 0 means all results are valid)
+	 */
+	size_t getWorldHeightsAt(const float* xs, const float* zs, size_t count, float* outHeights, TerrainQueryStatus* outStatus = nullptr, glm::vec3* outNormals = nullptr) const;
+
+	/**
+	 * \brief Where the ray first hits the terrain surface (the full resolution triangles), if within maxDist.
+	 * Uses a min/max height pyramid (see TerrainHeightPyramid), so empty space is skipped in large steps.
+	 */
+	std::optional<TerrainRayHit> raycast(const glm::vec3& origin, const glm::vec3& dir, float maxDist) const;
+	/**
+	 * \brief Batched raycast() (picking, line-of-sight checks, ...). outHits must hold count elements.
+	 *
+	 * \return number of rays that hit the terrain
+	 */
+	size_t raycast(const TerrainRay* rays, size_t count, std::optional<TerrainRayHit>* outHits) const;
 	/**
 	 * \brief Will produce a vector [x, y, z] by using getWorldHeightAt(x, z) for y.
 	 */
@@ -47,15 +157,31 @@ private:
 	int _width;
 	int _height;
 	std::vector<float> _heightMap;
+	std::vector<float> _sourceHeightMap; // _heightMap before any applyDisplacement(), the tiles are built from this one
 
-	std::vector<TerrainVertex> _vertices;
-	std::vector<unsigned int> _indices;
+	std::vector<PackedTerrainVertex> _packedVertices;
+
+	// mesh data waiting to be uploaded: points into either the cache file or _packedVertices/_chunkTree (see releaseMeshSource())
+	MappedFile _cacheFile;
+	const PackedTerrainVertex* _meshVertices = nullptr;
+	size_t _meshVertexCount = 0;
+	const unsigned int* _meshIndices = nullptr;
+	size_t _meshIndexCount = 0;
 	unsigned int _VAO;
 	unsigned int _VBO;
 	unsigned int _EBO;
 	unsigned int _textureId0;
 	unsigned int _textureId1;
 	unsigned int _textureNormalId;
+	unsigned int _heightMapTextureId; // used by terrain.vert for morphing between LOD levels
+
+	TerrainChunkTree* _chunkTree;
+	TerrainHeightPyramid* _heightPyramid; // for raycast()
+	TerrainTileStreamer* _tileStreamer; // the (mirrored) world around the terrain
+	std::vector<TerrainChunkDraw> _lodDraws; // reused every frame
+
+	std::map<std::pair<int, int>, TerrainGridRect> _dirtyRects; // vertices changed by applyDisplacement() since the last upload, by block of the grid
+	std::vector<PackedTerrainVertex> _dirtyRows; // reused for every upload (one row of a rect at a time)
 
 	glm::mat4 _terrainModel;
 	glm::mat3 _terrainNormalMatrix;
@@ -77,56 +203,30 @@ private:
 	glm::mat3 _terrainNormalMatrixRB;
 	std::vector<std::pair<glm::mat4, glm::mat3>> _renderMatrices;
 
-	void populateModelMatrices();
+	/**
+	 * \brief Only sets up the CPU side data (everything that's stored in the cache), no OpenGL calls
+	 */
+	Terrain(const std::string& sourceHeightMapPath, float yScaleMult, float yShift);
 
-	float getWorldHeight(int x, int z) const;
+	void generateFromHeightMap(const std::string& sourceHeightMapPath, float yScaleMult, float yShift);
+	bool loadFromCache(const std::string& cachePath, const std::string& sourceHeightMapPath, float yScaleMult, float yShift);
+	void writeCache(const std::string& cachePath, const std::string& sourceHeightMapPath, float yScaleMult, float yShift) const;
+	void releaseMeshSource();
 
-	void generateVerticesFromHeightMap(unsigned short* data, int nChannels, float yScale, float yShift);
-	void mapTriangles();
-	void insertNormContribution(unsigned int index0, unsigned int index1, unsigned int index2);
-	void insertTangentAndBitangentContribution(unsigned int index0, unsigned int index1, unsigned int index2, unsigned int index3);
-	void setupMesh();
-	void setupShader(const glm::vec3& sunPos, const glm::vec3& sunLightColor);
+	void populateModelMatrices();
 
-	/**
-	 * \brief Essentially this: https://learnopengl.com/Advanced-Lighting/Normal-Mapping
-	 *
-	 * Pair of two tangent-bitangent pairs. For both triangles respectively.
-	 *
-	 * We assume clockwise ordering here for the triangle vertices and we compute for the following 2 triangles:
-	 * - triangle: <1, 2, 3>
-	 * - triangle: <1, 3, 4>
-	 */
-	static std::pair<std::pair<glm::vec3, glm::vec3>, std::pair<glm::vec3, glm::vec3>> computeTangentAndBitangentForTrianglePlane(
-		const glm::vec3& p1,
-		const glm::vec3& p2,
-		const glm::vec3& p3,
-		const glm::vec3& p4,
-		const glm::vec2& uv1,
-		const glm::vec2& uv2,
-		const glm::vec2& uv3,
-		const glm::vec2& uv4
-	);
+	float getWorldHeight(int x, int z) const;
 
 	/**
-	 * \brief Essentially this: https://learnopengl.com/Advanced-Lighting/Normal-Mapping
-	 *
-	 * Produces a pair of two tangent-bitangent for a single triangle.
-	 *
-	 * We assume clockwise ordering here for the triangle vertices and we compute for the following triange <1, 2, 3>:
-	 * 
-	 *                  1---3
-	 *                  | / |
-	 *                  2----
+	 * \brief The vertex generation steps below work on vertex rows independently, so they can run in parallel
 	 */
-	static std::tuple<glm::vec3, glm::vec3> computeTangentAndBitangentForTriangle(
-		const glm::vec3& p1,
-		const glm::vec3& p2,
-		const glm::vec3& p3,
-		const glm::vec2& uv1,
-		const glm::vec2& uv2,
-		const glm::vec2& uv3
-	);
+	void generateHeightsFromHeightMap(unsigned short* data, int nChannels, float yScale, float yShift, unsigned int zBegin, unsigned int zEnd);
+	void packVertexRow(unsigned int z, int xBegin, int xEnd, PackedTerrainVertex* out) const;
+	void verifyPackedVertices() const;
+	void uploadDirtyRects();
+	void setupMesh();
+	void setupHeightMapTexture();
+	void setupShader(const glm::vec3& sunPos, const glm::vec3& sunLightColor);
 };
 
 #endif
\ No newline at end of file
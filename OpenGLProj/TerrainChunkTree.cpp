@@ -0,0 +1,270 @@
+#include "TerrainChunkTree.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <glm/glm.hpp>
+
+constexpr auto CHUNK_QUADS = 32; // size (in grid quads) of a full resolution leaf node
+constexpr auto LOD_BASE_RANGE = 96.0f; // view range of the full resolution level. Doubles with every level
+constexpr auto MORPH_START_RATIO = 0.66f; // where in between two ranges the morphing into the coarser level starts
+
+TerrainChunkTree::TerrainChunkTree(int width, int height, const std::vector<float>& heightMap, const glm::vec2& localOrigin)
+:
+_width(width),
+_height(height),
+_localOrigin(localOrigin)
+{
+	this->setupLevels();
+	this->buildNode(0, 0, CHUNK_QUADS * (1 << (this->_levelCount - 1)), this->_levelCount - 1, heightMap);
+}
+
+TerrainChunkTree::TerrainChunkTree(int width, int height, const glm::vec2& localOrigin, std::vector<TerrainChunkNode>&& nodes)
+:
+_width(width),
+_height(height),
+_localOrigin(localOrigin),
+_nodes(std::move(nodes))
+{
+	this->setupLevels();
+}
+
+void TerrainChunkTree::setupLevels()
+{
+	// the root node must cover the entire grid. Every level up doubles the node size
+	const int gridQuads = std::max(this->_width - 1, this->_height - 1);
+	this->_levelCount = 1;
+	while (CHUNK_QUADS * (1 << (this->_levelCount - 1)) < gridQuads) this->_levelCount++;
+
+	// the top level is always visible (it's the fallback for everything too far away)
+	float prevRange = 0.0f;
+	for (int level = 0; level < this->_levelCount; ++level)
+	{
+		const float range = (level == this->_levelCount - 1) ? FLT_MAX : LOD_BASE_RANGE * (float)(1 << level);
+		this->_lodRanges.push_back(range);
+		this->_morphStarts.push_back(prevRange + (range - prevRange) * MORPH_START_RATIO);
+		prevRange = range;
+	}
+}
+
+int TerrainChunkTree::buildNode(int x0, int z0, int size, int level, const std::vector<float>& heightMap)
+{
+	if (x0 >= this->_width - 1 || z0 >= this->_height - 1) return -1; // entirely outside of the grid
+
+	// careful: _nodes grows in the recursive calls below, so no references into it are kept around
+	const int nodeIndex = (int)this->_nodes.size();
+	this->_nodes.emplace_back();
+
+	TerrainChunkNode node;
+	node.x0 = x0;
+	node.z0 = z0;
+	node.size = size;
+	node.level = level;
+
+	// bounds
+	if (level == 0)
+	{
+		this->computeLeafBounds(node, heightMap);
+	}
+	else
+	{
+		// parent bounds are just the union of the children
+		const int half = size / 2;
+		node.aabbMin = glm::vec3(FLT_MAX);
+		node.aabbMax = glm::vec3(-FLT_MAX);
+		for (int q = 0; q < 4; ++q)
+		{
+			const int child = this->buildNode(x0 + (q % 2) * half, z0 + (q / 2) * half, half, level - 1, heightMap);
+			node.children[q] = child;
+			if (child == -1) continue;
+			node.aabbMin = glm::min(node.aabbMin, this->_nodes[child].aabbMin);
+			node.aabbMax = glm::max(node.aabbMax, this->_nodes[child].aabbMax);
+		}
+	}
+
+	// triangles, stored per quadrant
+	const int half = size / 2;
+	const int stride = 1 << level;
+	node.indexOffset = (unsigned int)this->_indices.size();
+	for (int q = 0; q < 4; ++q)
+		node.quadrantIndexCount[q] = this->appendQuadrantIndices(x0 + (q % 2) * half, z0 + (q / 2) * half, half, stride);
+
+	this->_nodes[nodeIndex] = node;
+	return nodeIndex;
+}
+
+void TerrainChunkTree::computeLeafBounds(TerrainChunkNode& node, const std::vector<float>& heightMap) const
+{
+	const int x1 = std::min(node.x0 + node.size, this->_width - 1);
+	const int z1 = std::min(node.z0 + node.size, this->_height - 1);
+	float minY = FLT_MAX;
+	float maxY = -FLT_MAX;
+	for (int z = node.z0; z <= z1; ++z)
+	{
+		for (int x = node.x0; x <= x1; ++x)
+		{
+			const float y = heightMap[x + this->_width * z];
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+		}
+	}
+	node.aabbMin = glm::vec3(this->_localOrigin.x + node.x0, minY, this->_localOrigin.y + node.z0);
+	node.aabbMax = glm::vec3(this->_localOrigin.x + x1, maxY, this->_localOrigin.y + z1);
+}
+
+unsigned int TerrainChunkTree::appendQuadrantIndices(int x0, int z0, int size, int stride)
+{
+	if (x0 >= this->_width - 1 || z0 >= this->_height - 1) return 0;
+
+	// when the grid is not a multiple of the stride the last row/column is clamped to the edge of the grid
+	auto gridSteps = [stride](int from, int to)
+	{
+		std::vector<int> steps;
+		for (int v = from; v < to; v += stride) steps.push_back(v);
+		steps.push_back(to);
+		return steps;
+	};
+	const std::vector<int> xs = gridSteps(x0, std::min(x0 + size, this->_width - 1));
+	const std::vector<int> zs = gridSteps(z0, std::min(z0 + size, this->_height - 1));
+
+	const size_t startSize = this->_indices.size();
+	for (size_t i = 0; i + 1 < zs.size(); ++i)
+	{
+		for (size_t j = 0; j + 1 < xs.size(); ++j)
+		{
+			// the triangle layout every other part of the terrain assumes (height queries, raycasts, streamed tiles)
+			//                  0---2
+			//                  | / |
+			//                  1---3
+			const unsigned int index0 = xs[j] + (this->_width * zs[i]);
+			const unsigned int index1 = xs[j] + (this->_width * zs[i + 1]);
+			const unsigned int index2 = xs[j + 1] + (this->_width * zs[i]);
+			const unsigned int index3 = xs[j + 1] + (this->_width * zs[i + 1]);
+			this->_indices.push_back(index0);
+			this->_indices.push_back(index1);
+			this->_indices.push_back(index2);
+			this->_indices.push_back(index1);
+			this->_indices.push_back(index3);
+			this->_indices.push_back(index2);
+		}
+	}
+	return (unsigned int)(this->_indices.size() - startSize);
+}
+
+void TerrainChunkTree::updateBounds(int x0, int z0, int x1, int z1, const std::vector<float>& heightMap)
+{
+	if (this->_nodes.empty()) return;
+	this->refitNode(0, x0, z0, x1, z1, heightMap);
+}
+
+void TerrainChunkTree::refitNode(int nodeIndex, int x0, int z0, int x1, int z1, const std::vector<float>& heightMap)
+{
+	TerrainChunkNode& node = this->_nodes[nodeIndex];
+	// nodes share their edge vertices, hence the inclusive test
+	if (node.x0 > x1 || node.x0 + node.size < x0 || node.z0 > z1 || node.z0 + node.size < z0) return;
+
+	if (node.level == 0)
+	{
+		this->computeLeafBounds(node, heightMap);
+		return;
+	}
+
+	// the untouched children still have valid bounds, so the union is simply redone over all four
+	node.aabbMin = glm::vec3(FLT_MAX);
+	node.aabbMax = glm::vec3(-FLT_MAX);
+	for (int q = 0; q < 4; ++q)
+	{
+		const int child = node.children[q];
+		if (child == -1) continue;
+		this->refitNode(child, x0, z0, x1, z1, heightMap);
+		node.aabbMin = glm::min(node.aabbMin, this->_nodes[child].aabbMin);
+		node.aabbMax = glm::max(node.aabbMax, this->_nodes[child].aabbMax);
+	}
+}
+
+void TerrainChunkTree::select(const glm::vec3& localCameraPos, const ViewFrustum& localFrustum, std::vector<TerrainChunkDraw>& outDraws, CullingStats* stats) const
+{
+	outDraws.clear();
+	if (this->_nodes.empty()) return;
+	this->selectNode(0, localCameraPos, localFrustum, outDraws, stats); // the root is always in range (infinite range)
+}
+
+/**
+ * "LODSelect" from the CDLOD paper.
+ * Returns false if the node is out of its own LOD range, in which case the parent covers its area instead.
+ */
+bool TerrainChunkTree::selectNode(int nodeIndex, const glm::vec3& localCameraPos, const ViewFrustum& localFrustum, std::vector<TerrainChunkDraw>& outDraws, CullingStats* stats) const
+{
+	const TerrainChunkNode& node = this->_nodes[nodeIndex];
+
+	if (!sphereIntersectsBox(localCameraPos, this->_lodRanges[node.level], node.aabbMin, node.aabbMax))
+		return false;
+
+	if (!localFrustum.isBoxVisible(node.aabbMin, node.aabbMax))
+	{
+		// off-screen: counts as handled, so the parent won't draw this area either
+		if (stats) stats->culled++;
+		return true;
+	}
+
+	const unsigned int nodeIndexCount = node.quadrantIndexCount[0] + node.quadrantIndexCount[1] + node.quadrantIndexCount[2] + node.quadrantIndexCount[3];
+
+	if (node.level == 0 || !sphereIntersectsBox(localCameraPos, this->_lodRanges[node.level - 1], node.aabbMin, node.aabbMax))
+	{
+		// no part of the node is close enough for a finer level
+		outDraws.push_back({ node.indexOffset, nodeIndexCount, node.level });
+		if (stats) stats->drawn++;
+		return true;
+	}
+
+	unsigned int quadrantOffset = node.indexOffset;
+	for (int q = 0; q < 4; ++q)
+	{
+		const int child = node.children[q];
+		if (child != -1 && !this->selectNode(child, localCameraPos, localFrustum, outDraws, stats) && node.quadrantIndexCount[q] > 0)
+		{
+			// child is too far away for its own level, draw this quadrant at our level
+			outDraws.push_back({ quadrantOffset, node.quadrantIndexCount[q], node.level });
+			if (stats) stats->drawn++;
+		}
+		quadrantOffset += node.quadrantIndexCount[q];
+	}
+	return true;
+}
+
+bool TerrainChunkTree::sphereIntersectsBox(const glm::vec3& center, float radius, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+	if (radius == FLT_MAX) return true;
+	const glm::vec3 closest = glm::clamp(center, boxMin, boxMax);
+	const glm::vec3 diff = center - closest;
+	return glm::dot(diff, diff) <= radius * radius;
+}
+
+const std::vector<TerrainChunkNode>& TerrainChunkTree::getNodes() const
+{
+	return this->_nodes;
+}
+
+const std::vector<unsigned int>& TerrainChunkTree::getIndices() const
+{
+	return this->_indices;
+}
+
+void TerrainChunkTree::releaseIndices()
+{
+	std::vector<unsigned int>().swap(this->_indices);
+}
+
+int TerrainChunkTree::getLevelCount() const
+{
+	return this->_levelCount;
+}
+
+float TerrainChunkTree::getMorphStart(int level) const
+{
+	return this->_morphStarts[level];
+}
+
+float TerrainChunkTree::getMorphEnd(int level) const
+{
+	return this->_lodRanges[level];
+}
@@ -0,0 +1,128 @@
+#ifndef TERRAINCHUNKTREE_MINE_H
+#define TERRAINCHUNKTREE_MINE_H
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "ViewFrustum.h"
+
+/**
+ * \brief A single node of the terrain quadtree. A node covers a square area of the height map grid and is drawn with
+ * a vertex stride of 2^level, so every node (no matter the level) is drawn with roughly the same number of triangles.
+ *
+ * The indices of a node are stored as its 4 quadrants back to back, so the full node or any single quadrant
+ * can be drawn as one contiguous range of the shared index buffer.
+ */
+struct TerrainChunkNode
+{
+	int x0; // grid (vertex) coordinate of the node's corner
+	int z0; // ^
+	int size; // size of the node in grid quads (at full resolution)
+	int level; // LOD level (0 = full resolution)
+
+	glm::vec3 aabbMin; // local space bounds of the node (height taken from the height map)
+	glm::vec3 aabbMax; // ^
+
+	unsigned int indexOffset; // first index of this node in the shared index buffer
+	unsigned int quadrantIndexCount[4];
+	int children[4] = { -1, -1, -1, -1 }; // -1 when the child would lie entirely outside of the grid
+};
+
+/**
+ * \brief A contiguous range of the index buffer to draw at a given LOD level
+ */
+struct TerrainChunkDraw
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	int level;
+};
+
+/**
+ * \brief Quadtree over the terrain height map grid that selects a LOD level per chunk based on the camera distance.
+ *
+ * Main reference: "Continuous Distance-Dependent Level of Detail for Rendering Heightmaps" (CDLOD) by Filip Strugar.
+ * https://github.com/fstrugar/CDLOD/blob/master/cdlod_paper_latest.pdf
+ *
+ * Unlike the paper the vertices are not a single grid mesh moved around on the GPU: the terrain keeps its one
+ * full resolution vertex buffer and every LOD level just indexes into it with a larger stride.
+ * The morphing between levels happens in terrain.vert (see lodMorphStart/lodMorphEnd).
+ */
+class TerrainChunkTree
+{
+public:
+	/**
+	 * \param width				Width of the height map grid (in vertices)
+	 * \param height			Height of the height map grid (in vertices)
+	 * \param heightMap			World-space heights of the grid, row by row (x + width * z)
+	 * \param localOrigin		Local space (x, z) position of grid vertex (0, 0)
+	 */
+	TerrainChunkTree(int width, int height, const std::vector<float>& heightMap, const glm::vec2& localOrigin);
+
+	/**
+	 * \brief Restores a tree from previously built nodes (see getNodes()). This does not hold any indices:
+	 * whoever stored the nodes is expected to also have stored and uploaded the matching getIndices().
+	 */
+	TerrainChunkTree(int width, int height, const glm::vec2& localOrigin, std::vector<TerrainChunkNode>&& nodes);
+
+	const std::vector<TerrainChunkNode>& getNodes() const;
+
+	/**
+	 * \brief Index buffer containing the triangles of every node at every level
+	 */
+	const std::vector<unsigned int>& getIndices() const;
+
+	/**
+	 * \brief Frees up the indices once they've been uploaded (selection only needs the nodes)
+	 */
+	void releaseIndices();
+
+	/**
+	 * \brief Refits the bounds of every node overlapping the given (inclusive) vertex rect after the heights in it changed
+	 */
+	void updateBounds(int x0, int z0, int x1, int z1, const std::vector<float>& heightMap);
+
+	/**
+	 * \brief Picks the set of chunks to draw for the given camera position and frustum (both in the terrain's local space).
+	 * Clears and fills up outDraws.
+	 *
+	 * \param stats		optional, counts the drawn and culled chunks
+	 */
+	void select(const glm::vec3& localCameraPos, const ViewFrustum& localFrustum, std::vector<TerrainChunkDraw>& outDraws, CullingStats* stats = nullptr) const;
+
+	int getLevelCount() const;
+
+	/**
+	 * \brief Distance from the camera at which vertices of the given level start morphing towards the next (coarser) level
+	 */
+	float getMorphStart(int level) const;
+
+	/**
+	 * \brief Distance from the camera at which vertices of the given level are fully morphed into the next (coarser) level
+	 */
+	float getMorphEnd(int level) const;
+
+private:
+	int _width;
+	int _height;
+	glm::vec2 _localOrigin;
+
+	int _levelCount;
+	std::vector<float> _lodRanges;
+	std::vector<float> _morphStarts;
+
+	std::vector<TerrainChunkNode> _nodes;
+	std::vector<unsigned int> _indices;
+
+	void setupLevels();
+	int buildNode(int x0, int z0, int size, int level, const std::vector<float>& heightMap);
+	unsigned int appendQuadrantIndices(int x0, int z0, int size, int stride);
+	void computeLeafBounds(TerrainChunkNode& node, const std::vector<float>& heightMap) const;
+	void refitNode(int nodeIndex, int x0, int z0, int x1, int z1, const std::vector<float>& heightMap);
+
+	bool selectNode(int nodeIndex, const glm::vec3& localCameraPos, const ViewFrustum& localFrustum, std::vector<TerrainChunkDraw>& outDraws, CullingStats* stats) const;
+
+	static bool sphereIntersectsBox(const glm::vec3& center, float radius, const glm::vec3& boxMin, const glm::vec3& boxMax);
+};
+
+#endif
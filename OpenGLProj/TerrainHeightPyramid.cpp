@@ -0,0 +1,233 @@
+#include "TerrainHeightPyramid.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <glm/glm.hpp>
+
+constexpr auto TRAVERSAL_STACK_SIZE = 128; // depth-first with at most 3 siblings waiting per level, plenty for any grid that fits in memory
+constexpr auto TRIANGLE_EDGE_TOLERANCE = 1e-5f; // so rays exactly along the diagonal of a quad can't slip in between its two triangles
+
+TerrainHeightPyramid::TerrainHeightPyramid(int width, int height, const std::vector<float>& heightMap)
+:
+_width(width),
+_height(height),
+_heightMap(heightMap)
+{
+	// level 0: one cell per grid quad
+	Level base;
+	base.width = this->_width - 1;
+	base.height = this->_height - 1;
+	base.minMax.resize((size_t)base.width * base.height);
+	for (int z = 0; z < base.height; ++z)
+	{
+		for (int x = 0; x < base.width; ++x)
+			base.minMax[x + base.width * z] = this->computeBaseCell(x, z);
+	}
+	this->_levels.push_back(std::move(base));
+
+	// every level up merges 2x2 cells, until a single cell covers the whole grid
+	while (this->_levels.back().width > 1 || this->_levels.back().height > 1)
+	{
+		const Level& below = this->_levels.back();
+		Level level;
+		level.width = (below.width + 1) / 2;
+		level.height = (below.height + 1) / 2;
+		level.minMax.resize((size_t)level.width * level.height);
+		for (int z = 0; z < level.height; ++z)
+		{
+			for (int x = 0; x < level.width; ++x)
+				level.minMax[x + level.width * z] = this->computeMergedCell(below, x, z);
+		}
+		this->_levels.push_back(std::move(level)); // (invalidates "below")
+	}
+}
+
+void TerrainHeightPyramid::update(int x0, int z0, int x1, int z1)
+{
+	// a vertex is a corner of the (up to) four quads around it
+	int cellX0 = std::max(x0 - 1, 0);
+	int cellZ0 = std::max(z0 - 1, 0);
+	int cellX1 = std::min(x1, this->_levels[0].width - 1);
+	int cellZ1 = std::min(z1, this->_levels[0].height - 1);
+	if (cellX0 > cellX1 || cellZ0 > cellZ1) return;
+
+	Level& base = this->_levels[0];
+	for (int z = cellZ0; z <= cellZ1; ++z)
+		for (int x = cellX0; x <= cellX1; ++x)
+			base.minMax[x + base.width * z] = this->computeBaseCell(x, z);
+
+	for (size_t levelIndex = 1; levelIndex < this->_levels.size(); ++levelIndex)
+	{
+		cellX0 /= 2;
+		cellZ0 /= 2;
+		cellX1 /= 2;
+		cellZ1 /= 2;
+		const Level& below = this->_levels[levelIndex - 1];
+		Level& level = this->_levels[levelIndex];
+		for (int z = cellZ0; z <= cellZ1; ++z)
+			for (int x = cellX0; x <= cellX1; ++x)
+				level.minMax[x + level.width * z] = this->computeMergedCell(below, x, z);
+	}
+}
+
+glm::vec2 TerrainHeightPyramid::computeBaseCell(int x, int z) const
+{
+	const float h0 = this->_heightMap[x + this->_width * z];
+	const float h1 = this->_heightMap[x + this->_width * (z + 1)];
+	const float h2 = this->_heightMap[(x + 1) + this->_width * z];
+	const float h3 = this->_heightMap[(x + 1) + this->_width * (z + 1)];
+	return glm::vec2(std::min({ h0, h1, h2, h3 }), std::max({ h0, h1, h2, h3 }));
+}
+
+glm::vec2 TerrainHeightPyramid::computeMergedCell(const Level& below, int x, int z) const
+{
+	glm::vec2 range(FLT_MAX, -FLT_MAX);
+	for (int q = 0; q < 4; ++q)
+	{
+		const int childX = x * 2 + (q % 2);
+		const int childZ = z * 2 + (q / 2);
+		if (childX >= below.width || childZ >= below.height) continue;
+		const glm::vec2& child = below.minMax[childX + below.width * childZ];
+		range.x = std::min(range.x, child.x);
+		range.y = std::max(range.y, child.y);
+	}
+	return range;
+}
+
+bool TerrainHeightPyramid::intersect(const glm::vec3& gridOrigin, const glm::vec3& dir, float maxDist, float& outDist, glm::vec3& outNormal) const
+{
+	struct StackEntry
+	{
+		int level;
+		int x;
+		int z;
+	};
+	StackEntry stack[TRAVERSAL_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = { (int)this->_levels.size() - 1, 0, 0 };
+
+	// children are visited in the order the ray passes through them. The cells don't overlap in (x, z),
+	// so the first hit found is also the closest one
+	const int flipX = dir.x < 0.0f ? 1 : 0;
+	const int flipZ = dir.z < 0.0f ? 1 : 0;
+
+	while (stackSize > 0)
+	{
+		const StackEntry entry = stack[--stackSize];
+		const Level& level = this->_levels[entry.level];
+		const glm::vec2& range = level.minMax[entry.x + level.width * entry.z];
+
+		const int cellSize = 1 << entry.level;
+		const glm::vec3 boxMin((float)(entry.x * cellSize), range.x, (float)(entry.z * cellSize));
+		const glm::vec3 boxMax(
+			(float)std::min((entry.x + 1) * cellSize, this->_width - 1),
+			range.y,
+			(float)std::min((entry.z + 1) * cellSize, this->_height - 1)
+		);
+		if (!rayHitsBox(gridOrigin, dir, boxMin, boxMax, maxDist)) continue;
+
+		if (entry.level == 0)
+		{
+			if (this->intersectCell(gridOrigin, dir, maxDist, entry.x, entry.z, outDist, outNormal)) return true;
+			continue;
+		}
+
+		// pushed far to near, so the nearest child gets popped first
+		const Level& below = this->_levels[entry.level - 1];
+		for (int order = 3; order >= 0; --order)
+		{
+			const int childX = entry.x * 2 + ((order % 2) ^ flipX);
+			const int childZ = entry.z * 2 + ((order / 2) ^ flipZ);
+			if (childX >= below.width || childZ >= below.height) continue;
+			stack[stackSize++] = { entry.level - 1, childX, childZ };
+		}
+	}
+	return false;
+}
+
+bool TerrainHeightPyramid::intersectCell(const glm::vec3& gridOrigin, const glm::vec3& dir, float maxDist, int x, int z, float& outDist, glm::vec3& outNormal) const
+{
+	// same triangles as the mesh (see TerrainChunkTree::appendQuadrantIndices)
+	//                  0---2
+	//                  | / |
+	//                  1---3
+	const glm::vec3 p0((float)x, this->_heightMap[x + this->_width * z], (float)z);
+	const glm::vec3 p1((float)x, this->_heightMap[x + this->_width * (z + 1)], (float)(z + 1));
+	const glm::vec3 p2((float)(x + 1), this->_heightMap[(x + 1) + this->_width * z], (float)z);
+	const glm::vec3 p3((float)(x + 1), this->_heightMap[(x + 1) + this->_width * (z + 1)], (float)(z + 1));
+
+	bool hit = false;
+	float dist;
+	if (rayHitsTriangle(gridOrigin, dir, p0, p1, p2, dist) && dist <= maxDist)
+	{
+		outDist = dist;
+		outNormal = glm::cross(p1 - p0, p2 - p0);
+		hit = true;
+	}
+	if (rayHitsTriangle(gridOrigin, dir, p1, p3, p2, dist) && dist <= maxDist && (!hit || dist < outDist))
+	{
+		outDist = dist;
+		outNormal = glm::cross(p3 - p1, p2 - p1);
+		hit = true;
+	}
+	if (!hit) return false;
+
+	outNormal = glm::normalize(outNormal);
+	if (outNormal.y < 0.0f) outNormal = -outNormal;
+	return true;
+}
+
+/**
+ * Slab test, limited to [0, maxDist] along the ray
+ */
+bool TerrainHeightPyramid::rayHitsBox(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& boxMin, const glm::vec3& boxMax, float maxDist)
+{
+	float tEnter = 0.0f;
+	float tExit = maxDist;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (dir[axis] == 0.0f)
+		{
+			// parallel to this slab: either always inside of it or never
+			if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis]) return false;
+			continue;
+		}
+		const float invDir = 1.0f / dir[axis];
+		float t0 = (boxMin[axis] - origin[axis]) * invDir;
+		float t1 = (boxMax[axis] - origin[axis]) * invDir;
+		if (t0 > t1) std::swap(t0, t1);
+		tEnter = std::max(tEnter, t0);
+		tExit = std::min(tExit, t1);
+		if (tEnter > tExit) return false;
+	}
+	return true;
+}
+
+/**
+ * Moller-Trumbore (both sides of the triangle count)
+ */
+bool TerrainHeightPyramid::rayHitsTriangle(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, float& outDist)
+{
+	const glm::vec3 edge1 = p1 - p0;
+	const glm::vec3 edge2 = p2 - p0;
+	const glm::vec3 pVec = glm::cross(dir, edge2);
+	const float det = glm::dot(edge1, pVec);
+	if (fabs(det) < 1e-8f) return false; // ray runs parallel to the triangle
+
+	const float invDet = 1.0f / det;
+	const glm::vec3 tVec = origin - p0;
+	const float u = glm::dot(tVec, pVec) * invDet;
+	if (u < -TRIANGLE_EDGE_TOLERANCE || u > 1.0f + TRIANGLE_EDGE_TOLERANCE) return false;
+
+	const glm::vec3 qVec = glm::cross(tVec, edge1);
+	const float v = glm::dot(dir, qVec) * invDet;
+	if (v < -TRIANGLE_EDGE_TOLERANCE || u + v > 1.0f + TRIANGLE_EDGE_TOLERANCE) return false;
+
+	outDist = glm::dot(edge2, qVec) * invDet;
+	return outDist >= 0.0f;
+}
+
+int TerrainHeightPyramid::getLevelCount() const
+{
+	return (int)this->_levels.size();
+}
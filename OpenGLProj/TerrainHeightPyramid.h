@@ -0,0 +1,66 @@
+#ifndef TERRAINHEIGHTPYRAMID_MINE_H
+#define TERRAINHEIGHTPYRAMID_MINE_H
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+/**
+ * \brief Min/max mip pyramid of the terrain height map, for ray-heightfield intersection.
+ *
+ * Level 0 stores the lowest and highest corner of every grid quad, every level up covers 2x2 cells of the level below.
+ * A ray walks this as a quadtree (front to back), and any cell whose height range it passes over or under is skipped as a whole,
+ * so only the handful of quads close to the actual hit ever get their triangles tested.
+ *
+ * Everything is in grid space: vertex (x, z) of the height map sits at (x, height, z).
+ */
+class TerrainHeightPyramid
+{
+public:
+	/**
+	 * \param width				Width of the height map grid (in vertices)
+	 * \param height			Height of the height map grid (in vertices)
+	 * \param heightMap			Heights of the grid, row by row (x + width * z)
+	 */
+	TerrainHeightPyramid(int width, int height, const std::vector<float>& heightMap);
+
+	/**
+	 * \brief Closest intersection of the ray with the triangles of the height map (same triangle split as the mesh).
+	 *
+	 * \param gridOrigin		ray origin in grid space
+	 * \param dir				normalized ray direction
+	 * \param maxDist			hits further away than this are ignored
+	 * \param outDist			distance along dir to the hit
+	 * \param outNormal			normal of the hit triangle (always pointing up)
+	 * \return false if the ray does not hit the terrain within maxDist
+	 */
+	bool intersect(const glm::vec3& gridOrigin, const glm::vec3& dir, float maxDist, float& outDist, glm::vec3& outNormal) const;
+
+	/**
+	 * \brief Recomputes the cells covering the given (inclusive) vertex rect after the heights in it changed, on every level
+	 */
+	void update(int x0, int z0, int x1, int z1);
+
+	int getLevelCount() const;
+
+private:
+	struct Level
+	{
+		int width; // in cells
+		int height; // ^
+		std::vector<glm::vec2> minMax; // (min, max) height per cell
+	};
+
+	int _width;
+	int _height;
+	const std::vector<float>& _heightMap;
+	std::vector<Level> _levels;
+
+	glm::vec2 computeBaseCell(int x, int z) const;
+	glm::vec2 computeMergedCell(const Level& below, int x, int z) const;
+	bool intersectCell(const glm::vec3& gridOrigin, const glm::vec3& dir, float maxDist, int x, int z, float& outDist, glm::vec3& outNormal) const;
+
+	static bool rayHitsBox(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& boxMin, const glm::vec3& boxMax, float maxDist);
+	static bool rayHitsTriangle(const glm::vec3& origin, const glm::vec3& dir, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, float& outDist);
+};
+
+#endif
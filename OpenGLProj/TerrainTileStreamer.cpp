@@ -0,0 +1,355 @@
+#include "TerrainTileStreamer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <glm/ext/matrix_transform.hpp>
+
+#include "ThreadPool.h"
+
+constexpr auto TILE_STRIDE = 4; // tiles use every n-th vertex of the height map (they're never close to the player)
+constexpr auto TILE_RING_RADIUS = 1; // tiles kept around the camera's tile in every direction (1 -> 3x3)
+constexpr auto TILE_UPLOAD_BUDGET_BYTES = (size_t)1024 * 1024; // max. vertex data uploaded per frame, over all tiles
+constexpr auto TILE_MEMORY_CAP_BYTES = (size_t)64 * 1024 * 1024; // above this the least recently used tiles (out of range) get evicted
+constexpr auto TILE_NO_MORPH_DISTANCE = 1.0e30f; // tiles are drawn without LOD morphing (see terrain.vert)
+constexpr auto TILE_SKIRT = 1; // ring of skirt vertices around every tile (see buildTile())
+constexpr auto TILE_SKIRT_REACH = 32; // height map vertices along the edge (either way) a skirt has to hang below
+constexpr auto TILE_SKIRT_MARGIN = 1.0f; // how far it goes below those
+
+TerrainTileStreamer::TerrainTileStreamer(int width, int height, const std::vector<float>* heightMap, const glm::vec2& localOrigin)
+:
+_width(width),
+_height(height),
+_heightMap(heightMap),
+_localOrigin(localOrigin)
+{
+	// +1 for the last row/column, which is clamped onto the edge of the grid (same as the LOD levels of the chunk tree), + the skirt on both sides
+	this->_tileGridWidth = (this->_width - 2) / TILE_STRIDE + 2 + 2 * TILE_SKIRT;
+	this->_tileGridHeight = (this->_height - 2) / TILE_STRIDE + 2 + 2 * TILE_SKIRT;
+	this->setupIndices();
+}
+
+TerrainTileStreamer::~TerrainTileStreamer()
+{
+	for (auto& [key, tile] : this->_tiles) this->destroyTile(tile);
+	glDeleteBuffers(1, &this->_EBO);
+}
+
+void TerrainTileStreamer::setupIndices()
+{
+	std::vector<unsigned int> indices;
+	indices.reserve((size_t)(this->_tileGridWidth - 1) * (this->_tileGridHeight - 1) * 6);
+	for (int z = 0; z < this->_tileGridHeight - 1; ++z)
+	{
+		for (int x = 0; x < this->_tileGridWidth - 1; ++x)
+		{
+			// same triangle layout as the full resolution grid (see TerrainChunkTree::appendQuadrantIndices)
+			//                  0---2
+			//                  | / |
+			//                  1---3
+			const unsigned int index0 = x + (this->_tileGridWidth * z);
+			const unsigned int index1 = x + (this->_tileGridWidth * (z + 1));
+			const unsigned int index2 = (x + 1) + (this->_tileGridWidth * z);
+			const unsigned int index3 = (x + 1) + (this->_tileGridWidth * (z + 1));
+			indices.push_back(index0);
+			indices.push_back(index1);
+			indices.push_back(index2);
+			indices.push_back(index1);
+			indices.push_back(index3);
+			indices.push_back(index2);
+		}
+	}
+	this->_indexCount = (unsigned int)indices.size();
+
+	// filled through GL_ARRAY_BUFFER so the element buffer binding of whatever VAO is currently bound stays untouched.
+	// It gets attached as the element buffer of every tile VAO in uploadTiles()
+	glGenBuffers(1, &this->_EBO);
+	glBindBuffer(GL_ARRAY_BUFFER, this->_EBO);
+	glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+}
+
+void TerrainTileStreamer::update(const glm::vec3& localCameraPos)
+{
+	this->_frame++;
+
+	// tile the camera is in (tile (0, 0) is the source tile. Tiles share their edge vertices, hence the "- 1")
+	const glm::vec2 cameraTile(
+		std::floor((localCameraPos.x - this->_localOrigin.x) / (float)(this->_width - 1)),
+		std::floor((localCameraPos.z - this->_localOrigin.y) / (float)(this->_height - 1))
+	);
+
+	// 1. everything in range is marked as used, anything missing gets queued up
+	for (int dz = -TILE_RING_RADIUS; dz <= TILE_RING_RADIUS; ++dz)
+	{
+		for (int dx = -TILE_RING_RADIUS; dx <= TILE_RING_RADIUS; ++dx)
+		{
+			const int tileX = (int)cameraTile.x + dx;
+			const int tileZ = (int)cameraTile.y + dz;
+			if (tileX == 0 && tileZ == 0) continue; // drawn by the Terrain itself
+
+			auto it = this->_tiles.find({ tileX, tileZ });
+			if (it == this->_tiles.end())
+			{
+				this->requestTile(tileX, tileZ);
+				it = this->_tiles.find({ tileX, tileZ });
+			}
+			it->second->lastUsedFrame = this->_frame;
+		}
+	}
+
+	// 2. pick up the finished builds
+	for (auto& [key, tile] : this->_tiles)
+	{
+		if (tile->state == TerrainTileState::BUILDING && tile->build.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			tile->build.get(); // rethrows if the build failed
+			tile->state = TerrainTileState::UPLOADING;
+		}
+	}
+
+	// 3. + 4.
+	this->uploadTiles(cameraTile);
+	this->evictTiles();
+}
+
+void TerrainTileStreamer::requestTile(int tileX, int tileZ)
+{
+	TerrainTile* tile = new TerrainTile();
+	tile->tileX = tileX;
+	tile->tileZ = tileZ;
+	this->_tiles[{ tileX, tileZ }] = tile;
+
+	ThreadPool& pool = ThreadPool::getShared();
+	if (pool.getThreadCount() == 0)
+	{
+		// no workers to hand it to (single core machine), so just build it right here
+		std::promise<void> done;
+		tile->build = done.get_future();
+		this->buildTile(tile);
+		done.set_value();
+		return;
+	}
+	tile->build = pool.submit([this, tile]() { this->buildTile(tile); });
+}
+
+/**
+ * Runs on a worker thread: only reads the source height map and writes to this one tile.
+ *
+ * The edge of the terrain itself is stitched onto the tiles (see snapToTileEdge() in terrain.vert), but only while its chunks there are
+ * at least as detailed as the tiles. Far away they get coarser, and then their edge no longer follows the bends of the tile edge.
+ * The skirt hides what's left: the ring of vertices around the tile sits right on its edge (see terrain.vert), dropped down to
+ * below the lowest point of the height map along the edge nearby, so any gap between the two shows the skirt instead of the sky.
+ */
+void TerrainTileStreamer::buildTile(TerrainTile* tile) const
+{
+	std::vector<PackedTerrainVertex> vertices((size_t)this->_tileGridWidth * this->_tileGridHeight);
+	glm::vec2 heightRange(FLT_MAX, -FLT_MAX);
+
+	const int tileOriginX = tile->tileX * (this->_width - 1);
+	const int tileOriginZ = tile->tileZ * (this->_height - 1);
+
+	for (int z = 0; z < this->_tileGridHeight; ++z)
+	{
+		const int globalZ = tileOriginZ + this->getTileGridZ(z);
+		const bool isSkirtRow = z < TILE_SKIRT || z >= this->_tileGridHeight - TILE_SKIRT;
+		for (int x = 0; x < this->_tileGridWidth; ++x)
+		{
+			const int globalX = tileOriginX + this->getTileGridX(x);
+			const bool isSkirtColumn = x < TILE_SKIRT || x >= this->_tileGridWidth - TILE_SKIRT;
+			float y = this->getMirroredHeight(globalX, globalZ);
+			if (isSkirtRow || isSkirtColumn)
+			{
+				// (the skirt along x for rows, along z for columns; corners are covered by both)
+				for (int along = -TILE_SKIRT_REACH; along <= TILE_SKIRT_REACH; ++along)
+				{
+					if (isSkirtRow) y = std::min(y, this->getMirroredHeight(globalX + along, globalZ));
+					if (isSkirtColumn) y = std::min(y, this->getMirroredHeight(globalX, globalZ + along));
+				}
+				y -= TILE_SKIRT_MARGIN;
+			}
+
+			// central differences over the tile's vertex spacing, taken from the infinite mirrored height field (like Terrain::packVertexRow())
+			const float dhdx = (this->getMirroredHeight(globalX + TILE_STRIDE, globalZ) - this->getMirroredHeight(globalX - TILE_STRIDE, globalZ)) / (2.0f * TILE_STRIDE);
+			const float dhdz = (this->getMirroredHeight(globalX, globalZ + TILE_STRIDE) - this->getMirroredHeight(globalX, globalZ - TILE_STRIDE)) / (2.0f * TILE_STRIDE);
+
+			PackedTerrainVertex& vert = vertices[x + (size_t)this->_tileGridWidth * z];
+			vert.height = y;
+			octEncodeUnitVector(glm::vec3(-dhdx, 1.0f, -dhdz), vert.normal);
+			octEncodeUnitVector(glm::vec3(-1.0f, -dhdx, 0.0f), vert.tangent);
+
+			heightRange.x = std::min(heightRange.x, y);
+			heightRange.y = std::max(heightRange.y, y);
+		}
+	}
+
+	tile->vertices = std::move(vertices);
+	tile->heightRange = heightRange;
+}
+
+void TerrainTileStreamer::uploadTiles(const glm::vec2& cameraTile)
+{
+	std::vector<TerrainTile*> pending;
+	for (auto& [key, tile] : this->_tiles)
+	{
+		if (tile->state == TerrainTileState::UPLOADING) pending.push_back(tile);
+	}
+
+	// closest tiles first
+	std::sort(pending.begin(), pending.end(), [&cameraTile](const TerrainTile* a, const TerrainTile* b) {
+		return glm::length(glm::vec2(a->tileX, a->tileZ) - cameraTile) < glm::length(glm::vec2(b->tileX, b->tileZ) - cameraTile);
+	});
+
+	// in whole rows, but at least one row a frame so an upload always finishes eventually
+	const size_t rowBytes = (size_t)this->_tileGridWidth * sizeof(PackedTerrainVertex);
+	size_t rowBudget = std::max((size_t)1, TILE_UPLOAD_BUDGET_BYTES / rowBytes);
+
+	for (TerrainTile* tile : pending)
+	{
+		if (rowBudget == 0) break;
+
+		if (tile->VAO == 0)
+		{
+			glGenVertexArrays(1, &tile->VAO);
+			glBindVertexArray(tile->VAO);
+			glGenBuffers(1, &tile->VBO);
+			glBindBuffer(GL_ARRAY_BUFFER, tile->VBO);
+			glBufferData(GL_ARRAY_BUFFER, this->getTileBytes(), nullptr, GL_STATIC_DRAW); // only allocates
+
+			// same layout as Terrain::setupMesh()
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(PackedTerrainVertex), (void*)0);
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedTerrainVertex), (void*)offsetof(PackedTerrainVertex, normal));
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(PackedTerrainVertex), (void*)offsetof(PackedTerrainVertex, tangent));
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->_EBO);
+		}
+		else
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, tile->VBO);
+		}
+
+		const size_t rows = std::min(rowBudget, (size_t)(this->_tileGridHeight - tile->uploadedRows));
+		glBufferSubData(GL_ARRAY_BUFFER, tile->uploadedRows * rowBytes, rows * rowBytes, tile->vertices.data() + (size_t)tile->uploadedRows * this->_tileGridWidth);
+		tile->uploadedRows += (int)rows;
+		rowBudget -= rows;
+
+		if (tile->uploadedRows == this->_tileGridHeight)
+		{
+			std::vector<PackedTerrainVertex>().swap(tile->vertices);
+			tile->state = TerrainTileState::RESIDENT;
+		}
+	}
+	glBindVertexArray(0);
+}
+
+void TerrainTileStreamer::evictTiles()
+{
+	size_t usage = this->getMemoryUsage();
+	while (usage > TILE_MEMORY_CAP_BYTES)
+	{
+		// tiles still being built can't go (a worker is writing to them), neither can anything in range
+		TerrainTile* oldest = nullptr;
+		for (auto& [key, tile] : this->_tiles)
+		{
+			if (tile->state == TerrainTileState::BUILDING || tile->lastUsedFrame == this->_frame) continue;
+			if (oldest == nullptr || tile->lastUsedFrame < oldest->lastUsedFrame) oldest = tile;
+		}
+		if (oldest == nullptr) return; // everything left is needed
+
+		this->_tiles.erase({ oldest->tileX, oldest->tileZ });
+		this->destroyTile(oldest);
+		usage = this->getMemoryUsage();
+	}
+}
+
+void TerrainTileStreamer::destroyTile(TerrainTile* tile)
+{
+	if (tile->build.valid()) tile->build.wait(); // (only on shutdown, evictTiles() never picks tiles that are still building)
+	if (tile->VBO != 0) glDeleteBuffers(1, &tile->VBO);
+	if (tile->VAO != 0) glDeleteVertexArrays(1, &tile->VAO);
+	delete tile;
+}
+
+void TerrainTileStreamer::render(Shader* shader, const glm::mat4& terrainModel, const glm::mat4& projectionView, CullingStats* stats) const
+{
+	shader->setInt("gridWidth", this->_tileGridWidth);
+	shader->setInt("gridStride", TILE_STRIDE);
+	shader->setInt("gridBorder", TILE_SKIRT);
+	shader->setFloat("lodMorphStart", TILE_NO_MORPH_DISTANCE);
+	shader->setFloat("lodMorphEnd", 2.0f * TILE_NO_MORPH_DISTANCE);
+
+	for (const auto& [key, tile] : this->_tiles)
+	{
+		if (tile->state != TerrainTileState::RESIDENT) continue;
+
+		const glm::mat4 model = glm::translate(terrainModel, this->getTileOffset(tile->tileX, tile->tileZ));
+		const glm::vec3 boundsMin(this->_localOrigin.x, tile->heightRange.x, this->_localOrigin.y);
+		const glm::vec3 boundsMax(this->_localOrigin.x + (this->_width - 1), tile->heightRange.y, this->_localOrigin.y + (this->_height - 1));
+		if (!ViewFrustum(projectionView * model).isBoxVisible(boundsMin, boundsMax))
+		{
+			if (stats) stats->culled++;
+			continue;
+		}
+		if (stats) stats->drawn++;
+
+		shader->setMat4("model", model);
+		shader->setMat3("normalMatrix", glm::mat3(glm::transpose(glm::inverse(model))));
+		glBindVertexArray(tile->VAO);
+		glDrawElements(GL_TRIANGLES, this->_indexCount, GL_UNSIGNED_INT, (void*)0);
+	}
+	glBindVertexArray(0);
+}
+
+size_t TerrainTileStreamer::getMemoryUsage() const
+{
+	size_t usage = 0;
+	for (const auto& [key, tile] : this->_tiles)
+	{
+		usage += tile->vertices.capacity() * sizeof(PackedTerrainVertex);
+		if (tile->VBO != 0) usage += this->getTileBytes();
+	}
+	return usage;
+}
+
+size_t TerrainTileStreamer::getTileBytes() const
+{
+	return (size_t)this->_tileGridWidth * this->_tileGridHeight * sizeof(PackedTerrainVertex);
+}
+
+glm::vec3 TerrainTileStreamer::getTileOffset(int tileX, int tileZ) const
+{
+	return glm::vec3((float)(tileX * (this->_width - 1)), 0.0f, (float)(tileZ * (this->_height - 1)));
+}
+
+/**
+ * Height of the infinite grid made of mirrored copies of the height map (grid coordinates, tile (0, 0) starts at 0).
+ * Mirroring repeats every 2 tiles: [0, w-1] as is, [w-1, 2(w-1)] backwards, and so on.
+ */
+float TerrainTileStreamer::getMirroredHeight(int globalX, int globalZ) const
+{
+	const int periodX = 2 * (this->_width - 1);
+	const int periodZ = 2 * (this->_height - 1);
+	int x = ((globalX % periodX) + periodX) % periodX;
+	int z = ((globalZ % periodZ) + periodZ) % periodZ;
+	if (x > this->_width - 1) x = periodX - x;
+	if (z > this->_height - 1) z = periodZ - z;
+	return (*this->_heightMap)[x + (size_t)this->_width * z];
+}
+
+int TerrainTileStreamer::getTileStride()
+{
+	return TILE_STRIDE;
+}
+
+/**
+ * (the skirt vertices are clamped onto the edge, same as in terrain.vert)
+ */
+int TerrainTileStreamer::getTileGridX(int vertexX) const
+{
+	return std::clamp((vertexX - TILE_SKIRT) * TILE_STRIDE, 0, this->_width - 1);
+}
+
+int TerrainTileStreamer::getTileGridZ(int vertexZ) const
+{
+	return std::clamp((vertexZ - TILE_SKIRT) * TILE_STRIDE, 0, this->_height - 1);
+}
@@ -0,0 +1,116 @@
+#ifndef TERRAINTILESTREAMER_MINE_H
+#define TERRAINTILESTREAMER_MINE_H
+#include <future>
+#include <map>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+#include "Terrain.h"
+#include "ViewFrustum.h"
+
+enum class TerrainTileState
+{
+	BUILDING, // vertex data is being generated on a worker thread
+	UPLOADING, // vertex data is ready and being copied to the GPU, a few rows per frame
+	RESIDENT // fully on the GPU, can be drawn
+};
+
+struct TerrainTile
+{
+	int tileX;
+	int tileZ;
+	TerrainTileState state = TerrainTileState::BUILDING;
+	std::future<void> build;
+
+	std::vector<PackedTerrainVertex> vertices; // freed once uploaded
+	int uploadedRows = 0;
+	glm::vec2 heightRange; // (min, max) for culling
+
+	unsigned int VAO = 0;
+	unsigned int VBO = 0;
+
+	unsigned long long lastUsedFrame = 0; // for the LRU eviction
+};
+
+/**
+ * \brief Keeps a ring of tiles around the camera so the world doesn't end at the edge of the height map.
+ *
+ * Tile (0, 0) is the actual terrain (drawn by Terrain itself), every other tile is a mirrored copy of its original height map
+ * (mirrored in x for odd tile x, in z for odd tile z), so neighbouring tiles always share their edge heights.
+ * The normals are taken from that same infinite mirrored height field, so there are no lighting seams between tiles either.
+ * Tiles are only scenery, drawn at a lower resolution (every TILE_STRIDE-th vertex) and without LOD morphing. The edge of the terrain
+ * is stitched onto them in terrain.vert, and every tile has a skirt for where that isn't enough (see buildTile()).
+ *
+ * Per frame (update()):
+ * - missing tiles in range are queued up on the shared ThreadPool
+ * - finished tiles are uploaded with glBufferSubData, limited to a fixed number of bytes per frame in total
+ * - once the tiles take up more than the memory cap, the least recently used ones out of range are evicted
+ */
+class TerrainTileStreamer
+{
+public:
+	/**
+	 * \param width				Width of the source height map grid (in vertices)
+	 * \param height			Height of the source height map grid (in vertices)
+	 * \param heightMap			Heights of the source grid, row by row (x + width * z). Not copied, has to outlive the streamer and must not change (the workers read it)
+	 * \param localOrigin		Local space (x, z) position of grid vertex (0, 0) of the source tile
+	 */
+	TerrainTileStreamer(int width, int height, const std::vector<float>* heightMap, const glm::vec2& localOrigin);
+	~TerrainTileStreamer();
+
+	TerrainTileStreamer(const TerrainTileStreamer&) = delete;
+	TerrainTileStreamer& operator=(const TerrainTileStreamer&) = delete;
+
+	/**
+	 * \brief Queues/uploads/evicts tiles for the given camera position (local space of the terrain). Call once per frame.
+	 */
+	void update(const glm::vec3& localCameraPos);
+
+	/**
+	 * \brief Draws all resident tiles in the frustum. Expects the terrain shader to be in use with its textures bound.
+	 *
+	 * \param terrainModel		model matrix of the source tile
+	 */
+	void render(Shader* shader, const glm::mat4& terrainModel, const glm::mat4& projectionView, CullingStats* stats = nullptr) const;
+
+	/**
+	 * \brief Memory held by the tiles (vertex data on the CPU waiting for upload + vertex buffers on the GPU)
+	 */
+	size_t getMemoryUsage() const;
+
+	/**
+	 * \brief Height map vertices between two vertices of a tile
+	 */
+	static int getTileStride();
+
+private:
+	int _width;
+	int _height;
+	const std::vector<float>* _heightMap; // the terrain's heights before any displacement (read by the workers)
+	glm::vec2 _localOrigin;
+
+	int _tileGridWidth; // vertices per row of a (reduced resolution) tile, including its skirt
+	int _tileGridHeight; // ^
+	unsigned int _EBO; // same triangles for every tile
+	unsigned int _indexCount;
+
+	std::map<std::pair<int, int>, TerrainTile*> _tiles;
+	unsigned long long _frame = 0;
+
+	void setupIndices();
+	void requestTile(int tileX, int tileZ);
+	void buildTile(TerrainTile* tile) const;
+	void uploadTiles(const glm::vec2& cameraTile);
+	void evictTiles();
+	void destroyTile(TerrainTile* tile);
+
+	size_t getTileBytes() const;
+	glm::vec3 getTileOffset(int tileX, int tileZ) const;
+	float getMirroredHeight(int globalX, int globalZ) const;
+	int getTileGridX(int vertexX) const;
+	int getTileGridZ(int vertexZ) const;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "TextureCompression.h"
+
+constexpr auto BYTES_PER_MB = 1024.0 * 1024.0;
+
+unsigned int TextureCache::acquire(const std::string& path, const std::string& directory, bool loadAsSRGB, const DecodedTexture* decoded)
+{
+	const Key key = makeKey(path, directory, loadAsSRGB);
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		const auto cached = this->_entries.find(key);
+		if (cached != this->_entries.end())
+		{
+			cached->second.references++;
+			return cached->second.id;
+		}
+	}
+
+	// (a worker may have skipped decoding because it was cached back then, see contains())
+	DecodedTexture decodedHere;
+	if (decoded == nullptr || !decoded->isLoaded())
+	{
+		decodedHere = decodeTextureFile(path.c_str(), directory);
+		decoded = &decodedHere;
+	}
+
+	const unsigned int textureId = uploadTexture(*decoded, std::nullopt, loadAsSRGB);
+	if (textureId == (unsigned int)-1) return textureId;
+
+	size_t bytes;
+	if (decoded->cooked != nullptr) bytes = decoded->cooked->blocksSize; // (every mip level, exactly as uploaded)
+	else
+	{
+		const size_t bytesPerTexel = decoded->channels == 3 ? 4 : (size_t)decoded->channels; // (RGB is padded to RGBA by most drivers)
+		const size_t baseBytes = (size_t)decoded->width * decoded->height * bytesPerTexel;
+		bytes = baseBytes + baseBytes / 3;
+	}
+
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	this->_entries[key] = { .id = textureId, .references = 1, .width = decoded->width, .height = decoded->height, .bytes = bytes };
+	this->_keysById[textureId] = key;
+	return textureId;
+}
+
+bool TextureCache::contains(const std::string& path, const std::string& directory, bool loadAsSRGB) const
+{
+	const Key key = makeKey(path, directory, loadAsSRGB);
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	return this->_entries.contains(key);
+}
+
+void TextureCache::release(unsigned int textureId)
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	const auto key = this->_keysById.find(textureId);
+	if (key == this->_keysById.end()) return;
+
+	Entry& entry = this->_entries.at(key->second);
+	if (--entry.references > 0) return;
+
+	glDeleteTextures(1, &entry.id);
+	this->_entries.erase(key->second);
+	this->_keysById.erase(key);
+}
+
+size_t TextureCache::getTextureCount() const
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	return this->_entries.size();
+}
+
+size_t TextureCache::getTotalBytes() const
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	size_t total = 0;
+	for (const auto& [key, entry] : this->_entries) total += entry.bytes;
+	return total;
+}
+
+void TextureCache::printReport() const
+{
+	std::lock_guard<std::mutex> lock(this->_mutex);
+	std::vector<std::pair<const Key*, const Entry*>> sorted;
+	size_t total = 0;
+	for (const auto& [key, entry] : this->_entries)
+	{
+		sorted.emplace_back(&key, &entry);
+		total += entry.bytes;
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second->bytes > b.second->bytes; });
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Texture cache: " << sorted.size() << " textures, ~" << (double)total / BYTES_PER_MB << " MB of video memory" << std::endl;
+	std::cout << "      MB  refs  size       texture" << std::endl;
+	for (const auto& [key, entry] : sorted)
+	{
+		const std::string size = std::to_string(entry->width) + "x" + std::to_string(entry->height);
+		std::cout << std::setw(8) << (double)entry->bytes / BYTES_PER_MB << std::setw(6) << entry->references << "  " << std::left << std::setw(11) << size
+			<< std::right << key->first << (key->second ? " (sRGB)" : "") << std::endl;
+	}
+	std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+TextureCache& TextureCache::getShared()
+{
+	static TextureCache shared;
+	return shared;
+}
+
+TextureCache::Key TextureCache::makeKey(const std::string& path, const std::string& directory, bool loadAsSRGB)
+{
+	const std::string fileName = directory + '/' + path; // (same as decodeTextureFile())
+	std::error_code error;
+	const std::filesystem::path canonical = std::filesystem::weakly_canonical(fileName, error);
+	return { error ? fileName : canonical.generic_string(), loadAsSRGB };
+}
@@ -0,0 +1,80 @@
+#ifndef TEXTURECACHE_MINE_H
+#define TEXTURECACHE_MINE_H
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "FileUtils.h"
+
+/**
+ * \brief Every 2D texture file on the GPU only once per color space (sRGB or linear), however many models, terrains, particle
+ * systems, ... use it. Textures are reference counted: acquire() adds a reference, release() drops one and deletes the
+ * texture with the last one. Files are keyed by their canonical path, so "./a/b.png" and "a/../a/b.png" are the same texture.
+ *
+ * Only acquire() and release() make OpenGL calls (so only the thread with the context may call them). contains() can be called
+ * from anywhere, so a worker can skip decoding a file that's already on the GPU.
+ */
+class TextureCache
+{
+public:
+	TextureCache() = default;
+
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	/**
+	 * \brief Id of the texture in the file (same path rules as loadTextureFromFile()). Only decoded and uploaded if it isn't cached yet.
+	 *
+	 * \param decoded		optional, the file already decoded (see decodeTextureFile()). Only used if it isn't cached yet
+	 */
+	unsigned int acquire(const std::string& path, const std::string& directory, bool loadAsSRGB, const DecodedTexture* decoded = nullptr);
+
+	/**
+	 * \brief Whether acquire() would reuse a texture right now
+	 */
+	bool contains(const std::string& path, const std::string& directory, bool loadAsSRGB) const;
+
+	/**
+	 * \brief Drops one reference (from acquire()). Ids that aren't from this cache are ignored.
+	 */
+	void release(unsigned int textureId);
+
+	size_t getTextureCount() const;
+
+	/**
+	 * \brief Estimated video memory of all cached textures (every texel at its uploaded size, plus a third for the mipmaps;
+	 * the exact size of the blocks for cooked textures)
+	 */
+	size_t getTotalBytes() const;
+
+	/**
+	 * \brief Prints every cached texture (largest first) with its size and number of references, and the total
+	 */
+	void printReport() const;
+
+	/**
+	 * \brief Cache shared by the whole program
+	 */
+	static TextureCache& getShared();
+
+private:
+	using Key = std::pair<std::string, bool>; // canonical path, sRGB
+
+	struct Entry
+	{
+		unsigned int id;
+		int references;
+		int width;
+		int height;
+		size_t bytes;
+	};
+
+	std::map<Key, Entry> _entries;
+	std::map<unsigned int, Key> _keysById;
+	mutable std::mutex _mutex;
+
+	static Key makeKey(const std::string& path, const std::string& directory, bool loadAsSRGB);
+};
+
+#endif
@@ -0,0 +1,684 @@
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "stb_image.h"
+#include "ThreadPool.h"
+
+constexpr auto COOKED_TEXTURE_EXTENSION = ".dds"; // cooked texture lives right next to the image file
+constexpr auto COOKED_TEXTURE_MAGIC = 0x4B435854u; // "TXCK", in the reserved words of the DDS header (so other tools can still open the file)
+constexpr auto COOKED_TEXTURE_VERSION = 1u;
+constexpr auto COOK_PSNR_WARNING = 30.0; // dB, a round trip below this is worth a look
+constexpr auto POWER_ITERATIONS = 8; // for the principal axis of the colors of a block
+
+#pragma region DDS
+
+constexpr auto DDS_MAGIC = 0x20534444u; // "DDS "
+constexpr auto DDSD_CAPS = 0x1u;
+constexpr auto DDSD_HEIGHT = 0x2u;
+constexpr auto DDSD_WIDTH = 0x4u;
+constexpr auto DDSD_PIXELFORMAT = 0x1000u;
+constexpr auto DDSD_MIPMAPCOUNT = 0x20000u;
+constexpr auto DDSD_LINEARSIZE = 0x80000u;
+constexpr auto DDPF_FOURCC = 0x4u;
+constexpr auto DDSCAPS_COMPLEX = 0x8u;
+constexpr auto DDSCAPS_TEXTURE = 0x1000u;
+constexpr auto DDSCAPS_MIPMAP = 0x400000u;
+
+struct DDSPixelFormat
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t rBitMask;
+	uint32_t gBitMask;
+	uint32_t bBitMask;
+	uint32_t aBitMask;
+};
+
+/**
+ * Layout of a cooked texture file:
+ *	- DDS_MAGIC
+ *	- DDSHeader (reserved1 holds the cook info: COOKED_TEXTURE_MAGIC, COOKED_TEXTURE_VERSION, source file size (2 words), source write time (2 words))
+ *	- the blocks of every mip level, largest first
+ */
+struct DDSHeader
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11];
+	DDSPixelFormat pixelFormat;
+	uint32_t caps;
+	uint32_t caps2;
+	uint32_t caps3;
+	uint32_t caps4;
+	uint32_t reserved2;
+};
+static_assert(sizeof(DDSHeader) == 124, "DDS header must match the file format");
+
+static constexpr uint32_t makeFourCC(char a, char b, char c, char d)
+{
+	return (uint32_t)(unsigned char)a | ((uint32_t)(unsigned char)b << 8) | ((uint32_t)(unsigned char)c << 16) | ((uint32_t)(unsigned char)d << 24);
+}
+
+static uint32_t getFourCC(TextureBlockFormat format)
+{
+	switch (format)
+	{
+	case TextureBlockFormat::BC1: return makeFourCC('D', 'X', 'T', '1');
+	case TextureBlockFormat::BC3: return makeFourCC('D', 'X', 'T', '5');
+	case TextureBlockFormat::BC4: return makeFourCC('A', 'T', 'I', '1');
+	case TextureBlockFormat::BC5: return makeFourCC('A', 'T', 'I', '2');
+	}
+	return 0;
+}
+
+static bool tryGetFormat(uint32_t fourCC, TextureBlockFormat& outFormat)
+{
+	for (TextureBlockFormat format : { TextureBlockFormat::BC1, TextureBlockFormat::BC3, TextureBlockFormat::BC4, TextureBlockFormat::BC5 })
+	{
+		if (getFourCC(format) != fourCC) continue;
+		outFormat = format;
+		return true;
+	}
+	return false;
+}
+
+static void getSourceKey(const std::string& fileName, uint64_t& outFileSize, int64_t& outWriteTime)
+{
+	outFileSize = std::filesystem::file_size(fileName);
+	outWriteTime = std::filesystem::last_write_time(fileName).time_since_epoch().count();
+}
+
+#pragma endregion
+
+#pragma region BLOCKS
+
+static size_t getBlockSize(TextureBlockFormat format)
+{
+	return format == TextureBlockFormat::BC1 || format == TextureBlockFormat::BC4 ? 8 : 16;
+}
+
+size_t getBlockCompressedSize(TextureBlockFormat format, int width, int height)
+{
+	return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * getBlockSize(format);
+}
+
+static uint16_t packColor565(const float* rgb)
+{
+	const int r = std::clamp((int)std::lround(rgb[0] * 31.0f / 255.0f), 0, 31);
+	const int g = std::clamp((int)std::lround(rgb[1] * 63.0f / 255.0f), 0, 63);
+	const int b = std::clamp((int)std::lround(rgb[2] * 31.0f / 255.0f), 0, 31);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpackColor565(uint16_t color, int* outRgba)
+{
+	const int r = (color >> 11) & 31;
+	const int g = (color >> 5) & 63;
+	const int b = color & 31;
+	outRgba[0] = (r << 3) | (r >> 2);
+	outRgba[1] = (g << 2) | (g >> 4);
+	outRgba[2] = (b << 3) | (b >> 2);
+	outRgba[3] = 255;
+}
+
+/**
+ * 4 colors if color0 > color1, otherwise 3 colors + transparent black
+ */
+static void buildColorPalette(uint16_t color0, uint16_t color1, int palette[4][4])
+{
+	unpackColor565(color0, palette[0]);
+	unpackColor565(color1, palette[1]);
+	for (int c = 0; c < 3; ++c)
+	{
+		if (color0 > color1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = color0 > color1 ? 255 : 0;
+}
+
+/**
+ * 8 values if value0 > value1, otherwise 6 values + 0 and 255
+ */
+static void buildSingleChannelPalette(int value0, int value1, int palette[8])
+{
+	palette[0] = value0;
+	palette[1] = value1;
+	if (value0 > value1)
+	{
+		for (int i = 2; i < 8; ++i) palette[i] = ((8 - i) * value0 + (i - 1) * value1) / 7;
+	}
+	else
+	{
+		for (int i = 2; i < 6; ++i) palette[i] = ((6 - i) * value0 + (i - 1) * value1) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+/**
+ * BC1 block (also the color half of BC3). The endpoints are the extremes of the colors along their principal axis,
+ * which is about as good as it gets without searching
+ */
+static void encodeColorBlock(const unsigned char pixels[16][4], unsigned char* out)
+{
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i)
+		for (int c = 0; c < 3; ++c) mean[c] += pixels[i][c] / 16.0f;
+
+	float covariance[3][3] = {};
+	for (int i = 0; i < 16; ++i)
+	{
+		const float d[3] = { pixels[i][0] - mean[0], pixels[i][1] - mean[1], pixels[i][2] - mean[2] };
+		for (int a = 0; a < 3; ++a)
+			for (int b = 0; b < 3; ++b) covariance[a][b] += d[a] * d[b];
+	}
+
+	// power iteration, starting from the diagonal of the color cube (also the fallback for blocks of a single color)
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < POWER_ITERATIONS; ++iteration)
+	{
+		float next[3];
+		for (int a = 0; a < 3; ++a) next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+		const float largest = std::max({ std::fabs(next[0]), std::fabs(next[1]), std::fabs(next[2]) });
+		if (largest < 1e-6f) break;
+		for (int a = 0; a < 3; ++a) axis[a] = next[a] / largest;
+	}
+	const float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	for (int a = 0; a < 3; ++a) axis[a] /= axisLength;
+
+	float minT = FLT_MAX;
+	float maxT = -FLT_MAX;
+	for (int i = 0; i < 16; ++i)
+	{
+		const float t = (pixels[i][0] - mean[0]) * axis[0] + (pixels[i][1] - mean[1]) * axis[1] + (pixels[i][2] - mean[2]) * axis[2];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	float end0[3];
+	float end1[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		end0[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+		end1[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+	}
+
+	uint16_t color0 = packColor565(end0);
+	uint16_t color1 = packColor565(end1);
+	if (color0 < color1) std::swap(color0, color1); // always the 4 color mode (BC3 has no other)
+	int palette[4][4];
+	buildColorPalette(color0, color1, palette);
+	const int paletteSize = color0 > color1 ? 4 : 1; // (equal endpoints: one color, the 3 color mode's black must not be picked)
+
+	uint32_t indices = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		int best = 0;
+		int bestDistance = INT_MAX;
+		for (int k = 0; k < paletteSize; ++k)
+		{
+			const int dr = pixels[i][0] - palette[k][0];
+			const int dg = pixels[i][1] - palette[k][1];
+			const int db = pixels[i][2] - palette[k][2];
+			const int distance = dr * dr + dg * dg + db * db;
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				best = k;
+			}
+		}
+		indices |= (uint32_t)best << (2 * i);
+	}
+
+	out[0] = (unsigned char)(color0 & 0xFF);
+	out[1] = (unsigned char)(color0 >> 8);
+	out[2] = (unsigned char)(color1 & 0xFF);
+	out[3] = (unsigned char)(color1 >> 8);
+	for (int b = 0; b < 4; ++b) out[4 + b] = (unsigned char)((indices >> (8 * b)) & 0xFF);
+}
+
+/**
+ * BC4 block (also the alpha half of BC3 and both halves of BC5): the range of the values, always in the 8 value mode
+ */
+static void encodeSingleChannelBlock(const unsigned char pixels[16][4], int channel, unsigned char* out)
+{
+	int low = 255;
+	int high = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		low = std::min(low, (int)pixels[i][channel]);
+		high = std::max(high, (int)pixels[i][channel]);
+	}
+	int palette[8];
+	buildSingleChannelPalette(high, low, palette);
+	const int paletteSize = high > low ? 8 : 1;
+
+	uint64_t indices = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		int best = 0;
+		int bestDistance = INT_MAX;
+		for (int k = 0; k < paletteSize; ++k)
+		{
+			const int distance = std::abs(pixels[i][channel] - palette[k]);
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				best = k;
+			}
+		}
+		indices |= (uint64_t)best << (3 * i);
+	}
+
+	out[0] = (unsigned char)high;
+	out[1] = (unsigned char)low;
+	for (int b = 0; b < 6; ++b) out[2 + b] = (unsigned char)((indices >> (8 * b)) & 0xFF);
+}
+
+static void decodeColorBlock(const unsigned char* block, unsigned char pixels[16][4])
+{
+	const uint16_t color0 = (uint16_t)(block[0] | (block[1] << 8));
+	const uint16_t color1 = (uint16_t)(block[2] | (block[3] << 8));
+	int palette[4][4];
+	buildColorPalette(color0, color1, palette);
+
+	const uint32_t indices = (uint32_t)block[4] | ((uint32_t)block[5] << 8) | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 24);
+	for (int i = 0; i < 16; ++i)
+	{
+		const int index = (indices >> (2 * i)) & 3;
+		for (int c = 0; c < 4; ++c) pixels[i][c] = (unsigned char)palette[index][c];
+	}
+}
+
+static void decodeSingleChannelBlock(const unsigned char* block, int channel, unsigned char pixels[16][4])
+{
+	int palette[8];
+	buildSingleChannelPalette(block[0], block[1], palette);
+
+	uint64_t indices = 0;
+	for (int b = 0; b < 6; ++b) indices |= (uint64_t)block[2 + b] << (8 * b);
+	for (int i = 0; i < 16; ++i) pixels[i][channel] = (unsigned char)palette[(indices >> (3 * i)) & 7];
+}
+
+void compressBlocks(const unsigned char* rgba, int width, int height, TextureBlockFormat format, unsigned char* outBlocks)
+{
+	const int blocksX = (width + 3) / 4;
+	const int blocksY = (height + 3) / 4;
+	const size_t blockSize = getBlockSize(format);
+
+	ThreadPool::getShared().parallelFor(0, blocksY, [&](unsigned int rowBegin, unsigned int rowEnd)
+	{
+		unsigned char pixels[16][4];
+		for (unsigned int blockY = rowBegin; blockY < rowEnd; ++blockY)
+		{
+			for (int blockX = 0; blockX < blocksX; ++blockX)
+			{
+				// (past the edge of the image the last row/column repeats)
+				for (int i = 0; i < 16; ++i)
+				{
+					const int x = std::min(blockX * 4 + i % 4, width - 1);
+					const int y = std::min((int)blockY * 4 + i / 4, height - 1);
+					memcpy(pixels[i], rgba + ((size_t)y * width + x) * 4, 4);
+				}
+
+				unsigned char* out = outBlocks + ((size_t)blockY * blocksX + blockX) * blockSize;
+				switch (format)
+				{
+				case TextureBlockFormat::BC1:
+					encodeColorBlock(pixels, out);
+					break;
+				case TextureBlockFormat::BC3:
+					encodeSingleChannelBlock(pixels, 3, out);
+					encodeColorBlock(pixels, out + 8);
+					break;
+				case TextureBlockFormat::BC4:
+					encodeSingleChannelBlock(pixels, 0, out);
+					break;
+				case TextureBlockFormat::BC5:
+					encodeSingleChannelBlock(pixels, 0, out);
+					encodeSingleChannelBlock(pixels, 1, out + 8);
+					break;
+				}
+			}
+		}
+	});
+}
+
+void decompressBlocks(const unsigned char* blocks, int width, int height, TextureBlockFormat format, unsigned char* outRgba)
+{
+	const int blocksX = (width + 3) / 4;
+	const int blocksY = (height + 3) / 4;
+	const size_t blockSize = getBlockSize(format);
+
+	unsigned char pixels[16][4];
+	for (int blockY = 0; blockY < blocksY; ++blockY)
+	{
+		for (int blockX = 0; blockX < blocksX; ++blockX)
+		{
+			const unsigned char* block = blocks + ((size_t)blockY * blocksX + blockX) * blockSize;
+			for (int i = 0; i < 16; ++i)
+			{
+				pixels[i][0] = pixels[i][1] = pixels[i][2] = 0;
+				pixels[i][3] = 255;
+			}
+			switch (format)
+			{
+			case TextureBlockFormat::BC1:
+				decodeColorBlock(block, pixels);
+				break;
+			case TextureBlockFormat::BC3:
+				decodeColorBlock(block + 8, pixels);
+				decodeSingleChannelBlock(block, 3, pixels);
+				break;
+			case TextureBlockFormat::BC4:
+				decodeSingleChannelBlock(block, 0, pixels);
+				break;
+			case TextureBlockFormat::BC5:
+				decodeSingleChannelBlock(block, 0, pixels);
+				decodeSingleChannelBlock(block + 8, 1, pixels);
+				break;
+			}
+
+			for (int i = 0; i < 16; ++i)
+			{
+				const int x = blockX * 4 + i % 4;
+				const int y = blockY * 4 + i / 4;
+				if (x < width && y < height) memcpy(outRgba + ((size_t)y * width + x) * 4, pixels[i], 4);
+			}
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region COOK
+
+enum class MipFilter
+{
+	SRGB_COLOR, // averaged in linear space, the way the GPU filters sRGB textures
+	LINEAR,
+	NORMAL_MAP // averaged as vectors and renormalized
+};
+
+static float srgbToLinear(unsigned char value)
+{
+	static const std::array<float, 256> table = []()
+	{
+		std::array<float, 256> result;
+		for (int i = 0; i < 256; ++i)
+		{
+			const float v = i / 255.0f;
+			result[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+		}
+		return result;
+	}();
+	return table[value];
+}
+
+static unsigned char linearToSrgb(float value)
+{
+	const float v = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+	return (unsigned char)std::clamp((int)std::lround(v * 255.0f), 0, 255);
+}
+
+/**
+ * Next mip level: every pixel is the average of the 2x2 pixels above it (for odd sizes the last row/column is used twice)
+ */
+static std::vector<unsigned char> downsample(const std::vector<unsigned char>& rgba, int width, int height, MipFilter filter)
+{
+	const int halfWidth = std::max(width / 2, 1);
+	const int halfHeight = std::max(height / 2, 1);
+	std::vector<unsigned char> result((size_t)halfWidth * halfHeight * 4);
+
+	for (int y = 0; y < halfHeight; ++y)
+	{
+		for (int x = 0; x < halfWidth; ++x)
+		{
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int sample = 0; sample < 4; ++sample)
+			{
+				const int sourceX = std::min(x * 2 + sample % 2, width - 1);
+				const int sourceY = std::min(y * 2 + sample / 2, height - 1);
+				const unsigned char* pixel = &rgba[((size_t)sourceY * width + sourceX) * 4];
+				for (int c = 0; c < 3; ++c)
+				{
+					if (filter == MipFilter::SRGB_COLOR) sum[c] += srgbToLinear(pixel[c]);
+					else if (filter == MipFilter::NORMAL_MAP) sum[c] += pixel[c] / 255.0f * 2.0f - 1.0f;
+					else sum[c] += pixel[c] / 255.0f;
+				}
+				sum[3] += pixel[3];
+			}
+
+			unsigned char* out = &result[((size_t)y * halfWidth + x) * 4];
+			if (filter == MipFilter::NORMAL_MAP)
+			{
+				const float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+				for (int c = 0; c < 3; ++c)
+				{
+					const float n = length > 0.0f ? sum[c] / length : 0.0f;
+					out[c] = (unsigned char)std::clamp((int)std::lround((n * 0.5f + 0.5f) * 255.0f), 0, 255);
+				}
+			}
+			else
+			{
+				for (int c = 0; c < 3; ++c)
+				{
+					out[c] = filter == MipFilter::SRGB_COLOR ? linearToSrgb(sum[c] / 4.0f)
+						: (unsigned char)std::clamp((int)std::lround(sum[c] / 4.0f * 255.0f), 0, 255);
+				}
+			}
+			out[3] = (unsigned char)std::lround(sum[3] / 4.0f);
+		}
+	}
+	return result;
+}
+
+/**
+ * Peak signal to noise ratio (in dB) of the blocks compared to the pixels, over the channels the format stores
+ */
+static double measureRoundTrip(const std::vector<unsigned char>& rgba, const unsigned char* blocks, int width, int height, TextureBlockFormat format)
+{
+	std::vector<unsigned char> decoded(rgba.size());
+	decompressBlocks(blocks, width, height, format, decoded.data());
+
+	const int channelCount = format == TextureBlockFormat::BC1 ? 3 : format == TextureBlockFormat::BC3 ? 4 : format == TextureBlockFormat::BC4 ? 1 : 2;
+	double squaredError = 0.0;
+	for (size_t pixel = 0; pixel < rgba.size(); pixel += 4)
+	{
+		for (int c = 0; c < channelCount; ++c)
+		{
+			const double difference = (double)rgba[pixel + c] - (double)decoded[pixel + c];
+			squaredError += difference * difference;
+		}
+	}
+	const double meanSquaredError = squaredError / ((double)(rgba.size() / 4) * channelCount);
+	return meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+}
+
+bool cookTexture(const std::string& path, const std::string& directory, bool isNormalMap)
+{
+	const std::string fileName = directory + '/' + path; // (same as decodeTextureFile())
+	const std::string cookedPath = fileName + COOKED_TEXTURE_EXTENSION;
+
+	CookedTexture* upToDate = openCookedTexture(fileName);
+	if (upToDate != nullptr)
+	{
+		delete upToDate;
+		return true;
+	}
+
+	// flipped the same way decodeTextureFile() does, so the cooked texture is a drop-in replacement
+	int width, height, channels;
+	stbi_set_flip_vertically_on_load_thread(true);
+	unsigned char* data = stbi_load(fileName.c_str(), &width, &height, &channels, 4);
+	stbi_set_flip_vertically_on_load_thread(false);
+	if (data == nullptr)
+	{
+		std::cout << "Could not cook texture, failed to load: '" << fileName << "'" << std::endl;
+		return false;
+	}
+	std::vector<unsigned char> level(data, data + (size_t)width * height * 4);
+	stbi_image_free(data);
+
+	bool hasAlpha = false;
+	for (size_t pixel = 3; pixel < level.size() && !hasAlpha; pixel += 4) hasAlpha = level[pixel] != 255;
+
+	// single channel images were uploaded as GL_RED, BC4 keeps them that way
+	TextureBlockFormat format = TextureBlockFormat::BC1;
+	if (isNormalMap) format = TextureBlockFormat::BC5;
+	else if (channels == 1) format = TextureBlockFormat::BC4;
+	else if (hasAlpha) format = TextureBlockFormat::BC3;
+	const MipFilter filter = isNormalMap ? MipFilter::NORMAL_MAP : channels == 1 ? MipFilter::LINEAR : MipFilter::SRGB_COLOR;
+
+	std::cout << "Cooking texture: '" << fileName << "'" << std::endl;
+	std::vector<unsigned char> blocks;
+	double quality = 0.0;
+	int mipCount = 0;
+	for (int levelWidth = width, levelHeight = height; ; ++mipCount)
+	{
+		const size_t offset = blocks.size();
+		blocks.resize(offset + getBlockCompressedSize(format, levelWidth, levelHeight));
+		compressBlocks(level.data(), levelWidth, levelHeight, format, blocks.data() + offset);
+		if (mipCount == 0) quality = measureRoundTrip(level, blocks.data(), levelWidth, levelHeight, format);
+
+		if (levelWidth == 1 && levelHeight == 1) break;
+		level = downsample(level, levelWidth, levelHeight, filter);
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+	}
+	mipCount++;
+
+	uint64_t sourceFileSize;
+	int64_t sourceWriteTime;
+	getSourceKey(fileName, sourceFileSize, sourceWriteTime);
+
+	DDSHeader header = {};
+	header.size = sizeof(DDSHeader);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header.height = (uint32_t)height;
+	header.width = (uint32_t)width;
+	header.pitchOrLinearSize = (uint32_t)getBlockCompressedSize(format, width, height);
+	header.mipMapCount = (uint32_t)mipCount;
+	header.reserved1[0] = COOKED_TEXTURE_MAGIC;
+	header.reserved1[1] = COOKED_TEXTURE_VERSION;
+	memcpy(&header.reserved1[2], &sourceFileSize, sizeof(sourceFileSize));
+	memcpy(&header.reserved1[4], &sourceWriteTime, sizeof(sourceWriteTime));
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.pixelFormat.fourCC = getFourCC(format);
+	header.caps = DDSCAPS_TEXTURE | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+
+	// written to a temporary file first so a cooked texture is never left half-written
+	const std::string tempPath = cookedPath + ".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		const uint32_t magic = DDS_MAGIC;
+		out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(blocks.data()), blocks.size());
+		if (!out)
+		{
+			std::cout << "Could not write cooked texture: '" << cookedPath << "'" << std::endl;
+			return true; // (the image itself is fine, it's just not cooked)
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tempPath, cookedPath, error);
+	if (error) std::cout << "Could not write cooked texture: '" << cookedPath << "' (" << error.message() << ")" << std::endl;
+
+	const char* formatNames[] = { "BC1", "BC3", "BC4", "BC5" };
+	std::cout << "Cooked " << width << "x" << height << " as " << formatNames[(int)format] << " with " << mipCount << " mip levels: "
+		<< (double)blocks.size() / (1024.0 * 1024.0) << " MB (PSNR " << quality << " dB"
+		<< (quality < COOK_PSNR_WARNING ? ", LOW" : "") << ")" << std::endl;
+	return true;
+}
+
+CookedTexture* openCookedTexture(const std::string& fileName)
+{
+	const std::string cookedPath = fileName + COOKED_TEXTURE_EXTENSION;
+	if (!std::filesystem::exists(fileName) || !std::filesystem::exists(cookedPath)) return nullptr;
+
+	CookedTexture* cooked = new CookedTexture();
+	MappedFile& file = cooked->file;
+	if (!file.open(cookedPath) || file.getSize() < sizeof(uint32_t) + sizeof(DDSHeader))
+	{
+		delete cooked;
+		return nullptr;
+	}
+
+	uint32_t magic;
+	DDSHeader header;
+	memcpy(&magic, file.getData(), sizeof(magic));
+	memcpy(&header, file.getData() + sizeof(magic), sizeof(header));
+
+	uint64_t sourceFileSize;
+	int64_t sourceWriteTime;
+	getSourceKey(fileName, sourceFileSize, sourceWriteTime);
+	uint64_t cookedFileSize;
+	int64_t cookedWriteTime;
+	memcpy(&cookedFileSize, &header.reserved1[2], sizeof(cookedFileSize));
+	memcpy(&cookedWriteTime, &header.reserved1[4], sizeof(cookedWriteTime));
+
+	TextureBlockFormat format;
+	bool isUpToDate = magic == DDS_MAGIC && header.size == sizeof(DDSHeader)
+		&& header.reserved1[0] == COOKED_TEXTURE_MAGIC && header.reserved1[1] == COOKED_TEXTURE_VERSION
+		&& cookedFileSize == sourceFileSize && cookedWriteTime == sourceWriteTime
+		&& (header.pixelFormat.flags & DDPF_FOURCC) && tryGetFormat(header.pixelFormat.fourCC, format)
+		&& header.width > 0 && header.height > 0 && header.mipMapCount > 0;
+
+	// every mip level has to be there
+	size_t blocksSize = 0;
+	if (isUpToDate)
+	{
+		int width = (int)header.width;
+		int height = (int)header.height;
+		for (uint32_t mip = 0; mip < header.mipMapCount; ++mip)
+		{
+			blocksSize += getBlockCompressedSize(format, width, height);
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+		isUpToDate = file.getSize() == sizeof(uint32_t) + sizeof(DDSHeader) + blocksSize;
+	}
+	if (!isUpToDate)
+	{
+		delete cooked;
+		return nullptr;
+	}
+
+	cooked->format = format;
+	cooked->width = (int)header.width;
+	cooked->height = (int)header.height;
+	cooked->mipCount = (int)header.mipMapCount;
+	cooked->blocks = file.getData() + sizeof(uint32_t) + sizeof(DDSHeader);
+	cooked->blocksSize = blocksSize;
+	return cooked;
+}
+
+#pragma endregion
@@ -0,0 +1,70 @@
+#ifndef TEXTURECOMPRESSION_MINE_H
+#define TEXTURECOMPRESSION_MINE_H
+#include <cstddef>
+#include <string>
+
+#include "MappedFile.h"
+
+/**
+ * \brief GPU block compression formats: every 4x4 pixels are stored in a fixed size block, which the GPU samples as is
+ */
+enum class TextureBlockFormat
+{
+	BC1, // RGB, 8 bytes per block (color textures without alpha)
+	BC3, // RGBA, 16 bytes per block (color textures with alpha)
+	BC4, // R, 8 bytes per block (single channel textures)
+	BC5  // RG, 16 bytes per block (normal maps: z is rebuilt in the shaders)
+};
+
+/**
+ * \brief A cooked texture file (see cookTexture()), memory mapped. The blocks of every mip level (largest first) are uploaded
+ * straight from the mapping, see uploadTexture().
+ */
+struct CookedTexture
+{
+	TextureBlockFormat format = TextureBlockFormat::BC1;
+	int width = 0;
+	int height = 0;
+	int mipCount = 0;
+	const unsigned char* blocks = nullptr; // points into file
+	size_t blocksSize = 0;
+	MappedFile file;
+};
+
+/**
+ * \brief Size of one mip level in the given format (partial blocks at the edges count as whole ones)
+ */
+size_t getBlockCompressedSize(TextureBlockFormat format, int width, int height);
+
+/**
+ * \brief Compresses RGBA pixels (4 bytes each, row after row) into blocks. Runs on the shared ThreadPool, so don't call it from a task of that pool.
+ *
+ * \param outBlocks		getBlockCompressedSize() bytes
+ */
+void compressBlocks(const unsigned char* rgba, int width, int height, TextureBlockFormat format, unsigned char* outBlocks);
+
+/**
+ * \brief CPU decoder for the blocks, the same way the GPU samples them. Channels the format doesn't have come out as 0 (alpha as 255).
+ *
+ * \param outRgba		width * height * 4 bytes
+ */
+void decompressBlocks(const unsigned char* blocks, int width, int height, TextureBlockFormat format, unsigned char* outRgba);
+
+/**
+ * \brief Offline "cook" step: converts the image to a block compressed DDS file right next to it (with every mip level precomputed),
+ * unless that file is already up to date. The format is picked from the image: BC5 for normal maps, BC4 for single channel
+ * images, BC3 if there's any transparency, BC1 otherwise. The first mip level is decompressed again and compared with the
+ * image, the quality (PSNR) is logged.
+ *
+ * \param path			same path rules as loadTextureFromFile()
+ * \return false if the image could not be read
+ */
+bool cookTexture(const std::string& path, const std::string& directory, bool isNormalMap);
+
+/**
+ * \brief The cooked version of the image file (directory + '/' + path), if there is one that's up to date with it.
+ * The caller owns the result, nullptr if there is none.
+ */
+CookedTexture* openCookedTexture(const std::string& fileName);
+
+#endif
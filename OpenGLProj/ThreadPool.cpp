@@ -0,0 +1,126 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	for (unsigned int i = 0; i < threadCount; ++i)
+		this->_workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_stopping = true;
+	}
+	this->_condition.notify_all();
+	for (std::thread& worker : this->_workers) worker.join();
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task)
+{
+	std::packaged_task<void()> packaged(std::move(task));
+	std::future<void> result = packaged.get_future();
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		this->_tasks.push(std::move(packaged));
+	}
+	this->_condition.notify_one();
+	return result;
+}
+
+void ThreadPool::parallelFor(unsigned int begin, unsigned int end, const std::function<void(unsigned int, unsigned int)>& bandFunc)
+{
+	if (end <= begin) return;
+
+	const unsigned int count = end - begin;
+	const unsigned int bandSize = (count + this->getThreadCount()) / (this->getThreadCount() + 1);
+	const unsigned int bandCount = (count + bandSize - 1) / bandSize;
+
+	// Bands are claimed one at a time by whoever gets there first: the calling thread, or a worker that picks up one of the helpers.
+	// A helper that only gets picked up once every band is claimed does nothing, so it may outlive this call (hence the shared state,
+	// bandFunc is only touched for a claimed band, and those are all done before this returns)
+	struct Bands
+	{
+		std::atomic<unsigned int> next = 0;
+		unsigned int done = 0;
+		std::exception_ptr error;
+		std::mutex mutex;
+		std::condition_variable condition;
+	};
+	const std::shared_ptr<Bands> bands = std::make_shared<Bands>();
+	const std::function<void(unsigned int, unsigned int)>* func = &bandFunc;
+	auto runBands = [bands, func, begin, end, bandSize, bandCount]()
+	{
+		for (unsigned int band = bands->next++; band < bandCount; band = bands->next++)
+		{
+			const unsigned int bandBegin = begin + band * bandSize;
+			std::exception_ptr error;
+			try
+			{
+				(*func)(bandBegin, std::min(bandBegin + bandSize, end));
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+
+			std::lock_guard<std::mutex> lock(bands->mutex);
+			if (error && !bands->error) bands->error = error;
+			if (++bands->done == bandCount) bands->condition.notify_all();
+		}
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(this->_mutex);
+		for (unsigned int helper = 1; helper < bandCount; ++helper) this->_bandTasks.push(runBands);
+	}
+	this->_condition.notify_all();
+	runBands();
+
+	// (only the bands that workers are in the middle of are left by now)
+	std::unique_lock<std::mutex> lock(bands->mutex);
+	bands->condition.wait(lock, [&bands, bandCount]() { return bands->done == bandCount; });
+	if (bands->error) std::rethrow_exception(bands->error);
+}
+
+unsigned int ThreadPool::getThreadCount() const
+{
+	return (unsigned int)this->_workers.size();
+}
+
+ThreadPool& ThreadPool::getShared()
+{
+	static ThreadPool shared(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	return shared;
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::packaged_task<void()> task;
+		std::function<void()> bandTask;
+		{
+			std::unique_lock<std::mutex> lock(this->_mutex);
+			this->_condition.wait(lock, [this]() { return this->_stopping || !this->_tasks.empty() || !this->_bandTasks.empty(); });
+			if (!this->_bandTasks.empty())
+			{
+				bandTask = std::move(this->_bandTasks.front());
+				this->_bandTasks.pop();
+			}
+			else
+			{
+				if (this->_stopping && this->_tasks.empty()) return;
+				task = std::move(this->_tasks.front());
+				this->_tasks.pop();
+			}
+		}
+		if (bandTask) bandTask();
+		else task();
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef THREADPOOL_MINE_H
+#define THREADPOOL_MINE_H
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief A fixed set of worker threads that run submitted tasks in FIFO order.
+ *
+ * The bands of parallelFor() (per frame work, like the animation) go in a lane of their own that the workers empty first, and the
+ * calling thread does every band no worker has picked up yet itself. So a frame never waits behind long background tasks
+ * (tile builds, asset loads) that happen to be queued up.
+ *
+ * **Note** tasks should not wait on the futures of other tasks of the same pool, since all workers could end up waiting on work
+ * that nobody is left to pick up (parallelFor() is fine, see above).
+ */
+class ThreadPool
+{
+public:
+	/**
+	 * \param threadCount		number of worker threads. 0 is allowed: parallelFor() then runs everything on the calling thread
+	 */
+	explicit ThreadPool(unsigned int threadCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * \brief Queues up a task. Exceptions thrown by the task are rethrown from the returned future's get().
+	 */
+	std::future<void> submit(std::function<void()> task);
+
+	/**
+	 * \brief Splits [begin, end) into contiguous bands (one per worker + one for the calling thread) and blocks until all of them are done.
+	 * Only ever waits for bands that a worker is already running, the calling thread takes any that are still unclaimed.
+	 *
+	 * \param bandFunc		called as bandFunc(bandBegin, bandEnd) for every band
+	 */
+	void parallelFor(unsigned int begin, unsigned int end, const std::function<void(unsigned int, unsigned int)>& bandFunc);
+
+	unsigned int getThreadCount() const;
+
+	/**
+	 * \brief Pool shared by the whole program, sized to the number of hardware threads (minus the main thread).
+	 */
+	static ThreadPool& getShared();
+
+private:
+	std::vector<std::thread> _workers;
+	std::queue<std::packaged_task<void()>> _tasks;
+	std::queue<std::function<void()>> _bandTasks; // parallelFor() helpers, taken before any of _tasks
+	std::mutex _mutex;
+	std::condition_variable _condition;
+	bool _stopping = false;
+
+	void workerLoop();
+};
+
+#endif
@@ -50,11 +50,29 @@ void Thumper::onNewFrame()
 
 void Thumper::draw(Shader& shader)
 {
-	const std::vector<glm::mat4> transforms = this->_animator.getFinalBoneMatrices();
-	this->setupEntityShaderForAnim(shader, transforms);
+	this->drawAnimatedModel(shader);
+}
+
+bool Thumper::isVisible(const ViewFrustum& frustum)
+{
+	return this->_model->isVisible(frustum, ANIMATED_BOUNDS_SCALE);
+}
+
+Animator& Thumper::getAnimator()
+{
+	return this->_animator;
+}
+
+void Thumper::updateAnimationLod(const ViewFrustum& frustum, const glm::vec3& cameraPos, float fovY)
+{
+	// in the player's hands it's always right in front of the camera (drawn by drawCarried(), not in its world position)
+	if (this->_isCarried) this->_animator.updateLod(1.0f, true);
+	else AnimatedEntity::updateAnimationLod(frustum, cameraPos, fovY);
+}
 
-	this->_model->draw(shader);
-	this->clearEntityShaderForAnim(shader);
+RenderableGameObject* Thumper::getAnimatedModel()
+{
+	return this->_model;
 }
 
 void Thumper::setState(STATE newState)
@@ -28,6 +28,10 @@ public:
 
 	void onNewFrame() override;
 	void draw(Shader& shader) override;
+	bool isVisible(const ViewFrustum& frustum) override;
+	Animator& getAnimator() override;
+	void updateAnimationLod(const ViewFrustum& frustum, const glm::vec3& cameraPos, float fovY) override;
+	RenderableGameObject* getAnimatedModel() override;
 
 	void setState(STATE newState);
 	STATE getState() const;
@@ -130,6 +130,28 @@ void UITextRenderer::renderMainUIOverlay(const glm::vec3 cameraPos)
 	this->_font->renderText(".", this->_currentWidth / 2.0f, this->_currentHeight / 2.0f, 0.5f, Colors::WHITE);
 }
 
+void UITextRenderer::renderCullingStats(const CullingStats& stats)
+{
+	this->_font->renderText(
+		std::format("drawn:{} culled:{}", stats.drawn, stats.culled),
+		25.0f,
+		this->_currentHeight - 50.0f,
+		0.5f,
+		Colors::WHITE
+	);
+}
+
+void UITextRenderer::renderPoseCacheStats(const PoseCacheStats& frameStats, const PoseCacheStats& totalStats)
+{
+	this->_font->renderText(
+		std::format("pose cache hits:{}/{} total:{:.1f}%", frameStats.hits, frameStats.lookups, totalStats.getHitRate() * 100.0f),
+		25.0f,
+		this->_currentHeight - 75.0f,
+		0.5f,
+		Colors::WHITE
+	);
+}
+
 void UITextRenderer::requestDialogue(const std::string& speaker, const std::string& spokenDialoge,
 	const float durationOfShowing, const glm::vec3& speakerPositionInWorld)
 {
@@ -4,8 +4,10 @@
 
 #include "Font.h"
 #include "PlayerCamera.h"
+#include "PoseCache.h"
 #include "SphericalBoundingBoxedEntity.h"
 #include "UICharacterDialogueDisplayManager.h"
+#include "ViewFrustum.h"
 #include "WorldTimeManager.h"
 
 struct DialogueRequest {
@@ -30,6 +32,16 @@ public:
 
 	void renderMainUIOverlay(const glm::vec3 cameraPos);
 
+	/**
+	 * \brief Shows how many things were drawn/culled this frame (right below the coordinates)
+	 */
+	void renderCullingStats(const CullingStats& stats);
+
+	/**
+	 * \brief Shows how often animators could reuse a pose this frame and overall (right below the culling stats)
+	 */
+	void renderPoseCacheStats(const PoseCacheStats& frameStats, const PoseCacheStats& totalStats);
+
 	void requestDialogue(
 		const std::string& speaker, 
 		const std::string& spokenDialoge, 
@@ -0,0 +1,48 @@
+#include "ViewFrustum.h"
+
+#include <glm/glm.hpp>
+
+ViewFrustum::ViewFrustum(const glm::mat4& projectionView)
+{
+	// glm is column major: m[column][row]
+	const glm::mat4& m = projectionView;
+	const glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	this->_planes[0] = row3 + row0; // left
+	this->_planes[1] = row3 - row0; // right
+	this->_planes[2] = row3 + row1; // bottom
+	this->_planes[3] = row3 - row1; // top
+	this->_planes[4] = row3 + row2; // near
+	this->_planes[5] = row3 - row2; // far
+
+	// normalize so the plane equation gives actual distances (needed for the sphere radius test)
+	for (glm::vec4& plane : this->_planes)
+		plane /= glm::length(glm::vec3(plane));
+}
+
+bool ViewFrustum::isSphereVisible(const glm::vec3& center, float radius) const
+{
+	for (const glm::vec4& plane : this->_planes)
+	{
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+	}
+	return true;
+}
+
+bool ViewFrustum::isBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+{
+	for (const glm::vec4& plane : this->_planes)
+	{
+		// the corner of the box that lies furthest along the plane normal
+		const glm::vec3 positiveVertex = glm::vec3(
+			plane.x >= 0.0f ? boxMax.x : boxMin.x,
+			plane.y >= 0.0f ? boxMax.y : boxMin.y,
+			plane.z >= 0.0f ? boxMax.z : boxMin.z
+		);
+		if (glm::dot(glm::vec3(plane), positiveVertex) + plane.w < 0.0f) return false;
+	}
+	return true;
+}
@@ -0,0 +1,43 @@
+#ifndef VIEWFRUSTUM_MINE_H
+#define VIEWFRUSTUM_MINE_H
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+/**
+ * \brief Per-frame counter of how many items were culled vs actually drawn
+ */
+struct CullingStats
+{
+	unsigned int drawn = 0;
+	unsigned int culled = 0;
+};
+
+/**
+ * \brief The 6 planes of a view frustum, used to skip drawing things that are off-screen.
+ *
+ * The planes are extracted straight from the (projection * view) matrix as described in
+ * "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix" by Gil Gribb and Klaus Hartmann.
+ *
+ * Passing (projection * view * model) instead gives the frustum in the local space of that model.
+ */
+class ViewFrustum
+{
+public:
+	ViewFrustum(const glm::mat4& projectionView);
+
+	/**
+	 * \return false only if the sphere lies entirely outside of the frustum
+	 */
+	bool isSphereVisible(const glm::vec3& center, float radius) const;
+
+	/**
+	 * \return false only if the axis aligned box lies entirely outside of the frustum
+	 */
+	bool isBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+private:
+	glm::vec4 _planes[6]; // (normal, distance), normal points inwards
+};
+
+#endif
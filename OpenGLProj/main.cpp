@@ -17,11 +17,14 @@
 #define STB_IMAGE_IMPLEMENTATION
 
 #include <filesystem>
+#include <optional>
 #include <set>
 #include <GL/gl.h>
 
 #include "Animation.h"
 #include "Animator.h"
+#include "AssetRegistry.h"
+#include "BonePaletteBuffer.h"
 #include "Colors.h"
 #include "ErrorUtils.h"
 #include "Font.h"
@@ -35,6 +38,7 @@
 #include "DistanceFieldPostProcessor.h"
 #include "Quad.h"
 #include "RenderableGameObject.h"
+#include "SkinningPass.h"
 #include "Skybox.h"
 #include "SphericalBoxedGameObject.h"
 #include "Sun.h"
@@ -54,8 +58,11 @@
 #include "PlayerInteractionManger.h"
 #include "SandWormCharacter.h"
 #include "SoundManager.h"
+#include "TextureCache.h"
+#include "TextureCompression.h"
 #include "Thumper.h"
 #include "WorldTimeManager.h"
+#include "ViewFrustum.h"
 
 // keeping this at a power of two to support the outline-rendering JFA algorithm.
 // I could make this not a power of two but then I need to perform some annoying buffer size remappings during the JFA algo.
@@ -134,7 +141,7 @@ void setupAttenuatedLightSpheres(Shader& targetShader, const float c1, const flo
 
 std::vector<glm::vec3> computeAttenuatedLightSpheresPos(Terrain& terrain, const float t);
 
-void renderTerrain(Shader& terrainShader, Terrain& terrain, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, const std::vector<glm::vec3>& smallLightSpherePositions);
+void renderTerrain(Shader& terrainShader, Terrain& terrain, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, const std::vector<glm::vec3>& smallLightSpherePositions, CullingStats& cullingStats);
 
 
 
@@ -202,13 +209,46 @@ void handleAssignmentOnlyPuppetController(const float t, GLFWwindow* window, San
 	}
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+	// offline step: only (re)build the cooked terrain, model, animation and texture caches, so the next launch can skip generating the terrain,
+	// importing the models and animations and decoding the textures (which are then uploaded block compressed, with their mips precomputed)
+	if (argc > 1 && std::string(argv[1]) == "--cook")
+	{
+		Terrain::cookCache(TERRAIN_HEIGHTMAP, TERRAIN_Y_SCALE_MULTIPLIER, TERRAIN_Y_SHIFT);
+		for (const char* model : { MODEL_ORNITHOPTER, MODEL_THUMPER, MODEL_NOMAD, MODEL_SANDWORM, MODEL_CONTAINER_SMALL, MODEL_CONTAINER_LARGE })
+			Model::cookCache(model);
+		for (const char* animatedModel : { MODEL_ORNITHOPTER, MODEL_THUMPER, MODEL_NOMAD, MODEL_SANDWORM })
+			AnimationSet::cookCache(animatedModel);
+		for (const char* texture : { TERRAIN_TEXTURE_PRIMARY, TERRAIN_TEXTURE_DARKER, TEXTURE_PARTICLE_DUST })
+			cookTexture(texture, PROJ_CURRENT_DIR, false);
+		cookTexture(TERRAIN_NORMAL_MAP, PROJ_CURRENT_DIR, true);
+		return 0;
+	}
+
 	GLFWwindow* window = init();
 	if (window == nullptr) return -1;
 
 	SoundManager sound(AUDIO_BASE_PATH);
 
+#pragma region ASSET_REQUESTS
+	// everything that comes from disk starts loading on the worker threads right away, the GL only work below runs in the meantime
+	// (the animations are asked for before the models, so every file is imported at most once, for both its mesh and its animations).
+	// Not the font (FreeType renders a few small glyphs in between their uploads) nor the terrain: it's a mapped file when its cache
+	// is up to date, and otherwise its generation spreads over the pool by itself (parallelFor)
+	AssetRegistry assets;
+	for (const char* animatedModel : { MODEL_ORNITHOPTER, MODEL_THUMPER, MODEL_NOMAD, MODEL_SANDWORM })
+		assets.requestAnimationSet(animatedModel);
+	for (const char* model : { MODEL_CONTAINER_SMALL, MODEL_CONTAINER_LARGE })
+		assets.requestModel(model);
+	assets.requestTexture(TERRAIN_TEXTURE_PRIMARY, USE_SRGB_COLORS);
+	assets.requestTexture(TERRAIN_TEXTURE_DARKER, USE_SRGB_COLORS);
+	assets.requestTexture(TERRAIN_NORMAL_MAP, false); // (data, no gamma correction)
+	assets.requestTexture(TEXTURE_PARTICLE_DUST, USE_SRGB_COLORS); // (the particle systems then find it in the TextureCache)
+	for (const std::string& face : SKYBOX_FACES)
+		assets.requestImage(face, false);
+#pragma endregion
+
 #pragma region SHADERS_AND_POSTPROCESSING
 	Shader genericShader = Shader::fromFiles(SHADER_MESH_VERT, SHADER_MESH_FRAG);
 	genericShader.use();
@@ -217,8 +257,13 @@ int main()
 	genericShader.setVec3("light.diffuse", sunLightColor * 1.0f);
 	genericShader.setVec3("light.specular", sunLightColor * 1.0f);
 	genericShader.setBool("doAnimate", false);
+	BonePaletteBuffer::setupShader(genericShader);
+	BonePaletteBuffer bonePalette;
 
 	Shader particlesShader = Shader::fromFiles(SHADER_PARTICLES_VERT, SHADER_PARTICLES_FRAG);
+	Shader skyboxShader = Shader::fromFiles(SHADER_SKYBOX_VERT, SHADER_SKYBOX_FRAG);
+	Shader lightCubeShader = Shader::fromFiles(SHADER_LIGHTSOURCE_VERT, SHADER_LIGHTSOURCE_FRAG);
+	Shader terrainShader = Shader::fromFiles(SHADER_TERRAIN_VERT, SHADER_TERRAIN_FRAG);
 
 	Quad screen2Dquad = Quad();
 	DistanceFieldPostProcessor distanceFieldPostProcessor(&screen2Dquad, currentWidth, currentHeight);
@@ -226,61 +271,62 @@ int main()
 	distanceFieldPostProcessor.setOutlinePulsate(true);
 #pragma endregion
 
+#pragma region TEXT
+	Shader fontShader = Shader::fromFiles(SHADER_FONT_VERT, SHADER_FONT_FRAG);
+	glm::mat4 textProjection = glm::ortho(0.0f, (float)currentWidth, 0.0f, (float)currentHeight);
+	fontShader.use();
+	fontShader.setMat4("projection", textProjection);
+	Font font(FONT_PLAY_REGULAR, &fontShader);
+#pragma endregion
+
+	assets.waitForRequests(); // (uploads everything as it comes in)
+	assets.printStartupReport();
+
 #pragma region GAME_MODELS
-	RenderableGameObject ornithopterObject(MODEL_ORNITHOPTER);
-	AnimationSet ornithopterAnimations(MODEL_ORNITHOPTER, ornithopterObject.getObjectModel());
+	AnimationSet* ornithopterAnimations = assets.getAnimationSet(MODEL_ORNITHOPTER);
+	RenderableGameObject ornithopterObject(assets.getModel(MODEL_ORNITHOPTER));
 
-	Model thumperModel(MODEL_THUMPER); // reuse the model
-	AnimationSet thumperAnimations(MODEL_THUMPER, &thumperModel);
-	SphericalBoxedGameObject thumperObject1(&thumperModel, 0.4f);
-	SphericalBoxedGameObject thumperObject2(&thumperModel, 0.4f);
+	AnimationSet* thumperAnimations = assets.getAnimationSet(MODEL_THUMPER);
+	SphericalBoxedGameObject thumperObject1(assets.getModel(MODEL_THUMPER), 0.4f); // reuse the model
+	SphericalBoxedGameObject thumperObject2(assets.getModel(MODEL_THUMPER), 0.4f);
 
-	SphericalBoxedGameObject nomadObject(MODEL_NOMAD, 0.6f, glm::vec3(0.0, 1.45f, 0.0), 100.0f);
-	AnimationSet nomadAnimations(MODEL_NOMAD, nomadObject.getObjectModel());
+	AnimationSet* nomadAnimations = assets.getAnimationSet(MODEL_NOMAD);
+	SphericalBoxedGameObject nomadObject(assets.getModel(MODEL_NOMAD), 0.6f, glm::vec3(0.0, 1.45f, 0.0), 100.0f);
 
-	RenderableGameObject sandWormObject(MODEL_SANDWORM);
-	AnimationSet sandWormAnimations(MODEL_SANDWORM, sandWormObject.getObjectModel());
+	AnimationSet* sandWormAnimations = assets.getAnimationSet(MODEL_SANDWORM);
+	RenderableGameObject sandWormObject(assets.getModel(MODEL_SANDWORM));
 
-	Model containerSmallModel(MODEL_CONTAINER_SMALL);
-	SphericalBoxedGameObject containerSObject1(&containerSmallModel, 0.6f, glm::vec3(0.0), 60.0f);
-	SphericalBoxedGameObject containerSObject2(&containerSmallModel, 0.6f, glm::vec3(0.0), 60.0f);
+	SphericalBoxedGameObject containerSObject1(assets.getModel(MODEL_CONTAINER_SMALL), 0.6f, glm::vec3(0.0), 60.0f);
+	SphericalBoxedGameObject containerSObject2(assets.getModel(MODEL_CONTAINER_SMALL), 0.6f, glm::vec3(0.0), 60.0f);
 
-	Model containerLargeModel(MODEL_CONTAINER_LARGE);
-	RenderableGameObject containerLObject1(&containerLargeModel);
-	RenderableGameObject containerLObject2(&containerLargeModel);
-	RenderableGameObject containerLObject3(&containerLargeModel);
+	RenderableGameObject containerLObject1(assets.getModel(MODEL_CONTAINER_LARGE));
+	RenderableGameObject containerLObject2(assets.getModel(MODEL_CONTAINER_LARGE));
+	RenderableGameObject containerLObject3(assets.getModel(MODEL_CONTAINER_LARGE));
 
 	// I'll use this as my second light source
 	Sphere sphere(20, 20, 1.0f);
 #pragma endregion
 
-#pragma region TEXT
-	Shader fontShader = Shader::fromFiles(SHADER_FONT_VERT, SHADER_FONT_FRAG);
-	glm::mat4 textProjection = glm::ortho(0.0f, (float)currentWidth, 0.0f, (float)currentHeight);
-	fontShader.use();
-	fontShader.setMat4("projection", textProjection);
-	Font font(FONT_PLAY_REGULAR, &fontShader);
-#pragma endregion
-
 #pragma region SKYBOX
-	Shader skyboxShader = Shader::fromFiles(SHADER_SKYBOX_VERT, SHADER_SKYBOX_FRAG);
-	Skybox skybox(&skyboxShader, SKYBOX_FACES);
+	Skybox skybox(&skyboxShader, [&assets]() {
+		std::vector<DecodedTexture> faces; // (freed again as soon as they're uploaded)
+		for (const std::string& face : SKYBOX_FACES) faces.push_back(assets.takeImage(face));
+		return faces;
+	}());
 #pragma endregion
 
 #pragma region SUN
-	Shader lightCubeShader = Shader::fromFiles(SHADER_LIGHTSOURCE_VERT, SHADER_LIGHTSOURCE_FRAG);
 	const glm::mat4 lightCubeModel = LIGHT_CUBE_MODEL(sunPos);
 	Sun sun(&lightCubeShader, lightCubeModel, sunLightColor);
 #pragma endregion
 
 #pragma region TERRAIN
-	Shader terrainShader = Shader::fromFiles(SHADER_TERRAIN_VERT, SHADER_TERRAIN_FRAG);
 	Terrain sandTerrain(
 		&terrainShader, 
 		TERRAIN_HEIGHTMAP,
-		TERRAIN_TEXTURE_PRIMARY,
-		TERRAIN_TEXTURE_DARKER,
-		TERRAIN_NORMAL_MAP,
+		assets.getTexture(TERRAIN_TEXTURE_PRIMARY),
+		assets.getTexture(TERRAIN_TEXTURE_DARKER),
+		assets.getTexture(TERRAIN_NORMAL_MAP),
 		TERRAIN_Y_SCALE_MULTIPLIER,
 		TERRAIN_Y_SHIFT,
 		sunPos,
@@ -327,14 +373,14 @@ int main()
 	camMgr.getPlayerCamera()->addSubscriber(&player);
 
 	// "characters"
-	NomadCharacter nomadCharacter(&timeMgr, &sandTerrain, &sound, &uiText, &nomadObject, &nomadAnimations, 146.12f, -171.42f);
-	SandWormCharacter sandWormCharacter(&timeMgr, &sandTerrain, &sound, &sandWormObject, &sandWormAnimations, &particles1, &particles2, 944.37f, -793.97f); //726.44f, -610.75f
-	OrnithopterCharacter ornithopterCharacter(&timeMgr, &sound, &ornithopterObject, &ornithopterAnimations);
+	NomadCharacter nomadCharacter(&timeMgr, &sandTerrain, &sound, &uiText, &nomadObject, nomadAnimations, 146.12f, -171.42f);
+	SandWormCharacter sandWormCharacter(&timeMgr, &sandTerrain, &sound, &sandWormObject, sandWormAnimations, &particles1, &particles2, 944.37f, -793.97f); //726.44f, -610.75f
+	OrnithopterCharacter ornithopterCharacter(&timeMgr, &sound, &ornithopterObject, ornithopterAnimations);
 
 	// items player can pick up
-	Thumper thumper1(&timeMgr, &sound, &thumperObject1, &thumperAnimations);
+	Thumper thumper1(&timeMgr, &sound, &thumperObject1, thumperAnimations);
 	thumper1.setPosition(sandTerrain.getWorldHeightVecFor(5.0f, 6.0f) + SMALL_OFFSET_Y);
-	Thumper thumper2(&timeMgr, &sound, &thumperObject2, &thumperAnimations);
+	Thumper thumper2(&timeMgr, &sound, &thumperObject2, thumperAnimations);
 	thumper2.setPosition(sandTerrain.getWorldHeightVecFor(161.61f, -157.85f) + SMALL_OFFSET_Y);
 
 	// containers the player could open in the future, maybe. They're all empty, though
@@ -363,6 +409,19 @@ int main()
 		&containerLObject3
 	};
 	std::vector<AnimatedEntity*> independentAnimatedEntities = { &nomadCharacter, &sandWormCharacter, &ornithopterCharacter };
+	// their onNewFrame() only advances the animation time, the poses are evaluated together on the thread pool afterwards
+	const std::vector<AnimatedEntity*> animatedEntities = { &nomadCharacter, &sandWormCharacter, &thumper1, &thumper2, &ornithopterCharacter };
+	std::vector<Animator*> animators;
+	for (AnimatedEntity* entity : animatedEntities) animators.push_back(&entity->getAnimator());
+
+	PoseCache poseCache; // (the thumpers share a model and animations, they get the same pose whenever they're in the same state)
+
+	std::optional<SkinningPass> skinningPass;
+	if (USE_PRE_SKINNING)
+	{
+		skinningPass.emplace();
+		for (AnimatedEntity* entity : animatedEntities) skinningPass->add(entity);
+	}
 
 	PlayerInteractionManger interactionManger(
 		&timeMgr, 
@@ -376,6 +435,8 @@ int main()
 		&chestsThatPlayerCanOpen
 	);
 
+	TextureCache::getShared().printReport(); // (everything that's loaded at startup is in by now)
+
 	// ============ [ MAIN LOOP ] ============
 	camMgr.beforeLoop();
 	while (!glfwWindowShouldClose(window))
@@ -393,10 +454,16 @@ int main()
 		const glm::mat4 view = camMgr.getCurrentCamera()->getView();
 		const float fov = camMgr.getCurrentCamera()->getFov();
 		const glm::mat4 projection = glm::perspective(glm::radians(fov),(float)currentWidth / (float)currentHeight,0.1f, RENDER_DISTANCE);
+		const ViewFrustum frustum(projection * view);
+		CullingStats cullingStats;
 #pragma endregion
 
 		sound.updateListenerPos(cameraPos, cameraFront);
-		for (auto frameRequester : frameRequesters) frameRequester->onNewFrame();
+		for (auto frameRequester : frameRequesters) frameRequester->onNewFrame(); // gameplay, sound and dialogue stay on this thread
+		for (AnimatedEntity* entity : animatedEntities) entity->updateAnimationLod(frustum, cameraPos, fov);
+		Animator::evaluateAll(animators, &poseCache);
+		bonePalette.upload(animators); // all skinning data for this frame in one go, shared by every shader that draws these entities
+		if (skinningPass) skinningPass->run(); // from here on the animated models draw as static geometry
 
 #pragma region MOUSE_RAY_PICKING_AND_PLAYER_INTERACTIONS
 		SphericalBoundingBoxedEntity* result = interactionManger.getMouseTarget();
@@ -415,7 +482,7 @@ int main()
 		skybox.render(view, projection);
 
 		std::vector<glm::vec3> smallLightSpherePositions = computeAttenuatedLightSpheresPos(sandTerrain, t);
-		renderTerrain(terrainShader, sandTerrain, view, projection, cameraPos, smallLightSpherePositions);
+		renderTerrain(terrainShader, sandTerrain, view, projection, cameraPos, smallLightSpherePositions, cullingStats);
 
 		lightCubeShader.use();
 		lightCubeShader.setMat4("projection", projection);
@@ -441,13 +508,28 @@ int main()
 		genericShader.setVec3("viewPos", cameraPos);
 
 		// static models in the world (non-characters/interacteable items)
-		for (auto staticObj: staticGameObjects) staticObj->draw(genericShader);
+		for (auto staticObj: staticGameObjects)
+		{
+			if (!staticObj->isVisible(frustum)) { cullingStats.culled++; continue; }
+			staticObj->draw(genericShader);
+			cullingStats.drawn++;
+		}
 
 		// animated entities (not dynamic)
-		for (auto entity : independentAnimatedEntities) entity->draw(genericShader);
+		for (auto entity : independentAnimatedEntities)
+		{
+			if (!entity->isVisible(frustum)) { cullingStats.culled++; continue; }
+			entity->draw(genericShader);
+			cullingStats.drawn++;
+		}
 
 		// dynamic world items (player can pick these up)
-		for (auto thump : worldItemsThatPlayerCanPickUp) thump->draw(genericShader);
+		for (auto thump : worldItemsThatPlayerCanPickUp)
+		{
+			if (!thump->isVisible(frustum)) { cullingStats.culled++; continue; }
+			thump->draw(genericShader);
+			cullingStats.drawn++;
+		}
 
 		if (player.hasCarriedItem()) // dynamic "in player hand" items
 		{
@@ -466,7 +548,12 @@ int main()
 		particlesShader.use();
 		particlesShader.setMat4("projection", projection);
 		particlesShader.setMat4("view", view);
-		for (auto particle : particles) particle->draw(particlesShader, view, cameraPos);
+		for (auto particle : particles)
+		{
+			if (!particle->isVisible(frustum)) { cullingStats.culled++; continue; }
+			particle->draw(particlesShader, view, cameraPos);
+			cullingStats.drawn++;
+		}
 #pragma endregion
 
 #pragma region POST_PROCESSING
@@ -486,6 +573,8 @@ int main()
 		uiText.processDialogueRequests();
 		uiText.renderCurrentDialogue();
 		uiText.renderMainUIOverlay(cameraPos);
+		uiText.renderCullingStats(cullingStats);
+		uiText.renderPoseCacheStats(poseCache.getFrameStats(), poseCache.getTotalStats());
 		glCheckError();
 #pragma endregion
 
@@ -524,6 +613,7 @@ GLFWwindow* init()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return nullptr;
 	}
+	detectTextureCompressionSupport(); // (before anything is decoded, see AssetRegistry)
 
 	glViewport(0, 0, INITIAL_WIDTH, INITIAL_HEIGHT);
 
@@ -585,21 +675,26 @@ void setupAttenuatedLightSpheres(Shader& targetShader, const float c1, const flo
 
 std::vector<glm::vec3> computeAttenuatedLightSpheresPos(Terrain& terrain, const float t)
 {
+	const float anchorXs[] = { -160.0f, -170.0f, -170.0f };
+	const float anchorZs[] = { 50.0f, 60.0f, 40.0f };
+	float anchorYs[3];
+	terrain.getWorldHeightsAt(anchorXs, anchorZs, 3, anchorYs); // fixed anchors, always on the grid
+
 	std::vector<glm::vec3> smallLightSpherePositions = { // MAX size = 4 (as per terrain.frag)
-			terrain.getWorldHeightVecFor(-160, 50) + glm::vec3(sin(t) * 10.0f, 7.0 + cos(t / 2) * 3.0f, cos(t) * 10.0f),
-			terrain.getWorldHeightVecFor(-170, 60) + glm::vec3(sin(t) * 80.0f, 6.0 + sin(t) * 3.0f, cos(t) * 3.0f),
-			terrain.getWorldHeightVecFor(-170, 40) + glm::vec3(sin(t) * 2.0f, 10.5 + sin(t) * 10.0f, cos(t) * 2.0f),
+			glm::vec3(anchorXs[0], anchorYs[0], anchorZs[0]) + glm::vec3(sin(t) * 10.0f, 7.0 + cos(t / 2) * 3.0f, cos(t) * 10.0f),
+			glm::vec3(anchorXs[1], anchorYs[1], anchorZs[1]) + glm::vec3(sin(t) * 80.0f, 6.0 + sin(t) * 3.0f, cos(t) * 3.0f),
+			glm::vec3(anchorXs[2], anchorYs[2], anchorZs[2]) + glm::vec3(sin(t) * 2.0f, 10.5 + sin(t) * 10.0f, cos(t) * 2.0f),
 	};
 
 	return smallLightSpherePositions;
 }
 
-void renderTerrain(Shader& terrainShader, Terrain& terrain, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, const std::vector<glm::vec3>& smallLightSpherePositions)
+void renderTerrain(Shader& terrainShader, Terrain& terrain, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& cameraPos, const std::vector<glm::vec3>& smallLightSpherePositions, CullingStats& cullingStats)
 {
 	terrainShader.use();
 	for (int i = 0; i < smallLightSpherePositions.size(); ++i)
 	{
 		terrainShader.setVec3("attLightPos[" + std::to_string(i) + "]", smallLightSpherePositions[i]);
 	}
-	terrain.render(view, projection, cameraPos);
+	terrain.render(view, projection, cameraPos, &cullingStats);
 }
\ No newline at end of file
@@ -36,8 +36,9 @@ uniform Light light;
 
 
 vec3 computeNormalTextureCase() {
-    vec3 norm = texture(material.texture_normal1, TexCoord).rgb;
-    norm = normalize(norm * 2.0 - 1.0);
+    // only x and y are read: z is rebuilt, so cooked (BC5, two channel) normal maps work the same as the uncompressed ones
+    vec2 normXY = texture(material.texture_normal1, TexCoord).rg * 2.0 - 1.0;
+    vec3 norm = normalize(vec3(normXY, sqrt(max(1.0 - dot(normXY, normXY), 0.0))));
 
     // ambient
     vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoord));
@@ -29,9 +29,22 @@ out vec3 TangentFragPos;
 
 const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBoneMatrices[MAX_BONES];
+uniform samplerBuffer bonePalette; // bone matrices of every animated entity this frame, 4 texels (columns) per matrix
+uniform int boneOffset; // where this entity's matrices start in bonePalette
+uniform int boneCount; // how many matrices this entity has there, the ids past that would read the next entity's bones
 uniform bool doAnimate;
 
+mat4 getBoneMatrix(int bone)
+{
+    int texel = (boneOffset + bone) * 4;
+    return mat4(
+        texelFetch(bonePalette, texel),
+        texelFetch(bonePalette, texel + 1),
+        texelFetch(bonePalette, texel + 2),
+        texelFetch(bonePalette, texel + 3)
+    );
+}
+
 
 
 void main()
@@ -54,14 +67,15 @@ void main()
         for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
             if (aBoneIds[i] == -1) continue; // not set in this case.
 
-            if (aBoneIds[i] >= MAX_BONES) {
+            if (aBoneIds[i] >= min(boneCount, MAX_BONES)) {
                 totalPosition = aPos4;
                 break;
             }
 
-            vec4 localPosition = finalBoneMatrices[aBoneIds[i]] * aPos4;
+            mat4 boneMatrix = getBoneMatrix(aBoneIds[i]);
+            vec4 localPosition = boneMatrix * aPos4;
             totalPosition += localPosition * aWeights[i];
-            vec3 localNormal = mat3(finalBoneMatrices[aBoneIds[i]]) * aNormal;
+            vec3 localNormal = mat3(boneMatrix) * aNormal;
             totalNormal += localNormal;
         }
 
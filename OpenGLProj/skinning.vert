@@ -0,0 +1,52 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 3) in ivec4 aBoneIds;
+layout (location = 4) in vec4 aWeights;
+
+// captured with transform feedback (see SkinningPass), still in model space
+out vec3 SkinnedPos;
+out vec3 SkinnedNormal;
+
+const int MAX_BONES = 100;
+const int MAX_BONE_INFLUENCE = 4;
+uniform samplerBuffer bonePalette; // bone matrices of every animated entity this frame, 4 texels (columns) per matrix
+uniform int boneOffset; // where this entity's matrices start in bonePalette
+uniform int boneCount; // how many matrices this entity has there, the ids past that would read the next entity's bones
+
+mat4 getBoneMatrix(int bone)
+{
+    int texel = (boneOffset + bone) * 4;
+    return mat4(
+        texelFetch(bonePalette, texel),
+        texelFetch(bonePalette, texel + 1),
+        texelFetch(bonePalette, texel + 2),
+        texelFetch(bonePalette, texel + 3)
+    );
+}
+
+// same skinning as the doAnimate path of mesh.vert
+void main()
+{
+    vec4 aPos4 = vec4(aPos, 1.0);
+    vec4 totalPosition = vec4(0.0);
+    vec3 totalNormal = vec3(0.0);
+
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++) {
+        if (aBoneIds[i] == -1) continue; // not set in this case.
+
+        if (aBoneIds[i] >= min(boneCount, MAX_BONES)) {
+            totalPosition = aPos4;
+            break;
+        }
+
+        mat4 boneMatrix = getBoneMatrix(aBoneIds[i]);
+        vec4 localPosition = boneMatrix * aPos4;
+        totalPosition += localPosition * aWeights[i];
+        vec3 localNormal = mat3(boneMatrix) * aNormal;
+        totalNormal += localNormal;
+    }
+
+    SkinnedPos = totalPosition.xyz;
+    SkinnedNormal = totalNormal;
+}
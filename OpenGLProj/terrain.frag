@@ -92,8 +92,9 @@ float computeSpecBlinnPhong(vec3 lightDir, vec3 norm, vec3 viewDir) {
 void main() 
 {
     //vec3 norm = normalize(Normal);
-    vec3 norm = texture(material.normal, TexCoord).rgb;
-    norm = normalize(norm * 2.0 - 1.0);
+    // (z is rebuilt from x and y, see mesh.frag)
+    vec2 normXY = texture(material.normal, TexCoord).rg * 2.0 - 1.0;
+    vec3 norm = normalize(vec3(normXY, sqrt(max(1.0 - dot(normXY, normXY), 0.0))));
 
 
     vec3 lightDir = normalize(LightPos - FragPos);
@@ -1,9 +1,8 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoord;
-layout (location = 2) in vec3 aNormal;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBiTangent;
+// compact vertex (see PackedTerrainVertex): x/z come from the grid index
+layout (location = 0) in float aHeight;
+layout (location = 1) in vec2 aNormalOct; // octahedral encoded
+layout (location = 2) in vec2 aTangentOct; // octahedral encoded
 
 uniform mat4 model;
 uniform mat4 view;
@@ -18,6 +17,19 @@ const int MAX_ATTENUATED_LIGHTS = 4;
 uniform vec3 attLightPos[MAX_ATTENUATED_LIGHTS];
 uniform int numAttLights;
 
+// CDLOD morphing (see TerrainChunkTree)
+uniform sampler2D heightMapTex; // heights of the full resolution grid (1 texel = 1 vertex)
+uniform vec2 gridOffset; // local space -> grid coordinate offset
+uniform vec3 lodCameraPos; // camera position in the local space of the terrain
+uniform int lodStride; // vertex stride of the chunk being drawn
+uniform float lodMorphStart;
+uniform float lodMorphEnd;
+
+uniform int gridWidth; // vertices per grid row
+uniform int gridStride; // height map vertices between two vertices of this mesh (1, except for the streamed tiles)
+uniform int gridBorder; // rows/columns of skirt vertices around the mesh (streamed tiles only), they sit right on the edge of the grid
+uniform int tileStride; // gridStride of the streamed tiles, the edge of the full resolution grid is snapped onto theirs
+uniform float texCoordDivisor;
 
 out vec3 FragPosWorld;
 out vec3 ViewPosWorld;
@@ -32,11 +44,84 @@ out vec3 ViewPos;
 out vec3 attLightPosT[MAX_ATTENUATED_LIGHTS];
 out vec3 attLightPosWorld[MAX_ATTENUATED_LIGHTS];
 
+/**
+ * Inverse of octEncodeUnitVector() in Terrain.h (octahedron folded around y)
+ */
+vec3 octDecode(vec2 e) {
+	vec3 n = vec3(e.x, 1.0 - abs(e.x) - abs(e.y), e.y);
+	float t = max(-n.y, 0.0);
+	n.x += (n.x >= 0.0) ? -t : t;
+	n.z += (n.z >= 0.0) ? -t : t;
+	return normalize(n);
+}
+
+float gridHeight(ivec2 g) {
+	return texelFetch(heightMapTex, g, 0).r;
+}
+
+/**
+ * Moves the vertex height towards the surface of the next (coarser) LOD level as the camera gets further away,
+ * so that there's no visible "popping" when a chunk switches levels and no cracks between chunks of different levels.
+ */
+vec3 morphVertex(vec3 pos) {
+	float morphK = clamp((distance(pos, lodCameraPos) - lodMorphStart) / (lodMorphEnd - lodMorphStart), 0.0, 1.0);
+	if (morphK <= 0.0) return pos;
+
+	// coarse level grid cell this vertex lies in (the last row/column of the grid is clamped, same as the index buffer)
+	ivec2 gridMax = textureSize(heightMapTex, 0) - ivec2(1);
+	ivec2 g = ivec2(round(pos.xz + gridOffset));
+	int coarseStride = lodStride * 2;
+	ivec2 a = (g / coarseStride) * coarseStride;
+	ivec2 b = min(a + ivec2(coarseStride), gridMax);
+	vec2 uv = vec2(g - a) / vec2(max(b - a, ivec2(1)));
+
+	//                  0---2
+	//                  | / |
+	//                  1---3
+	float h0 = gridHeight(a);
+	float h1 = gridHeight(ivec2(a.x, b.y));
+	float h2 = gridHeight(ivec2(b.x, a.y));
+	float h3 = gridHeight(b);
+	float coarseHeight = (uv.x + uv.y <= 1.0)
+		? h0 + uv.x * (h2 - h0) + uv.y * (h1 - h0)
+		: h3 + (1.0 - uv.x) * (h1 - h3) + (1.0 - uv.y) * (h2 - h3);
+
+	return vec3(pos.x, mix(pos.y, coarseHeight, morphK), pos.z);
+}
+
+/**
+ * The streamed tiles around the terrain only have every tileStride-th vertex (see TerrainTileStreamer), so along their edge
+ * the triangles run straight from one of those to the next. The vertices on the edge of the full resolution grid are moved
+ * onto that same line, so both sides meet without cracks (the corners are on both grids already).
+ */
+float snapToTileEdge(ivec2 g, float height) {
+	ivec2 gridMax = textureSize(heightMapTex, 0) - ivec2(1);
+	bool onXEdge = g.x == 0 || g.x == gridMax.x; // (the edge runs along z)
+	bool onZEdge = g.y == 0 || g.y == gridMax.y;
+	if (onXEdge == onZEdge) return height;
+
+	int along = onXEdge ? g.y : g.x;
+	int alongMax = onXEdge ? gridMax.y : gridMax.x;
+	int a = (along / tileStride) * tileStride;
+	int b = min(a + tileStride, alongMax); // (the tiles clamp their last vertex onto the edge as well)
+	float t = float(along - a) / float(max(b - a, 1));
+	float ha = gridHeight(onXEdge ? ivec2(g.x, a) : ivec2(a, g.y));
+	float hb = gridHeight(onXEdge ? ivec2(g.x, b) : ivec2(b, g.y));
+	return mix(ha, hb, t);
+}
+
 void main() {
-	vec3 norm = normalMatrix * aNormal; // this matrix multiplication is important to deal with the case of doing non-uniform scaling on an object
+	// with glDrawElements gl_VertexID is the index from the element buffer, so the grid position of the vertex
+	// (a reduced resolution mesh clamps its last row/column onto the edge of the height map, and so do its skirt vertices)
+	ivec2 g = clamp((ivec2(gl_VertexID % gridWidth, gl_VertexID / gridWidth) - ivec2(gridBorder)) * gridStride, ivec2(0), textureSize(heightMapTex, 0) - ivec2(1));
+	vec3 localPos = vec3(float(g.x) - gridOffset.x, aHeight, float(g.y) - gridOffset.y);
+
+	vec3 pos = morphVertex(localPos);
+	if (gridStride == 1) pos.y = snapToTileEdge(g, pos.y);
+	vec3 norm = normalMatrix * octDecode(aNormalOct); // this matrix multiplication is important to deal with the case of doing non-uniform scaling on an object
 
 	// https://learnopengl.com/Advanced-Lighting/Normal-Mapping
-	vec3 T = normalize(vec3(model * vec4(aTangent, 0.0)));
+	vec3 T = normalize(vec3(model * vec4(octDecode(aTangentOct), 0.0)));
     vec3 N = normalize(vec3(model * vec4(norm, 0.0)));
     T = normalize(T - dot(T, N) * N);
     vec3 B = cross(N, T);
@@ -44,20 +129,20 @@ void main() {
 
 
 	// WORLD COORDINATES
-	FragPosWorld = vec3(model * vec4(aPos, 1.0));
+	FragPosWorld = vec3(model * vec4(pos, 1.0));
 	ViewPosWorld = viewPos;
 
 
 	// TANGENT COORDINATES
-	FragPos = TBN * vec3(model * vec4(aPos, 1.0));
+	FragPos = TBN * vec3(model * vec4(pos, 1.0));
     Normal = norm; // I'm not sure why my normal is suddenly incorrect now that I try to compute things this way?
-	TexCoord = aTexCoord;
+	TexCoord = FragPosWorld.xz / texCoordDivisor; // world space, so the texture continues seamlessly across the tiles
 
 	LightPos = TBN * lightPos;
 	ViewPos = TBN * viewPos;
 	
 
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	gl_Position = projection * view * model * vec4(pos, 1.0);
 
 
 	// attenuated lights